@@ -1,11 +1,22 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
+#include <errno.h>
+#include <limits.h>
 #include "ast.h"
 #include "types.h"
 #include "variables.h"
-
-extern List *variables;
+#include "listio.h"
+#include "kernels.h"
+#include "trace.h"
+#include "stats.h"
+#include "context.h"
+#include "compact.h"
+#include "tier.h"
+#include "inputlog.h"
+#include "budget.h"
+#include "perf.h"
+#include "checkpoint.h"
 
 /**
  * @brief Create a new node.
@@ -14,29 +25,37 @@ extern List *variables;
  *
  * @return A pointer to the created node.
  */
-static Node *alloc_node(NodeType t) {
+static Node *alloc_node(Context *ctx, NodeType t) {
     Node *n = (Node *)malloc(sizeof(Node));
     if (!n) {
-        perror("malloc() failed");
-        exit(1);
+        context_error(ctx, "malloc() failed: %s", strerror(errno));
     }
 
     memset(n, 0, sizeof(Node));
     n->type = t;
+
+    ctx->stats.nodes[t]++;
+    ctx->stats.node_bytes += sizeof(Node);
+    TRACE(TRACE_PARSER, EV_NODE_CREATED, t, NULL);
     return n;
 }
 
-void add_child(Node *n, Node *child) {
+const char *node_type_name(NodeType type) {
+    static const char *names[NODE_COUNT] = { NODE_TYPES(NODE_TYPE_NAME) };
+
+    if ((int)type < 0 || type >= NODE_COUNT || !names[type]) return "NODE_?";
+    return names[type];
+}
+
+void add_child(Context *ctx, Node *n, Node *child) {
     if (!n || !child) return;
     if (n->type != NODE_BLOCK) {
-        fprintf(stderr, "add_child(): the node n must be of type NODE_BLOCK.\n");
-        exit(1);
+        context_error(ctx, "add_child(): the node n must be of type NODE_BLOCK.");
     }
 
     Node **new_cmds = (Node **)malloc(sizeof(Node *) * (n->block.count + 1));
     if (!new_cmds) {
-        perror("malloc() failed");
-        exit(1);
+        context_error(ctx, "malloc() failed: %s", strerror(errno));
     }
 
     new_cmds[0] = child;
@@ -57,21 +76,18 @@ void change_untypeds(Node **cmds, int length, Types type) {
     }
 }
 
-Node *join_blocks(Node *n1, Node *n2) {
+Node *join_blocks(Context *ctx, Node *n1, Node *n2) {
     if (!n1 || !n2) {
-        fprintf(stderr, "join_blocks(): the nodes must exist.\n");
-        exit(1);
+        context_error(ctx, "join_blocks(): the nodes must exist.");
     }
     if (n1->type != NODE_BLOCK || n2->type != NODE_BLOCK) {
-        fprintf(stderr, "join_blocks(): the nodes must be of type NODE_BLOCK.\n");
-        exit(1);
+        context_error(ctx, "join_blocks(): the nodes must be of type NODE_BLOCK.");
     }
 
     int count = n1->block.count + n2->block.count;
     Node **new_cmds = (Node **)malloc(sizeof(Node *) * count);
     if (!new_cmds) {
-        perror("malloc() failed");
-        exit(1);
+        context_error(ctx, "malloc() failed: %s", strerror(errno));
     }
 
     memcpy(new_cmds, n1->block.cmds, sizeof(Node *) * n1->block.count);
@@ -82,133 +98,125 @@ Node *join_blocks(Node *n1, Node *n2) {
     free(n2->block.cmds);
     free(n2);
 
-    return make_block(new_cmds, count);
+    return make_block(ctx, new_cmds, count);
 }
 
-Node *make_block(Node **cmds, int count) {
+Node *make_block(Context *ctx, Node **cmds, int count) {
     if (!cmds) {
-        fprintf(stderr, "make_block(): the cmds parameter must exist.\n");
-        exit(1);
+        context_error(ctx, "make_block(): the cmds parameter must exist.");
     }
 
-    Node *n = alloc_node(NODE_BLOCK);
+    Node *n = alloc_node(ctx, NODE_BLOCK);
     n->block.cmds = cmds;
     n->block.count = count;
     return n;
 }
 
 
-Node *make_decl(Types type, const char *name, int size) {
-    Node *n = alloc_node(NODE_DECL);
+Node *make_decl(Context *ctx, Types type, const char *name, int size) {
+    Node *n = alloc_node(ctx, NODE_DECL);
     n->decl.vartype = type;
     n->decl.name = strdup(name);
     n->decl.size = size;
     return n;
 }
 
-Node *make_assign(Node *expr, Node *var) {
+Node *make_assign(Context *ctx, Node *expr, Node *var) {
     if (!expr || !var) {
-        fprintf(stderr, "make_assign(): the nodes must exist.\n");
-        exit(1);
+        context_error(ctx, "make_assign(): the nodes must exist.");
     }
     if (var->type != NODE_VAR) {
-        fprintf(stderr, "make_assing(): the node var must be of type NODE_VAR.\n");
-        exit(1);
+        context_error(ctx, "make_assing(): the node var must be of type NODE_VAR.");
     }
 
-    Node *n = alloc_node(NODE_ASSIGN);
+    Node *n = alloc_node(ctx, NODE_ASSIGN);
     n->assign.expr = expr;
     n->assign.var = var;
     return n;
 }
 
-Node *make_if(Node *cond, Node *then_block, Node *else_block) {
+Node *make_if(Context *ctx, Node *cond, Node *then_block, Node *else_block) {
     if (!cond || !then_block) {
-        fprintf(stderr, "make_if(): the nodes (cond and then_block) must exist.\n");
-        exit(1);
+        context_error(ctx, "make_if(): the nodes (cond and then_block) must exist.");
     }
     if (cond->type != NODE_RELOP) {
-        fprintf(stderr, "make_if(): the node cond must be of type NODE_RELOP.\n");
-        exit(1);
+        context_error(ctx, "make_if(): the node cond must be of type NODE_RELOP.");
     }
 
-    Node *n = alloc_node(NODE_IF);
+    Node *n = alloc_node(ctx, NODE_IF);
     n->ifnode.cond = cond;
     n->ifnode.then_block = then_block;
     n->ifnode.else_block = else_block;
     return n;
 }
 
-Node *make_while(Node *cond, Node *body) {
+Node *make_while(Context *ctx, Node *cond, Node *body) {
     if (!cond || !body) {
-        fprintf(stderr, "make_while(): the nodes must exist.\n");
-        exit(1);
+        context_error(ctx, "make_while(): the nodes must exist.");
     }
     if (cond->type != NODE_RELOP) {
-        fprintf(stderr, "make_while(): the node cond must be of type NODE_RELOP.\n");
-        exit(1);
+        context_error(ctx, "make_while(): the node cond must be of type NODE_RELOP.");
     }
 
-    Node *n = alloc_node(NODE_WHILE);
+    Node *n = alloc_node(ctx, NODE_WHILE);
     n->whilenode.cond = cond;
     n->whilenode.body = body;
+    n->whilenode.copies = 1;
     return n;
 }
 
-Node *make_int(int v) {
-    Node *n = alloc_node(NODE_INT);
+Node *make_int(Context *ctx, int v) {
+    Node *n = alloc_node(ctx, NODE_INT);
     n->intval = v;
     return n;
 }
 
-Node *make_real(double v) {
-    Node *n = alloc_node(NODE_REAL);
+Node *make_real(Context *ctx, double v) {
+    Node *n = alloc_node(ctx, NODE_REAL);
     n->realval = v;
     return n;
 }
 
-int eval_index(Index index) {
+int eval_index(Context *ctx, Index index) {
     if (index.type == INTEGER) {
         return index.value.integer;
     } else {
-        Variable *var = search(variables, index.value.name);
+        Variable *var = search(ctx->variables, index.value.name);
         if (!var) {
-            fprintf(stderr, "eval_index(): undeclared variable '%s'.\n", index.value.name);
-            exit(1);
+            context_error(ctx, "eval_index(): undeclared variable '%s'.", index.value.name);
         }
         if (!var->initialized) {
-            fprintf(stderr, "eval_index(): variable '%s' not initialized.\n", index.value.name);
-            exit(1);
+            context_error(ctx, "eval_index(): variable '%s' not initialized.", index.value.name);
         }
         return *(int *)var->data;
     }
 }
 
-Node *make_var(const char *name, Index index) {
-    Node *n = alloc_node(NODE_VAR);
+Node *make_var(Context *ctx, const char *name, Index index) {
+    Node *n = alloc_node(ctx, NODE_VAR);
     n->var.name = strdup(name);
     n->var.index = index;
     return n;
 }
 
-Node *make_binop(BinOp op, Node *left, Node *right) {
-    Node *n = alloc_node(NODE_BINOP);
+Node *make_binop(Context *ctx, BinOp op, Node *left, Node *right) {
+    Node *n = alloc_node(ctx, NODE_BINOP);
     n->binop.op = op;
     n->binop.left = left;
     n->binop.right = right;
     return n;
 }
 
-Node *make_relop(RelOp op, Node *left, Node *right) {
-    Node *n = alloc_node(NODE_RELOP);
+Node *make_relop(Context *ctx, RelOp op, Node *left, Node *right) {
+    Node *n = alloc_node(ctx, NODE_RELOP);
     n->relop.op = op;
     n->relop.left = left;
     n->relop.right = right;
     return n;
 }
 
-Node *make_write(const char *string, Node *var) {
-    Node *n = alloc_node(NODE_WRITE);
+Node *make_write(Context *ctx, const char *string, Node *var) {
+    Node *n = alloc_node(ctx, NODE_WRITE);
     if (!string) {
         n->writenode.string = NULL;
     } else {
@@ -218,21 +226,71 @@ Node *make_write(const char *string, Node *var) {
     return n;
 }
 
-Node *make_read(Node *var) {
+Node *make_read(Context *ctx, Node *var) {
     if (!var) {
-        fprintf(stderr, "make_read(): the node must exist.\n");
-        exit(1);
+        context_error(ctx, "make_read(): the node must exist.");
     }
     if (var->type != NODE_VAR) {
-        fprintf(stderr, "make_read(): the node var must be of type NODE_VAR.\n");
-        exit(1);
+        context_error(ctx, "make_read(): the node var must be of type NODE_VAR.");
     }
 
-    Node *n = alloc_node(NODE_READ);
+    Node *n = alloc_node(ctx, NODE_READ);
     n->readnode.var = var;
     return n;
 }
 
+Node *make_listio(Context *ctx, int write, int binary, const char *name, ListRange range, const char *path) {
+    if (!name) {
+        context_error(ctx, "make_listio(): the list name must exist.");
+    }
+    if ((range.start == NULL) != (range.end == NULL)) {
+        context_error(ctx, "make_listio(): the range must have both start and end.");
+    }
+
+    Node *n = alloc_node(ctx, NODE_LISTIO);
+    n->listio.write = write;
+    n->listio.binary = binary;
+    n->listio.name = strdup(name);
+    n->listio.range = range;
+    n->listio.path = path ? strdup(path) : NULL;
+    return n;
+}
+
+Node *make_intrinsic(Context *ctx, Intrinsic op, const char *name, const char *other) {
+    if (!name || (op == I_PRODESCALAR && !other)) {
+        context_error(ctx, "make_intrinsic(): the list names must exist.");
+    }
+
+    Node *n = alloc_node(ctx, NODE_INTRINSIC);
+    n->intrinsic.op = op;
+    n->intrinsic.name = strdup(name);
+    n->intrinsic.other = other ? strdup(other) : NULL;
+    return n;
+}
+
+Node *make_listop(Context *ctx, Intrinsic op, const char *name, Node *expr) {
+    if (!name || !expr) {
+        context_error(ctx, "make_listop(): the list name and the expression must exist.");
+    }
+
+    Node *n = alloc_node(ctx, NODE_LISTOP);
+    n->listop.op = op;
+    n->listop.name = strdup(name);
+    n->listop.expr = expr;
+    return n;
+}
+
+Node *make_temp(Context *ctx, int slot, Node *expr) {
+    if (slot < 0) {
+        context_error(ctx, "make_temp(): the slot must not be negative.");
+    }
+
+    Node *n = alloc_node(ctx, NODE_TEMP);
+    n->temp.slot = slot;
+    n->temp.expr = expr;
+    return n;
+}
+
 void free_node(Node *n) {
     if (!n) return;
 
@@ -281,6 +339,23 @@ void free_node(Node *n) {
         case NODE_READ:
             free_node(n->readnode.var);
             break;
+        case NODE_LISTIO:
+            free(n->listio.name);
+            free_node(n->listio.range.start);
+            free_node(n->listio.range.end);
+            free(n->listio.path);
+            break;
+        case NODE_INTRINSIC:
+            free(n->intrinsic.name);
+            free(n->intrinsic.other);
+            break;
+        case NODE_LISTOP:
+            free(n->listop.name);
+            free_node(n->listop.expr);
+            break;
+        case NODE_TEMP:
+            free_node(n->temp.expr);
+            break;
         case NODE_INT:
         case NODE_REAL:
         default:
@@ -289,6 +364,164 @@ void free_node(Node *n) {
     free(n);
 }
 
+Node *copy_node(Context *ctx, const Node *n) {
+    if (!n) return NULL;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+        {
+            Node **cmds = (Node **)malloc(sizeof(Node *) * (n->block.count ? n->block.count : 1));
+            if (!cmds) {
+                context_error(ctx, "malloc() failed: %s", strerror(errno));
+            }
+            for (int i = 0; i < n->block.count; i++) cmds[i] = copy_node(ctx, n->block.cmds[i]);
+            Node *block = make_block(ctx, cmds, n->block.count);
+            block->block.iterations = n->block.iterations;
+            return block;
+        }
+        case NODE_DECL:
+            return make_decl(ctx, n->decl.vartype, n->decl.name, n->decl.size);
+        case NODE_ASSIGN:
+            return make_assign(ctx, copy_node(ctx, n->assign.expr), copy_node(ctx, n->assign.var));
+        case NODE_IF:
+            return make_if(ctx, copy_node(ctx, n->ifnode.cond), copy_node(ctx, n->ifnode.then_block),
+                copy_node(ctx, n->ifnode.else_block));
+        case NODE_WHILE:
+        {
+            Node *loop = make_while(ctx, copy_node(ctx, n->whilenode.cond), copy_node(ctx, n->whilenode.body));
+            loop->whilenode.copies = n->whilenode.copies;
+            return loop;
+        }
+        case NODE_WRITE:
+            return make_write(ctx, n->writenode.string, copy_node(ctx, n->writenode.var));
+        case NODE_READ:
+            return make_read(ctx, copy_node(ctx, n->readnode.var));
+        case NODE_LISTIO:
+        {
+            ListRange range = { copy_node(ctx, n->listio.range.start), copy_node(ctx, n->listio.range.end) };
+            return make_listio(ctx, n->listio.write, n->listio.binary, n->listio.name, range, n->listio.path);
+        }
+        case NODE_INT:
+            return make_int(ctx, n->intval);
+        case NODE_REAL:
+            return make_real(ctx, n->realval);
+        case NODE_VAR:
+            return make_var(ctx, n->var.name, n->var.index);
+        case NODE_BINOP:
+            return make_binop(ctx, n->binop.op, copy_node(ctx, n->binop.left), copy_node(ctx, n->binop.right));
+        case NODE_RELOP:
+            return make_relop(ctx, n->relop.op, copy_node(ctx, n->relop.left), copy_node(ctx, n->relop.right));
+        case NODE_INTRINSIC:
+            return make_intrinsic(ctx, n->intrinsic.op, n->intrinsic.name, n->intrinsic.other);
+        case NODE_LISTOP:
+            return make_listop(ctx, n->listop.op, n->listop.name, copy_node(ctx, n->listop.expr));
+        case NODE_TEMP:
+            return make_temp(ctx, n->temp.slot, copy_node(ctx, n->temp.expr));
+        default:
+            context_error(ctx, "copy_node(): unsupported node type '%d'.", n->type);
+    }
+}
+
+#define FNV_OFFSET 0xcbf29ce484222325ULL
+#define FNV_PRIME 0x100000001b3ULL
+
+static uint64_t hash_bytes(uint64_t h, const void *data, size_t size) {
+    const unsigned char *p = (const unsigned char *)data;
+    for (size_t i = 0; i < size; i++) {
+        h ^= p[i];
+        h *= FNV_PRIME;
+    }
+    return h;
+}
+
+static uint64_t hash_int(uint64_t h, int64_t v) {
+    return hash_bytes(h, &v, sizeof(v));
+}
+
+/* NULL is hashed differently from the empty string. */
+static uint64_t hash_string(uint64_t h, const char *s) {
+    if (!s) return hash_int(h, -1);
+    return hash_bytes(h, s, strlen(s) + 1);
+}
+
+static uint64_t hash_index(uint64_t h, Index index) {
+    h = hash_int(h, index.type);
+    return index.type == INTEGER ? hash_int(h, index.value.integer) : hash_string(h, index.value.name);
+}
+
+static uint64_t hash_tree(uint64_t h, const Node *n) {
+    /* A missing child is a type that no node has. */
+    if (!n) return hash_int(h, NODE_COUNT);
+
+    h = hash_int(h, n->type);
+    switch (n->type) {
+        case NODE_BLOCK:
+            h = hash_int(h, n->block.count);
+            h = hash_int(h, n->block.iterations);
+            for (int i = 0; i < n->block.count; i++) h = hash_tree(h, n->block.cmds[i]);
+            return h;
+        case NODE_DECL:
+            h = hash_int(h, n->decl.vartype);
+            h = hash_int(h, n->decl.size);
+            return hash_string(h, n->decl.name);
+        case NODE_ASSIGN:
+            h = hash_tree(h, n->assign.expr);
+            return hash_tree(h, n->assign.var);
+        case NODE_IF:
+            h = hash_tree(h, n->ifnode.cond);
+            h = hash_tree(h, n->ifnode.then_block);
+            return hash_tree(h, n->ifnode.else_block);
+        case NODE_WHILE:
+            h = hash_int(h, n->whilenode.copies);
+            h = hash_tree(h, n->whilenode.cond);
+            return hash_tree(h, n->whilenode.body);
+        case NODE_WRITE:
+            h = hash_string(h, n->writenode.string);
+            return hash_tree(h, n->writenode.var);
+        case NODE_READ:
+            return hash_tree(h, n->readnode.var);
+        case NODE_LISTIO:
+            h = hash_int(h, n->listio.write);
+            h = hash_int(h, n->listio.binary);
+            h = hash_string(h, n->listio.name);
+            h = hash_tree(h, n->listio.range.start);
+            h = hash_tree(h, n->listio.range.end);
+            return hash_string(h, n->listio.path);
+        case NODE_INT:
+            return hash_int(h, n->intval);
+        case NODE_REAL:
+            return hash_bytes(h, &n->realval, sizeof(n->realval));
+        case NODE_VAR:
+            h = hash_string(h, n->var.name);
+            return hash_index(h, n->var.index);
+        case NODE_BINOP:
+            h = hash_int(h, n->binop.op);
+            h = hash_tree(h, n->binop.left);
+            return hash_tree(h, n->binop.right);
+        case NODE_RELOP:
+            h = hash_int(h, n->relop.op);
+            h = hash_tree(h, n->relop.left);
+            return hash_tree(h, n->relop.right);
+        case NODE_INTRINSIC:
+            h = hash_int(h, n->intrinsic.op);
+            h = hash_string(h, n->intrinsic.name);
+            return hash_string(h, n->intrinsic.other);
+        case NODE_LISTOP:
+            h = hash_int(h, n->listop.op);
+            h = hash_string(h, n->listop.name);
+            return hash_tree(h, n->listop.expr);
+        case NODE_TEMP:
+            h = hash_int(h, n->temp.slot);
+            return hash_tree(h, n->temp.expr);
+        default:
+            return h;
+    }
+}
+
+uint64_t hash_node(const Node *n) {
+    return hash_tree(FNV_OFFSET, n);
+}
+
 /**
  * @brief Initializes a variable structure.
  *
@@ -298,15 +531,16 @@ void free_node(Node *n) {
  *
  * @return Returns 1 if OK, and 0 if it fails.
  */
-static int set_variable_value_from_eval(Variable *v, EvalResult val, int index) {
+static int set_variable_value_from_eval(Context *ctx, Variable *v, EvalResult val, int index) {
     if (!v) return 0;
+    v->generation++;
     if (v->type == T_INTEIRO) {
         if (!v->data) {
             v->data = malloc(sizeof(int));
             if (!v->data) {
-                perror("malloc() failed");
-                exit(1);
+                context_error(ctx, "malloc() failed: %s", strerror(errno));
             }
+            ctx->stats.variable_bytes += sizeof(int);
         }
 
         if (val.type == T_INTEIRO) {
@@ -321,9 +555,9 @@ static int set_variable_value_from_eval(Variable *v, EvalResult val, int index)
         if (!v->data) {
             v->data = malloc(sizeof(double));
             if (!v->data) {
-                perror("malloc() failed");
-                exit(1);
+                context_error(ctx, "malloc() failed: %s", strerror(errno));
             }
+            ctx->stats.variable_bytes += sizeof(double);
         }
 
         if (val.type == T_INTEIRO) {
@@ -336,16 +570,16 @@ static int set_variable_value_from_eval(Variable *v, EvalResult val, int index)
         return 1;
     } else if (v->type == T_LISTAINT) {
         if (!v->data) {
+            budget_memory(ctx, sizeof(int) * v->size);
             v->data = malloc(sizeof(int) * v->size);
             if (!v->data) {
-                perror("malloc() failed");
-                exit(1);
+                context_error(ctx, "malloc() failed: %s", strerror(errno));
             }
+            ctx->stats.list_bytes += sizeof(int) * v->size;
         }
 
         if (index < 0 || index >= v->size) {
-            fprintf(stderr, "set_variable_value_from_eval(): index out of range.\n");
-            exit(1);
+            context_error(ctx, "set_variable_value_from_eval(): index out of range.");
         }
 
         if (val.type == T_INTEIRO) {
@@ -358,16 +592,16 @@ static int set_variable_value_from_eval(Variable *v, EvalResult val, int index)
         return 1;
     } else if (v->type == T_LISTAREAL) {
         if (!v->data) {
+            budget_memory(ctx, sizeof(double) * v->size);
             v->data = malloc(sizeof(double) * v->size);
             if (!v->data) {
-                perror("malloc() failed");
-                exit(1);
+                context_error(ctx, "malloc() failed: %s", strerror(errno));
             }
+            ctx->stats.list_bytes += sizeof(double) * v->size;
         }
 
         if (index < 0 || index >= v->size) {
-            fprintf(stderr, "set_variable_value_from_eval(): index out of range.\n");
-            exit(1);
+            context_error(ctx, "set_variable_value_from_eval(): index out of range.");
         }
 
         if (val.type == T_INTEIRO) {
@@ -382,267 +616,784 @@ static int set_variable_value_from_eval(Variable *v, EvalResult val, int index)
     return 0;
 }
 
-EvalResult eval_node(Node *n) {
+/**
+ * @brief Searches for a variable that must be a list.
+ *
+ * @param name Variable name.
+ * @param where Prefix of the error messages.
+ *
+ * @return Pointer to the variable.
+ */
+static Variable *search_list(Context *ctx, char *name, const char *where) {
+    Variable *v = search(ctx->variables, name);
+    if (!v) {
+        context_error(ctx, "%s: undeclared variable '%s'.", where, name);
+    }
+    if (v->type != T_LISTAINT && v->type != T_LISTAREAL) {
+        context_error(ctx, "%s: variable '%s' is not a list.", where, name);
+    }
+    return v;
+}
+
+/**
+ * @brief Allocates the data of a list, if it was not allocated yet.
+ *
+ * @param v List variable.
+ */
+static void alloc_list_data(Context *ctx, Variable *v) {
+    if (v->data) return;
+
+    budget_memory(ctx, (v->type == T_LISTAINT ? sizeof(int) : sizeof(double)) * v->size);
+    v->data = malloc((v->type == T_LISTAINT ? sizeof(int) : sizeof(double)) * v->size);
+    if (!v->data) {
+        context_error(ctx, "malloc() failed: %s", strerror(errno));
+    }
+    ctx->stats.list_bytes += (v->type == T_LISTAINT ? sizeof(int) : sizeof(double)) * v->size;
+}
+
+/**
+ * @brief Calculates the value of an intrinsic over whole lists (NODE_INTRINSIC).
+ *
+ * @param op Intrinsic.
+ * @param name List name.
+ * @param other Second list name (only used by I_PRODESCALAR).
+ *
+ * @return The result of the calculation.
+ */
+static EvalResult eval_intrinsic(Context *ctx, Intrinsic op, char *name, char *other) {
     EvalResult r;
-    if (!n) { r.type = T_REAL; r.v.d = 0.0; return r; }
+    const Kernels *k = get_kernels();
 
-    switch (n->type) {
-        case NODE_INT:
-            #ifdef DEBUG
-                printf("[AST] - Evaluating NODE_INT\n");
-            #endif
+    Variable *v = search_list(ctx, name, "eval_node() - NODE_INTRINSIC");
+    if (!v->initialized) {
+        context_error(ctx, "eval_node() - NODE_INTRINSIC: variable '%s' not initialized.", name);
+    }
+    if (v->size == 0 && op != I_SOMA && op != I_PRODESCALAR) {
+        context_error(ctx, "eval_node() - NODE_INTRINSIC: list '%s' is empty.", name);
+    }
 
-            r.type = T_INTEIRO;
-            r.v.i = n->intval;
-            return r;
-        case NODE_REAL:
-            #ifdef DEBUG
-                printf("[AST] - Evaluating NODE_REAL\n");
-            #endif
+    int ints = v->type == T_LISTAINT;
+    r.type = ints ? T_INTEIRO : T_REAL;
 
+    switch (op) {
+        case I_SOMA:
+            if (ints) r.v.i = k->sum_int((int *)v->data, v->size);
+            else r.v.d = k->sum_real((double *)v->data, v->size);
+            break;
+        case I_MEDIA:
             r.type = T_REAL;
-            r.v.d = n->realval;
-            return r;
-        case NODE_VAR:
+            if (ints) {
+                /* Summed in 64 bits, as the mean of a list of integers should not wrap around. */
+                long long total = 0;
+                for (int i = 0; i < v->size; i++) total += ((int *)v->data)[i];
+                r.v.d = (double)total / v->size;
+            } else {
+                r.v.d = k->sum_real((double *)v->data, v->size) / v->size;
+            }
+            break;
+        case I_MINIMO:
+            if (ints) r.v.i = k->min_int((int *)v->data, v->size);
+            else r.v.d = k->min_real((double *)v->data, v->size);
+            break;
+        case I_MAXIMO:
+            if (ints) r.v.i = k->max_int((int *)v->data, v->size);
+            else r.v.d = k->max_real((double *)v->data, v->size);
+            break;
+        case I_PRODESCALAR:
         {
-            #ifdef DEBUG
-                printf("[AST] - Evaluating NODE_VAR\n");
-            #endif
-
-            Variable *v = search(variables, n->var.name);
-            if (!v) {
-                fprintf(stderr, "eval_node() - NODE_VAR: undeclared variable '%s'.\n", n->var.name);
-                exit(1);
+            Variable *w = search_list(ctx, other, "eval_node() - NODE_INTRINSIC");
+            if (!w->initialized) {
+                context_error(ctx, "eval_node() - NODE_INTRINSIC: variable '%s' not initialized.", other);
             }
-            if (!v->initialized) {
-                fprintf(stderr, "eval_node() - NODE_VAR: variable '%s' not initialized.\n", n->var.name);
-                exit(1);
+            if (w->type != v->type || w->size != v->size) {
+                context_error(ctx,
+                    "eval_node() - NODE_INTRINSIC: lists '%s' and '%s' must have the same type and size.",
+                    name, other);
             }
 
-            if (v->type == T_INTEIRO) {
-                r.type = T_INTEIRO;
-                r.v.i = *(int *)v->data;
-                return r;
-            } else if (v->type == T_REAL) {
-                r.type = T_REAL;
-                r.v.d = *(double *)v->data;
-                return r;
-            } else if (v->type == T_LISTAINT || v->type == T_LISTAREAL) {
-                int index = eval_index(n->var.index);
-                if (index < 0 || index >= v->size) {
-                    fprintf(stderr, "eval_node() - NODE_VAR: index out of range.\n");
-                    exit(1);
-                }
+            if (ints) r.v.i = k->dot_int((int *)v->data, (int *)w->data, v->size);
+            else r.v.d = k->dot_real((double *)v->data, (double *)w->data, v->size);
+            break;
+        }
+        default:
+            context_error(ctx, "eval_node() - NODE_INTRINSIC: unsupported intrinsic '%d'.", op);
+    }
+    return r;
+}
 
-                if (v->type == T_LISTAINT) {
-                    r.type = T_INTEIRO;
-                    r.v.i = ((int *)v->data)[index];
-                } else {
-                    r.type = T_REAL;
-                    r.v.d = ((double *)v->data)[index];
-                }
-                return r;
-            } else {
-                fprintf(stderr, "eval_node() - NODE_VAR: unsupported variable type.\n");
-                exit(1);
-            }
+/*
+ * Operations of the nodes, shared by the interpreter of the tree (eval_node() and execute_node()) and the one of the
+ * compact AST (eval_compact() and execute_compact()), so both have the same behavior and the same error messages.
+ * Children are evaluated by the callers, in the order of the original code.
+ */
+
+/**
+ * @brief Loads the value of a variable or of an element of a list (NODE_VAR).
+ */
+static EvalResult load_variable(Context *ctx, char *name, Index index) {
+    EvalResult r;
+    Variable *v = search(ctx->variables, name);
+    if (!v) {
+        context_error(ctx, "eval_node() - NODE_VAR: undeclared variable '%s'.", name);
+    }
+    if (!v->initialized) {
+        context_error(ctx, "eval_node() - NODE_VAR: variable '%s' not initialized.", name);
+    }
+
+    if (v->type == T_INTEIRO) {
+        r.type = T_INTEIRO;
+        r.v.i = *(int *)v->data;
+        return r;
+    } else if (v->type == T_REAL) {
+        r.type = T_REAL;
+        r.v.d = *(double *)v->data;
+        return r;
+    } else if (v->type == T_LISTAINT || v->type == T_LISTAREAL) {
+        int i = eval_index(ctx, index);
+        if (i < 0 || i >= v->size) {
+            context_error(ctx, "eval_node() - NODE_VAR: index out of range.");
         }
-        case NODE_BINOP:
-        {
-            #ifdef DEBUG
-                printf("[AST] - Evaluating NODE_BINOP\n");
-            #endif
-
-            EvalResult left = eval_node(n->binop.left);
-            EvalResult right = eval_node(n->binop.right);
-            if (left.type == T_INTEIRO && right.type == T_INTEIRO) {
-                r.type = T_INTEIRO;
-                switch (n->binop.op) {
-                    case OP_ADD: r.v.i = left.v.i + right.v.i; break;
-                    case OP_SUB: r.v.i = left.v.i - right.v.i; break;
-                    case OP_MUL: r.v.i = left.v.i * right.v.i; break;
-                    case OP_DIV:
-                    default: r.v.i = left.v.i / right.v.i;
+
+        if (v->type == T_LISTAINT) {
+            r.type = T_INTEIRO;
+            r.v.i = ((int *)v->data)[i];
+        } else {
+            r.type = T_REAL;
+            r.v.d = ((double *)v->data)[i];
+        }
+        return r;
+    } else {
+        context_error(ctx, "eval_node() - NODE_VAR: unsupported variable type.");
+    }
+}
+
+EvalResult eval_arithmetic(Context *ctx, BinOp op, EvalResult left, EvalResult right) {
+    EvalResult r;
+    if (left.type == T_INTEIRO && right.type == T_INTEIRO) {
+        r.type = T_INTEIRO;
+        switch (op) {
+            case OP_ADD: r.v.i = left.v.i + right.v.i; break;
+            case OP_SUB: r.v.i = left.v.i - right.v.i; break;
+            case OP_MUL: r.v.i = left.v.i * right.v.i; break;
+            case OP_DIV:
+            default:
+                /* Both would raise SIGFPE, which would end the process (and the host of the library). */
+                if (right.v.i == 0) {
+                    context_error(ctx, "eval_node() - NODE_BINOP: integer division by zero.");
                 }
-            } else {
-                double ld = (left.type == T_INTEIRO) ? (double)left.v.i : left.v.d;
-                double rd = (right.type == T_INTEIRO) ? (double)right.v.i : right.v.d;
-                r.type = T_REAL;
-                switch (n->binop.op) {
-                    case OP_ADD: r.v.d = ld + rd; break;
-                    case OP_SUB: r.v.d = ld - rd; break;
-                    case OP_MUL: r.v.d = ld * rd; break;
-                    case OP_DIV:
-                    default: r.v.d = ld / rd;
+                if (right.v.i == -1 && left.v.i == INT_MIN) {
+                    context_error(ctx, "eval_node() - NODE_BINOP: integer overflow in a division.");
                 }
+                r.v.i = left.v.i / right.v.i;
+        }
+    } else {
+        double ld = (left.type == T_INTEIRO) ? (double)left.v.i : left.v.d;
+        double rd = (right.type == T_INTEIRO) ? (double)right.v.i : right.v.d;
+        r.type = T_REAL;
+        switch (op) {
+            case OP_ADD: r.v.d = ld + rd; break;
+            case OP_SUB: r.v.d = ld - rd; break;
+            case OP_MUL: r.v.d = ld * rd; break;
+            case OP_DIV:
+            default: r.v.d = ld / rd;
+        }
+    }
+    return r;
+}
+
+int eval_compare(RelOp op, EvalResult left, EvalResult right) {
+    double ld = (left.type == T_INTEIRO) ? (double)left.v.i : left.v.d;
+    double rd = (right.type == T_INTEIRO) ? (double)right.v.i : right.v.d;
+
+    switch (op) {
+        case R_MAQ: return ld > rd;
+        case R_MAI: return ld >= rd;
+        case R_MEQ: return ld < rd;
+        case R_MEI: return ld <= rd;
+        case R_IGU: return ld == rd;
+        case R_DIF: return ld != rd;
+        case R_OU: return ld || rd;
+        case R_E: return ld && rd;
+        default: return 0;
+    }
+}
+
+/**
+ * @brief Reads a temporary saved by save_temp() (NODE_TEMP without an expression).
+ */
+static EvalResult load_temp(Context *ctx, int slot) {
+    if (slot >= ctx->temp_count) {
+        context_error(ctx, "eval_node() - NODE_TEMP: temporary %d read before being saved.", slot);
+    }
+    return ctx->temps[slot];
+}
+
+/**
+ * @brief Saves the value of a temporary, growing the slots of the context if needed (NODE_TEMP with an expression).
+ */
+static EvalResult save_temp(Context *ctx, int slot, EvalResult val) {
+    if (slot >= ctx->temp_count) {
+        int count = slot + 1 > ctx->temp_count * 2 ? slot + 1 : ctx->temp_count * 2;
+        EvalResult *temps = (EvalResult *)realloc(ctx->temps, sizeof(EvalResult) * count);
+        if (!temps) {
+            context_error(ctx, "realloc() failed: %s", strerror(errno));
+        }
+        ctx->temps = temps;
+        ctx->temp_count = count;
+    }
+    ctx->temps[slot] = val;
+    return val;
+}
+
+/**
+ * @brief Declares a variable (NODE_DECL).
+ */
+static void declare_variable(Context *ctx, char *name, Types type, int size) {
+    Variable *v = create_var(name, type, size);
+    if (!v) {
+        context_error(ctx, "malloc() failed: %s", strerror(errno));
+    }
+    insert(ctx->variables, v);
+    ctx->stats.variable_bytes += sizeof(Variable) + strlen(v->name) + 1;
+}
+
+/**
+ * @brief Assigns a value to a variable or to an element of a list (NODE_ASSIGN).
+ */
+static void assign_variable(Context *ctx, char *name, Index index, EvalResult val) {
+    Variable *v = search(ctx->variables, name);
+    if (!v) {
+        context_error(ctx, "execute_node() - NODE_ASSIGN: undeclared variable '%s'.", name);
+    }
+
+    int i = eval_index(ctx, index);
+    if (!set_variable_value_from_eval(ctx, v, val, i)) {
+        context_error(ctx, "execute_node() - NODE_ASSIGN: assignment failed (unsupported type).");
+    }
+}
+
+/**
+ * @brief Writes a string, a value, or both (NODE_WRITE).
+ *
+ * @param string String (can be NULL).
+ * @param val Value (NULL to write only the string).
+ */
+static void write_value(Context *ctx, char *string, const EvalResult *val) {
+    if (ctx->budget.max_output_bytes) {
+        size_t size = (string ? strlen(string) : 0) + 1;
+        if (val && val->type == T_INTEIRO) size += snprintf(NULL, 0, "%d", val->v.i);
+        else if (val) size += snprintf(NULL, 0, "%lf", val->v.d);
+        budget_output(ctx, size);
+    }
+
+    if (!val) {
+        fprintf(ctx->out, "%s\n", string);
+    } else if (val->type == T_INTEIRO) {
+        if (string) {
+            fprintf(ctx->out, "%s%d\n", string, val->v.i);
+        } else {
+            fprintf(ctx->out, "%d\n", val->v.i);
+        }
+    } else {
+        if (string) {
+            fprintf(ctx->out, "%s%lf\n", string, val->v.d);
+        } else {
+            fprintf(ctx->out, "%lf\n", val->v.d);
+        }
+    }
+}
+
+/**
+ * @brief Reads a variable or an element of a list (NODE_READ).
+ */
+static void read_variable(Context *ctx, char *name, Index index) {
+    EvalResult val;
+    Variable *v = search(ctx->variables, name);
+    if (!v) {
+        context_error(ctx, "execute_node() - NODE_READ: undeclared variable '%s'.", name);
+    }
+
+    val.type = (v->type == T_INTEIRO || v->type == T_LISTAINT) ? T_INTEIRO : T_REAL;
+    if (ctx->input_log && input_log_replaying(ctx->input_log)) {
+        input_log_next(ctx, ctx->input_log, &val);
+    } else {
+        int read;
+        if (val.type == T_INTEIRO) {
+            read = fscanf(ctx->in, "%d", &val.v.i);
+        } else {
+            read = fscanf(ctx->in, "%lf", &val.v.d);
+        }
+        /* A read interrupted by the watchdog fails, and is reported as the time limit. */
+        BUDGET_POLL(ctx);
+        if (read != 1) {
+            context_error(ctx, "execute_node() - NODE_READ: %s while reading variable '%s'.",
+                read == EOF ? "end of the input" : "invalid input", name);
+        }
+        if (ctx->input_log) input_log_save(ctx->input_log, &val);
+    }
+
+    int i = eval_index(ctx, index);
+    if (!set_variable_value_from_eval(ctx, v, val, i)) {
+        context_error(ctx, "execute_node() - NODE_READ: assignment failed (unsupported type).");
+    }
+}
+
+/**
+ * @brief Reads or writes a whole list or a slice of it (NODE_LISTIO).
+ *
+ * @param v List, found with search_list() before the slice is evaluated.
+ * @param start Start of the slice (NULL for the whole list).
+ * @param end End of the slice (not included; NULL for the whole list).
+ */
+static void list_io(Context *ctx, Variable *v, int write, int binary, char *name, const EvalResult *start,
+    const EvalResult *end, char *path) {
+    int first = 0, last = v->size;
+    if (start) {
+        first = (start->type == T_INTEIRO) ? start->v.i : (int)start->v.d;
+        last = (end->type == T_INTEIRO) ? end->v.i : (int)end->v.d;
+    }
+    if (first < 0 || first > last || last > v->size) {
+        context_error(ctx, "execute_node() - NODE_LISTIO: slice [%d, %d) out of range.", first, last);
+    }
+
+    /* Checked before opening the file, so a failure does not leave it open. */
+    if (write && !v->initialized) {
+        context_error(ctx, "execute_node() - NODE_LISTIO: variable '%s' not initialized.", name);
+    }
+
+    FILE *f;
+    if (path) {
+        const char *mode = write ? (binary ? "wb" : "w") : (binary ? "rb" : "r");
+        f = fopen(path, mode);
+        if (!f) {
+            context_error(ctx, "fopen() failed: %s", strerror(errno));
+        }
+    } else {
+        f = write ? ctx->out : ctx->in;
+    }
+
+    int ok;
+    if (write) {
+        if (!path && ctx->budget.max_output_bytes) budget_output(ctx, list_output_size(v, first, last, binary));
+        ok = write_list(f, v, first, last, binary);
+    } else {
+        alloc_list_data(ctx, v);
+        v->generation++;
+        if (!path && ctx->input_log && input_log_replaying(ctx->input_log)) {
+            input_log_next_list(ctx, ctx->input_log, v, first, last);
+            ok = 1;
+        } else {
+            /* In chunks, so the watchdog stops a long read (and a read it interrupted is not reported as an error). */
+            ok = 1;
+            for (int i = first; ok && i < last; i += BUDGET_LIST_CHUNK) {
+                ok = read_list(f, v, i, last - i > BUDGET_LIST_CHUNK ? i + BUDGET_LIST_CHUNK : last, binary);
+                BUDGET_POLL(ctx);
             }
+            if (ok && !path && ctx->input_log) input_log_save_list(ctx->input_log, v, first, last);
+        }
+        v->initialized = 1;
+    }
+
+    if (path && fclose(f) != 0) ok = 0;
+    if (!ok) {
+        context_error(ctx, "execute_node() - NODE_LISTIO: %s of list '%s' failed.", write ? "write" : "read", name);
+    }
+}
+
+/**
+ * @brief Fills or scales a whole list (NODE_LISTOP).
+ *
+ * @param v List, found with search_list() before the value is evaluated.
+ */
+static void list_op(Context *ctx, Variable *v, Intrinsic op, char *name, EvalResult val) {
+    const Kernels *k = get_kernels();
+
+    v->generation++;
+    if (op == I_PREENCHE) {
+        alloc_list_data(ctx, v);
+        v->initialized = 1;
+    } else if (!v->initialized) {
+        context_error(ctx, "execute_node() - NODE_LISTOP: variable '%s' not initialized.", name);
+    }
+
+    /* In chunks, so the watchdog of --max-time stops a long one. */
+    for (int start = 0; start < v->size; start += BUDGET_LIST_CHUNK) {
+        int n = v->size - start > BUDGET_LIST_CHUNK ? BUDGET_LIST_CHUNK : v->size - start;
+        int *ints = (int *)v->data + start;
+        double *reals = (double *)v->data + start;
+
+        if (op == I_PREENCHE) {
+            if (v->type == T_LISTAINT) k->fill_int(ints, n, (val.type == T_INTEIRO) ? val.v.i : (int)val.v.d);
+            else k->fill_real(reals, n, (val.type == T_INTEIRO) ? (double)val.v.i : val.v.d);
+        } else if (v->type == T_LISTAREAL) {
+            k->scale_real(reals, n, (val.type == T_INTEIRO) ? (double)val.v.i : val.v.d);
+        } else if (val.type == T_INTEIRO) {
+            k->scale_int(ints, n, val.v.i);
+        } else {
+            /* Same truncation as assigning a real expression to an element of a LISTAINT. */
+            for (int i = 0; i < n; i++) ints[i] = (int)(ints[i] * val.v.d);
+        }
+        BUDGET_POLL(ctx);
+    }
+}
+
+/* Body of eval_node(), which attributes the samples of --perf=sample to the type of the node. */
+static EvalResult eval_tree(Context *ctx, Node *n) {
+    EvalResult r;
+    if (!n) { r.type = T_REAL; r.v.d = 0.0; return r; }
+
+    TRACE(TRACE_AST, EV_EVAL, n->type, NULL);
+
+    switch (n->type) {
+        case NODE_INT:
+            r.type = T_INTEIRO;
+            r.v.i = n->intval;
+            return r;
+        case NODE_REAL:
+            r.type = T_REAL;
+            r.v.d = n->realval;
             return r;
+        case NODE_VAR:
+            return load_variable(ctx, n->var.name, n->var.index);
+        case NODE_BINOP:
+        {
+            EvalResult left = eval_node(ctx, n->binop.left);
+            EvalResult right = eval_node(ctx, n->binop.right);
+            return eval_arithmetic(ctx, n->binop.op, left, right);
         }
         case NODE_RELOP:
         {
-            #ifdef DEBUG
-                printf("[AST] - Evaluating NODE_RELOP\n");
-            #endif
-
-            EvalResult left = eval_node(n->relop.left);
+            EvalResult left = eval_node(ctx, n->relop.left);
             if (n->relop.op == R_NAO) {
                 r.v.i = !left.v.i;
             } else {
-                EvalResult right = eval_node(n->relop.right);
-                double ld = (left.type == T_INTEIRO) ? (double)left.v.i : left.v.d;
-                double rd = (right.type == T_INTEIRO) ? (double)right.v.i : right.v.d;
-
-                switch (n->relop.op) {
-                    case R_MAQ: r.v.i = ld > rd; break;
-                    case R_MAI: r.v.i = ld >= rd; break;
-                    case R_MEQ: r.v.i = ld < rd; break;
-                    case R_MEI: r.v.i = ld <= rd; break;
-                    case R_IGU: r.v.i = ld == rd; break;
-                    case R_DIF: r.v.i = ld != rd; break;
-                    case R_OU: r.v.i = ld || rd; break;
-                    case R_E: r.v.i = ld && rd; break;
-                    default: r.v.i = 0;
-                }
+                r.v.i = eval_compare(n->relop.op, left, eval_node(ctx, n->relop.right));
             }
             r.type = T_INTEIRO;
             return r;
         }
+        case NODE_INTRINSIC:
+            return eval_intrinsic(ctx, n->intrinsic.op, n->intrinsic.name, n->intrinsic.other);
+        case NODE_TEMP:
+            if (!n->temp.expr) return load_temp(ctx, n->temp.slot);
+            return save_temp(ctx, n->temp.slot, eval_node(ctx, n->temp.expr));
         default:
-            fprintf(stderr, "eval_node(): unsupported node type '%d'.\n", n->type);
-            exit(1);
+            context_error(ctx, "eval_node(): unsupported node type '%d'.", n->type);
     }
 }
 
-void execute_node(Node *n) {
+EvalResult eval_node(Context *ctx, Node *n) {
+    if (!perf_sampling || !n) return eval_tree(ctx, n);
+
+    int kind = perf_node_kind;
+    perf_node_kind = n->type;
+    EvalResult r = eval_tree(ctx, n);
+    perf_node_kind = kind;
+    return r;
+}
+
+/* Body of execute_node(). */
+static void execute_tree(Context *ctx, Node *n) {
     if (!n) return;
+    BUDGET_POLL(ctx);
+
+    TRACE(TRACE_AST, EV_EXECUTE, n->type, NULL);
     switch (n->type) {
         case NODE_BLOCK:
-            #ifdef DEBUG
-                printf("[AST] - Running NODE_BLOCK\n");
-            #endif
-
             for (int i = 0; i < n->block.count; i++) {
-                execute_node(n->block.cmds[i]);
+                execute_node(ctx, n->block.cmds[i]);
             }
+            if (n->block.iterations) BUDGET_TICK(ctx, n->block.iterations);
 
-            #ifdef DEBUG
-                printf("[AST] - End NODE_BLOCK\n");
-            #endif
-
+            TRACE(TRACE_AST, EV_EXECUTE_END, NODE_BLOCK, NULL);
             break;
         case NODE_DECL:
-        {
-            #ifdef DEBUG
-                printf("[AST] - Running NODE_DECL\n");
-            #endif
-
-            Variable *v = create_var(n->decl.name, n->decl.vartype, n->decl.size);
-            insert(variables, v);
+            declare_variable(ctx, n->decl.name, n->decl.vartype, n->decl.size);
             break;
-        }
         case NODE_ASSIGN:
         {
-            #ifdef DEBUG
-                printf("[AST] - Running NODE_ASSIGN\n");
-            #endif
-
-            EvalResult val = eval_node(n->assign.expr);
-            Variable *v = search(variables, n->assign.var->var.name);
-            if (!v) {
-                fprintf(stderr, "execute_node() - NODE_ASSIGN: undeclared variable '%s'.\n", n->assign.var->var.name);
-                exit(1);
-            }
-
-            int index = eval_index(n->assign.var->var.index);
-            if (!set_variable_value_from_eval(v, val, index)) {
-                fprintf(stderr, "execute_node() - NODE_ASSIGN: assignment failed (unsupported type).\n");
-                exit(1);
-            }
+            EvalResult val = eval_node(ctx, n->assign.expr);
+            assign_variable(ctx, n->assign.var->var.name, n->assign.var->var.index, val);
             break;
         }
         case NODE_IF:
         {
-            #ifdef DEBUG
-                printf("[AST] - Running NODE_IF\n");
-            #endif
-
-            EvalResult cond = eval_node(n->ifnode.cond);
+            EvalResult cond = eval_node(ctx, n->ifnode.cond);
             if (cond.v.i) {
-                execute_node(n->ifnode.then_block);
+                execute_node(ctx, n->ifnode.then_block);
             } else if (n->ifnode.else_block) {
-                execute_node(n->ifnode.else_block);
+                execute_node(ctx, n->ifnode.else_block);
             }
             break;
         }
         case NODE_WHILE:
         {
-            #ifdef DEBUG
-                printf("[AST] - Running NODE_WHILE\n");
-            #endif
+            if (ctx->tier_threshold) {
+                tier_execute_while(ctx, n);
+                break;
+            }
 
             while (1) {
-                EvalResult cond = eval_node(n->whilenode.cond);
+                EvalResult cond = eval_node(ctx, n->whilenode.cond);
                 if (!cond.v.i) break;
-                execute_node(n->whilenode.body);
+                execute_node(ctx, n->whilenode.body);
+                BUDGET_TICK(ctx, n->whilenode.copies);
+                if (ctx->checkpoint) checkpoint_tick(ctx, n);
             }
             break;
         }
         case NODE_WRITE:
-        {
-            #ifdef DEBUG
-                printf("[AST] - Running NODE_WRITE\n");
-            #endif
-
             if (!n->writenode.var) {
-                printf("%s\n", n->writenode.string);
+                write_value(ctx, n->writenode.string, NULL);
             } else {
-                EvalResult val = eval_node(n->writenode.var);
-                if (val.type == T_INTEIRO) {
-                    if (n->writenode.string) {
-                        printf("%s%d\n", n->writenode.string, val.v.i);
-                    } else {
-                        printf("%d\n", val.v.i);
-                    }
-                } else {
-                    if (n->writenode.string) {
-                        printf("%s%lf\n", n->writenode.string, val.v.d);
-                    } else {
-                        printf("%lf\n", val.v.d);
-                    }
-                }
+                EvalResult val = eval_node(ctx, n->writenode.var);
+                write_value(ctx, n->writenode.string, &val);
             }
             break;
-        }
         case NODE_READ:
+            read_variable(ctx, n->readnode.var->var.name, n->readnode.var->var.index);
+            break;
+        case NODE_LISTIO:
         {
-            #ifdef DEBUG
-                printf("[AST] - Running NODE_READ\n");
-            #endif
-
-            EvalResult val;
-            Variable *v = search(variables, n->readnode.var->var.name);
-            if (!v) {
-                fprintf(stderr, "execute_node() - NODE_READ: undeclared variable '%s'.\n", n->readnode.var->var.name);
-                exit(1);
+            Variable *v = search_list(ctx, n->listio.name, "execute_node() - NODE_LISTIO");
+            if (n->listio.range.start) {
+                EvalResult s = eval_node(ctx, n->listio.range.start);
+                EvalResult e = eval_node(ctx, n->listio.range.end);
+                list_io(ctx, v, n->listio.write, n->listio.binary, n->listio.name, &s, &e, n->listio.path);
+            } else {
+                list_io(ctx, v, n->listio.write, n->listio.binary, n->listio.name, NULL, NULL, n->listio.path);
             }
+            break;
+        }
+        case NODE_LISTOP:
+        {
+            Variable *v = search_list(ctx, n->listop.name, "execute_node() - NODE_LISTOP");
+            EvalResult val = eval_node(ctx, n->listop.expr);
+            list_op(ctx, v, n->listop.op, n->listop.name, val);
+            break;
+        }
+        default:
+            context_error(ctx, "execute_node(): unsupported node type '%d'.", n->type);
+    }
+}
+
+void execute_node(Context *ctx, Node *n) {
+    if (!perf_sampling || !n) {
+        execute_tree(ctx, n);
+        return;
+    }
+
+    int kind = perf_node_kind;
+    perf_node_kind = n->type;
+    execute_tree(ctx, n);
+    perf_node_kind = kind;
+}
+
+void resume_node(Context *ctx, Node *n, const uint32_t *position, int depth) {
+    if (n && depth == 0 && n->type == NODE_WHILE) {
+        /* The body was just executed, so the loop goes on by testing its condition. */
+        execute_node(ctx, n);
+        return;
+    }
+
+    if (n && depth > 0) {
+        uint32_t i = position[0];
+        switch (n->type) {
+            case NODE_BLOCK:
+                if (i >= (uint32_t)n->block.count) break;
+                resume_node(ctx, n->block.cmds[i], position + 1, depth - 1);
+                for (int j = (int)i + 1; j < n->block.count; j++) {
+                    execute_node(ctx, n->block.cmds[j]);
+                }
+                if (n->block.iterations) BUDGET_TICK(ctx, n->block.iterations);
+                return;
+            case NODE_IF:
+                if (i > 1) break;
+                resume_node(ctx, i ? n->ifnode.else_block : n->ifnode.then_block, position + 1, depth - 1);
+                return;
+            case NODE_WHILE:
+                if (i != 0) break;
+                resume_node(ctx, n->whilenode.body, position + 1, depth - 1);
+                BUDGET_TICK(ctx, n->whilenode.copies);
+                execute_node(ctx, n);
+                return;
+            default:
+                break;
+        }
+    }
+    context_error(ctx, "restore: the position of the snapshot is not in the program.");
+}
+
+/* Interpreter of the compact AST (see compact.h). */
 
-            if (v->type == T_INTEIRO || v->type == T_LISTAINT) {
-                val.type = T_INTEIRO;
-                scanf("%d", &val.v.i);
+/**
+ * @brief Returns the Index of a NODE_VAR of the compact AST.
+ */
+static Index compact_index(const CompactAst *ast, uint32_t n) {
+    Index index;
+    if (ast->op[n]) {
+        index.type = VARIABLE;
+        index.value.name = ast->strings[ast->b[n]];
+    } else {
+        index.type = INTEGER;
+        index.value.integer = (int)ast->b[n];
+    }
+    return index;
+}
+
+static char *compact_string(const CompactAst *ast, uint32_t i) {
+    return i != COMPACT_NONE ? ast->strings[i] : NULL;
+}
+
+/* Body of eval_compact(). */
+static EvalResult eval_compact_node(Context *ctx, const CompactAst *ast, uint32_t n) {
+    EvalResult r;
+    if (n == COMPACT_NONE) { r.type = T_REAL; r.v.d = 0.0; return r; }
+
+    NodeType kind = (NodeType)ast->kind[n];
+    uint32_t a = ast->a[n], b = ast->b[n];
+    TRACE(TRACE_AST, EV_EVAL, kind, NULL);
+
+    switch (kind) {
+        case NODE_INT:
+            r.type = T_INTEIRO;
+            r.v.i = (int)a;
+            return r;
+        case NODE_REAL:
+            r.type = T_REAL;
+            r.v.d = ast->reals[a];
+            return r;
+        case NODE_VAR:
+            return load_variable(ctx, ast->strings[a], compact_index(ast, n));
+        case NODE_BINOP:
+        {
+            EvalResult left = eval_compact(ctx, ast, a);
+            EvalResult right = eval_compact(ctx, ast, b);
+            return eval_arithmetic(ctx, (BinOp)ast->op[n], left, right);
+        }
+        case NODE_RELOP:
+        {
+            EvalResult left = eval_compact(ctx, ast, a);
+            if (ast->op[n] == R_NAO) {
+                r.v.i = !left.v.i;
             } else {
-                val.type = T_REAL;
-                scanf("%lf", &val.v.d);
+                r.v.i = eval_compare((RelOp)ast->op[n], left, eval_compact(ctx, ast, b));
+            }
+            r.type = T_INTEIRO;
+            return r;
+        }
+        case NODE_INTRINSIC:
+            return eval_intrinsic(ctx, (Intrinsic)ast->op[n], ast->strings[a], compact_string(ast, b));
+        case NODE_TEMP:
+            if (b == COMPACT_NONE) return load_temp(ctx, (int)a);
+            return save_temp(ctx, (int)a, eval_compact(ctx, ast, b));
+        default:
+            context_error(ctx, "eval_node(): unsupported node type '%d'.", kind);
+    }
+}
+
+EvalResult eval_compact(Context *ctx, const CompactAst *ast, uint32_t n) {
+    if (!perf_sampling || n == COMPACT_NONE) return eval_compact_node(ctx, ast, n);
+
+    int kind = perf_node_kind;
+    perf_node_kind = ast->kind[n];
+    EvalResult r = eval_compact_node(ctx, ast, n);
+    perf_node_kind = kind;
+    return r;
+}
+
+/* Body of execute_compact(). */
+static void execute_compact_node(Context *ctx, const CompactAst *ast, uint32_t n) {
+    if (n == COMPACT_NONE) return;
+    BUDGET_POLL(ctx);
+
+    NodeType kind = (NodeType)ast->kind[n];
+    uint32_t a = ast->a[n], b = ast->b[n], c = ast->c[n];
+    TRACE(TRACE_AST, EV_EXECUTE, kind, NULL);
+
+    switch (kind) {
+        case NODE_BLOCK:
+            for (uint32_t i = 0; i < b; i++) {
+                execute_compact(ctx, ast, ast->lists[a + i]);
             }
+            if (c) BUDGET_TICK(ctx, c);
 
-            int index = eval_index(n->readnode.var->var.index);
-            if (!set_variable_value_from_eval(v, val, index)) {
-                fprintf(stderr, "execute_node() - NODE_READ: assignment failed (unsupported type).\n");
-                exit(1);
+            TRACE(TRACE_AST, EV_EXECUTE_END, NODE_BLOCK, NULL);
+            break;
+        case NODE_DECL:
+            declare_variable(ctx, ast->strings[a], (Types)ast->op[n], (int)b);
+            break;
+        case NODE_ASSIGN:
+        {
+            EvalResult val = eval_compact(ctx, ast, a);
+            assign_variable(ctx, ast->strings[ast->a[b]], compact_index(ast, b), val);
+            break;
+        }
+        case NODE_IF:
+        {
+            EvalResult cond = eval_compact(ctx, ast, a);
+            if (cond.v.i) {
+                execute_compact(ctx, ast, b);
+            } else if (c != COMPACT_NONE) {
+                execute_compact(ctx, ast, c);
             }
             break;
         }
+        case NODE_WHILE:
+        {
+            while (1) {
+                EvalResult cond = eval_compact(ctx, ast, a);
+                if (!cond.v.i) break;
+                execute_compact(ctx, ast, b);
+                BUDGET_TICK(ctx, c);
+            }
+            break;
+        }
+        case NODE_WRITE:
+            if (b == COMPACT_NONE) {
+                write_value(ctx, compact_string(ast, a), NULL);
+            } else {
+                EvalResult val = eval_compact(ctx, ast, b);
+                write_value(ctx, compact_string(ast, a), &val);
+            }
+            break;
+        case NODE_READ:
+            read_variable(ctx, ast->strings[ast->a[a]], compact_index(ast, a));
+            break;
+        case NODE_LISTIO:
+        {
+            char *name = ast->strings[a];
+            int write = ast->op[n] & 1, binary = (ast->op[n] & 2) != 0;
+            Variable *v = search_list(ctx, name, "execute_node() - NODE_LISTIO");
+            if (c != COMPACT_NONE) {
+                EvalResult s = eval_compact(ctx, ast, ast->lists[c]);
+                EvalResult e = eval_compact(ctx, ast, ast->lists[c + 1]);
+                list_io(ctx, v, write, binary, name, &s, &e, compact_string(ast, b));
+            } else {
+                list_io(ctx, v, write, binary, name, NULL, NULL, compact_string(ast, b));
+            }
+            break;
+        }
+        case NODE_LISTOP:
+        {
+            Variable *v = search_list(ctx, ast->strings[a], "execute_node() - NODE_LISTOP");
+            EvalResult val = eval_compact(ctx, ast, b);
+            list_op(ctx, v, (Intrinsic)ast->op[n], ast->strings[a], val);
+            break;
+        }
         default:
-            fprintf(stderr, "execute_node(): unsupported node type '%d'.\n", n->type);
-            exit(1);
+            context_error(ctx, "execute_node(): unsupported node type '%d'.", kind);
     }
 }
+
+void execute_compact(Context *ctx, const CompactAst *ast, uint32_t n) {
+    if (!perf_sampling || n == COMPACT_NONE) {
+        execute_compact_node(ctx, ast, n);
+        return;
+    }
+
+    int kind = perf_node_kind;
+    perf_node_kind = ast->kind[n];
+    execute_compact_node(ctx, ast, n);
+    perf_node_kind = kind;
+}
@@ -1,31 +1,24 @@
 #ifndef AST_H
 #define AST_H
 
+#include <stdint.h>
 #include "types.h"
+#include "nodetype.h"
+
+/* Compilation context (see context.h). */
+typedef struct Context Context;
 
 /**
  * @enum NodeType
  *
- * @brief Possible types of nodes in the AST.
+ * @brief Possible types of nodes in the AST (listed in nodetype.h).
  *
  * Nodes are divided into nodes that result in some value, and nodes that represent some action.
  */
 typedef enum NodeType {
-    /* Action nodes. */
-    NODE_BLOCK,     // Contains nodes to be executed.
-    NODE_DECL,      // Node representing a statement.
-    NODE_ASSIGN,    // Node representing an assignment.
-    NODE_IF,        // Node representing an if.
-    NODE_WHILE,     // Node representing a while.
-    NODE_WRITE,     // Node representing a printf.
-    NODE_READ,      // Node representing a scanf.
-
-    /* Value nodes. */
-    NODE_INT,       // Node representing an integer.
-    NODE_REAL,      // Node representing a real.
-    NODE_VAR,       // Node representing a variable.
-    NODE_BINOP,     // Node representing a BinOp expression.
-    NODE_RELOP,     // Node representing a RelOP expression.
+    NODE_TYPES(NODE_TYPE_ENUM)
+
+    NODE_COUNT,     // Number of node types (not a node).
 } NodeType;
 
 /**
@@ -59,6 +52,18 @@ typedef struct Index {
     } value;
 } Index;
 
+/**
+ * @struct ListRange
+ *
+ * @brief Helper for passing the slice of a list from bison.
+ *
+ * Both fields are NULL when the whole list is used.
+ */
+typedef struct ListRange {
+    struct Node *start;
+    struct Node *end;
+} ListRange;
+
 /**
  * @struct Node
  *
@@ -69,8 +74,8 @@ typedef struct Index {
 typedef struct Node {
     NodeType type;
     union {
-        /* Program / block. */
-        struct { struct Node **cmds; int count; } block;
+        /* Program / block (iterations: loop iterations it stands for, charged after it runs; see optimize()). */
+        struct { struct Node **cmds; int count; int iterations; } block;
 
         /* Declaration. */
         struct { Types vartype; char *name; int size; } decl;
@@ -81,8 +86,8 @@ typedef struct Node {
         /* If. */
         struct { struct Node *cond; struct Node *then_block; struct Node *else_block; } ifnode;
 
-        /* While. */
-        struct { struct Node *cond; struct Node *body; } whilenode;
+        /* While (copies: iterations of the source loop done by each iteration, more than 1 once unrolled). */
+        struct { struct Node *cond; struct Node *body; int copies; } whilenode;
 
         /* Write. */
         struct { char *string; struct Node *var; } writenode;
@@ -90,6 +95,9 @@ typedef struct Node {
         /* Read. */
         struct { struct Node *var; } readnode;
 
+        /* Bulk list read/write. */
+        struct { int write; int binary; char *name; ListRange range; char *path; } listio;
+
         /* Literals. */
         int intval;
         double realval;
@@ -102,18 +110,37 @@ typedef struct Node {
 
         /* Relational op. */
         struct { RelOp op; struct Node *left; struct Node *right; } relop;
+
+        /* List intrinsic (other is only used by the dot product). */
+        struct { Intrinsic op; char *name; char *other; } intrinsic;
+
+        /* List modification. */
+        struct { Intrinsic op; char *name; struct Node *expr; } listop;
+
+        /* Temporary: saves the value of expr in the slot, or only reads the slot if expr is NULL. */
+        struct { int slot; struct Node *expr; } temp;
     };
 } Node;
 
+/**
+ * @brief Returns the name of a node type (e.g. "NODE_BLOCK").
+ *
+ * @param type Node type.
+ *
+ * @return The name, or "NODE_?" if the type is invalid.
+ */
+const char *node_type_name(NodeType type);
+
 /**
  * @brief Adds a child node to the specified node.
  *
  * The node specified must be of type NODE_BLOCK, as the child will be saved in cmds.
  *
+ * @param ctx Compilation context.
  * @param n The parent node.
  * @param child The node to be added.
  */
-void add_child(Node *n, Node *child);
+void add_child(Context *ctx, Node *n, Node *child);
 
 /**
  * @brief Adds a valid type for variables in decl nodes.
@@ -129,142 +156,205 @@ void change_untypeds(Node **cmds, int length, Types type);
  *
  * The nodes must be of type NODE_BLOCK.
  *
+ * @param ctx Compilation context.
  * @param n1 First node.
  * @param n2 Second node.
  *
  * @return The new node.
  */
-Node *join_blocks(Node *n1, Node *n2);
+Node *join_blocks(Context *ctx, Node *n1, Node *n2);
 
 /**
  * @brief Creates a node of type NODE_BLOCK.
  *
+ * @param ctx Compilation context.
  * @param cmds Vector of action nodes.
  * @param count Number of items in the vector.
  *
  * @return A pointer to the created node.
  */
-Node *make_block(Node **cmds, int count);
+Node *make_block(Context *ctx, Node **cmds, int count);
 
 /**
  * @brief Creates a node of type NODE_DECL.
  *
+ * @param ctx Compilation context.
  * @param type Variable type.
  * @param name Variable name.
  * @param size Vector size (used only if it is a vector type).
  *
  * @return A pointer to the created node.
  */
-Node *make_decl(Types type, const char *name, int size);
+Node *make_decl(Context *ctx, Types type, const char *name, int size);
 
 /**
  * @brief Creates a node of type NODE_ASSIGN.
  *
+ * @param ctx Compilation context.
  * @param expr Node representing the expression that will result in the value of the variable.
  * @param var Node of type NODE_VAR.
  *
  * @return A pointer to the created node.
  */
-Node *make_assign(Node *expr, Node *var);
+Node *make_assign(Context *ctx, Node *expr, Node *var);
 
 /**
  * @brief Creates a node of type NODE_IF.
  *
+ * @param ctx Compilation context.
  * @param cond Node representing the expression that will result in the boolean value of the condition.
  * @param then_block Node representing the code that will be executed if true.
  * @param else_block Node representing the code that will be executed if false (can be NULL).
  *
  * @return A pointer to the created node.
  */
-Node *make_if(Node *cond, Node *then_block, Node *else_block);
+Node *make_if(Context *ctx, Node *cond, Node *then_block, Node *else_block);
 
 /**
  * @brief Creates a node of type NODE_WHILE.
  *
+ * @param ctx Compilation context.
  * @param cond Node representing the expression that will result in the boolean value of the condition.
  * @param body Node representing the code that will be executed while true.
  *
  * @return A pointer to the created node.
  */
-Node *make_while(Node *cond, Node *body);
+Node *make_while(Context *ctx, Node *cond, Node *body);
 
 /**
  * @brief Creates a node of type NODE_INT.
  *
+ * @param ctx Compilation context.
  * @param v Integer value.
  *
  * @return A pointer to the created node.
  */
-Node *make_int(int v);
+Node *make_int(Context *ctx, int v);
 
 /**
  * @brief Creates a node of type NODE_REAL.
  *
+ * @param ctx Compilation context.
  * @param v Double value.
  *
  * @return A pointer to the created node.
  */
-Node *make_real(double v);
+Node *make_real(Context *ctx, double v);
 
 /**
  * @brief Calculates the index stored in the Index structure.
  *
+ * @param ctx Compilation context.
  * @param index Index structure.
  *
  * @return The calculated index.
  */
-int eval_index(Index index);
+int eval_index(Context *ctx, Index index);
 
 /**
  * @brief Creates a node of type NODE_VAR.
  *
+ * @param ctx Compilation context.
  * @param name Variable name.
  * @param index Index of the vector (if is a vector type).
  *
  * @return A pointer to the created node.
  */
-Node *make_var(const char *name, Index index);
+Node *make_var(Context *ctx, const char *name, Index index);
 
 /**
  * @brief Creates a node of type NODE_BINOP.
  *
+ * @param ctx Compilation context.
  * @param op Arithmetic operator.
  * @param left Node representing the expression that will result in the value of the left side.
  * @param right Node representing the expression that will result in the value of the right side.
  *
  * @return A pointer to the created node.
  */
-Node *make_binop(BinOp op, Node *left, Node *right);
+Node *make_binop(Context *ctx, BinOp op, Node *left, Node *right);
 
 /**
  * @brief Creates a node of type NODE_RELOP.
  *
+ * @param ctx Compilation context.
  * @param op Relational operator.
  * @param left Node representing the expression that will result in the value of the left side.
  * @param right Node representing the expression that will result in the value of the right side.
  *
  * @return A pointer to the created node.
  */
-Node *make_relop(RelOp op, Node *left, Node *right);
+Node *make_relop(Context *ctx, RelOp op, Node *left, Node *right);
 
 /**
  * @brief Creates a node of type NODE_WRITE.
  *
+ * @param ctx Compilation context.
  * @param string String to be printed.
  * @param var Node of type NODE_VAR.
  *
  * @return A pointer to the created node.
  */
-Node *make_write(const char *string, Node *var);
+Node *make_write(Context *ctx, const char *string, Node *var);
 
 /**
  * @brief Creates a node of type NODE_READ.
  *
+ * @param ctx Compilation context.
  * @param name Node of type NODE_VAR.
  *
  * @return A pointer to the created node.
  */
-Node *make_read(Node *var);
+Node *make_read(Context *ctx, Node *var);
+
+/**
+ * @brief Creates a node of type NODE_LISTIO.
+ *
+ * @param ctx Compilation context.
+ * @param write 1 to write the list, 0 to read it.
+ * @param binary 1 for raw little-endian values, 0 for text separated by whitespace.
+ * @param name List name.
+ * @param range Slice of the list (start and end can be NULL to use the whole list).
+ * @param path File to be used (NULL for stdin/stdout).
+ *
+ * @return A pointer to the created node.
+ */
+Node *make_listio(Context *ctx, int write, int binary, const char *name, ListRange range, const char *path);
+
+/**
+ * @brief Creates a node of type NODE_INTRINSIC.
+ *
+ * @param ctx Compilation context.
+ * @param op Intrinsic that results in a value (I_SOMA, I_MEDIA, I_MINIMO, I_MAXIMO, I_PRODESCALAR).
+ * @param name List name.
+ * @param other Second list name (only used by I_PRODESCALAR, NULL otherwise).
+ *
+ * @return A pointer to the created node.
+ */
+Node *make_intrinsic(Context *ctx, Intrinsic op, const char *name, const char *other);
+
+/**
+ * @brief Creates a node of type NODE_LISTOP.
+ *
+ * @param ctx Compilation context.
+ * @param op Intrinsic that modifies the list (I_PREENCHE, I_ESCALA).
+ * @param name List name.
+ * @param expr Node representing the expression with the value (fill) or the factor (scale).
+ *
+ * @return A pointer to the created node.
+ */
+Node *make_listop(Context *ctx, Intrinsic op, const char *name, Node *expr);
+
+/**
+ * @brief Creates a node of type NODE_TEMP.
+ *
+ * @param ctx Compilation context.
+ * @param slot Index of the temporary in the context of the run.
+ * @param expr Node representing the expression whose value is saved in the slot (NULL to read the saved value).
+ *
+ * @return A pointer to the created node.
+ */
+Node *make_temp(Context *ctx, int slot, Node *expr);
 
 /**
  * @brief Recursively frees memory.
@@ -274,19 +364,84 @@ Node *make_read(Node *var);
 void free_node(Node *n);
 
 /**
- * @brief Calculates the value of nodes of type: NODE_INT, NODE_REAL, NODE_VAR, NODE_BINOP, NODE_RELOP.
+ * @brief Copies a tree (with the make_* functions).
+ *
+ * @param ctx Context.
+ * @param n Root of the tree (can be NULL).
+ *
+ * @return The copy (NULL if n is NULL).
+ */
+Node *copy_node(Context *ctx, const Node *n);
+
+/**
+ * @brief Calculates a 64-bit hash (FNV-1a) of a tree.
+ *
+ * The hash covers the types, values, names and shape of the nodes, not their addresses, so the same source always
+ * results in the same hash, in any run.
+ *
+ * @param n Root of the tree (can be NULL).
+ *
+ * @return The hash.
+ */
+uint64_t hash_node(const Node *n);
+
+/**
+ * @brief Calculates an arithmetic operation, as a NODE_BINOP does.
  *
+ * Integers are only promoted to real if the other operand is real. An integer division by zero, or of the smallest
+ * integer by -1, is reported with context_error().
+ *
+ * @param ctx Compilation context.
+ * @param op Operator.
+ * @param left Value of the left side.
+ * @param right Value of the right side.
+ *
+ * @return The result.
+ */
+EvalResult eval_arithmetic(Context *ctx, BinOp op, EvalResult left, EvalResult right);
+
+/**
+ * @brief Calculates a relational or logical operation with two operands, as a NODE_RELOP other than .NAO. does.
+ *
+ * @param op Operator.
+ * @param left Value of the left side.
+ * @param right Value of the right side.
+ *
+ * @return 1 if true, 0 if false.
+ */
+int eval_compare(RelOp op, EvalResult left, EvalResult right);
+
+/**
+ * @brief Calculates the value of nodes of type: NODE_INT, NODE_REAL, NODE_VAR, NODE_BINOP, NODE_RELOP, NODE_INTRINSIC,
+ * NODE_TEMP.
+ *
+ * @param ctx Compilation context.
  * @param n Node to be calculated.
  *
  * @return The result of the calculation.
  */
-EvalResult eval_node(Node *n);
+EvalResult eval_node(Context *ctx, Node *n);
 
 /**
- * @brief Execute the corresponding codes (NODE_BLOCK, NODE_DECL, NODE_ASSIGN, NODE_IF, NODE_WHILE).
+ * @brief Execute the corresponding codes (NODE_BLOCK, NODE_DECL, NODE_ASSIGN, NODE_IF, NODE_WHILE, NODE_WRITE, NODE_READ,
+ * NODE_LISTIO, NODE_LISTOP).
  *
+ * @param ctx Compilation context.
  * @param n Node representing the code.
  */
-void execute_node(Node *n);
+void execute_node(Context *ctx, Node *n);
+
+/**
+ * @brief Continues a run from the back edge of a loop, where a snapshot was saved (see checkpoint.h).
+ *
+ * The statements before the position are not executed again: the variables already have the values they had there.
+ *
+ * @param ctx Compilation context, with the variables of the snapshot.
+ * @param n Node on the path to the loop (the root of the program, at first).
+ * @param position Child taken at each node of the path: the statement of a NODE_BLOCK, the branch of a NODE_IF
+ * (0: then, 1: else), or the body of a NODE_WHILE (always 0).
+ * @param depth Length of the path (0: n is the loop).
+ */
+void resume_node(Context *ctx, Node *n, const uint32_t *position, int depth);
 
 #endif // AST_H
\ No newline at end of file
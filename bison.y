@@ -1,14 +1,54 @@
+%code requires {
+    #include "ast.h"
+    #include "types.h"
+
+    /* Scanner state (yyscan_t of the reentrant scanner). */
+    typedef void *yyscan_t;
+}
+
 %{
     #include "ast.h"
     #include "types.h"
     #include "variables.h"
+    #include "optimizer.h"
+    #include "context.h"
+    #include "trace.h"
+    #include "stats.h"
+    #include "perf.h"
+    #include "checkpoint.h"
+    #include "cache.h"
+    #include "driver.h"
+    #include "pipeio.h"
+    #include "scanner.h"
+    #include <unistd.h>
+    #include <limits.h>
+    #include <errno.h>
+%}
 
-    List *variables;
+%code {
+    /* Functions of the reentrant scanner (lex.yy.c). */
+    int yylex(YYSTYPE *lvalp, yyscan_t scanner);
+    int yylex_init_extra(Context *ctx, yyscan_t *scanner);
+    int yylex_destroy(yyscan_t scanner);
+    void yyset_in(FILE *in, yyscan_t scanner);
 
-    extern FILE *yyin;
-    int yylex(void);
-    void yyerror(const char *s);
-%}
+    void yyerror(yyscan_t scanner, Context *ctx, const char *s);
+
+    /*
+     * The parser calls the scanner through timed_yylex(), so the time spent lexing can be estimated (from a sample
+     * of the tokens, see STATS_LEX_SAMPLED()) and the hand-written scanner (scanner.c) can be used instead of flex.
+     */
+    static int timed_yylex(YYSTYPE *lvalp, yyscan_t scanner, Context *ctx);
+    #define yylex timed_yylex
+
+    static Node *stream_node(Context *ctx, Node *n);
+    static Node *append_command(Context *ctx, Node *block, Node *cmd);
+}
+
+/* Pure parser: all the state is in the parser stack, the scanner and the context. */
+
+%define api.pure full
+%param {yyscan_t scanner} {Context *ctx}
 
 /* Definition of possible types for terminals and non-terminals. */
 
@@ -23,18 +63,26 @@
     Types type;
     Flex flex;
     Variable var;
+    ListRange range;
+    Intrinsic intrinsic;
 }
 
 /* Definition of non-terminals. */
 
-%type <node> start program statements names algorithm commands assignment input input_vars output out_string if loop expression lower middle high complex relational high_relational
+%type <node> start program declarations statements names top_algorithm algorithm commands assignment input input_vars output out_string list_io list_op if loop expression lower middle high complex relational high_relational
+
+%type <range> list_range
+%type <integer> list_format
+%type <string> list_file
 
 %type <type> type
 %type <operand> r_operators b_operators
+%type <intrinsic> reductions
 
 /* Definition of terminals. */
 
 %token PROGRAMA FIMPROG ATRIB LEIA ESCREVA SE ENTAO SENAO FIMSE ENQUANTO FACA FIMENQ
+%token LEIALISTA ESCREVALISTA DE ATE BINARIO ARQUIVO COM POR
 
 %token <integer> N_INT
 %token <real> N_REAL
@@ -42,6 +90,7 @@
 
 %token <operand> NAO MAQ MAI MEQ MEI IGU DIF OU E
 %token <type> INTEIRO REAL LISTAINT LISTAREAL
+%token <intrinsic> SOMA MEDIA MINIMO MAXIMO PRODESCALAR PREENCHE ESCALA
 %token <flex> VAR_NAME
 
 /* Grammar. */
@@ -51,21 +100,26 @@
 start:
     PROGRAMA program FIMPROG
     {
-        execute_node($2);
-        free_node($2);
+        ctx->program = $2;
         $$ = $2;
     };
 
 program:
-    statements algorithm
+    declarations top_algorithm
+    {
+        $$ = ctx->streaming ? NULL : join_blocks(ctx, $1, $2);
+    };
+
+declarations:
+    statements
     {
-        $$ = join_blocks($1, $2);
+        $$ = stream_node(ctx, $1);
     };
 
 statements:
     type names statements {
         change_untypeds($2->block.cmds, $2->block.count, $1);
-        $$ = join_blocks($2, $3);
+        $$ = join_blocks(ctx, $2, $3);
     }
     | type names
     {
@@ -83,28 +137,44 @@ names:
     VAR_NAME ',' names
     {
         $$ = $3;
-        add_child($$, make_decl(T_UNTYPED, $1.name, $1.length));
+        add_child(ctx, $$, make_decl(ctx, T_UNTYPED, $1.name, $1.length));
+        free($1.name);
     }
     | VAR_NAME
     {
         Node **cmds = (Node **)malloc(sizeof(Node *));
-        cmds[0] = make_decl(T_UNTYPED, $1.name, $1.length);
+        cmds[0] = make_decl(ctx, T_UNTYPED, $1.name, $1.length);
+        free($1.name);
 
-        $$ = make_block(cmds, 1);
+        $$ = make_block(ctx, cmds, 1);
+    };
+
+/*
+ * Left recursive, unlike the blocks inside SE and ENQUANTO, so each top-level statement is reduced as soon as it is
+ * parsed (which is when context_stream() runs it) and the parser stack does not grow with the program.
+ */
+top_algorithm:
+    top_algorithm commands
+    {
+        $$ = append_command(ctx, $1, stream_node(ctx, $2));
+    }
+    | commands
+    {
+        $$ = append_command(ctx, NULL, stream_node(ctx, $1));
     };
 
 algorithm:
     commands algorithm
     {
         $$ = $2;
-        add_child($$, $1);
+        add_child(ctx, $$, $1);
     }
     | commands
     {
         Node **cmds = (Node **)malloc(sizeof(Node *));
         cmds[0] = $1;
 
-        $$ = make_block(cmds, 1);
+        $$ = make_block(ctx, cmds, 1);
     };
 
 commands:
@@ -120,6 +190,14 @@ commands:
     {
         $$ = $1;
     }
+    | list_io
+    {
+        $$ = $1;
+    }
+    | list_op
+    {
+        $$ = $1;
+    }
     | if
     {
         $$ = $1;
@@ -141,7 +219,8 @@ assignment:
             index.value.integer = $1.length;
         }
 
-        $$ = make_assign($3, make_var($1.name, index));
+        $$ = make_assign(ctx, $3, make_var(ctx, $1.name, index));
+        free($1.name);
     };
 
 input:
@@ -164,7 +243,8 @@ input_vars:
             index.value.integer = $1.length;
         }
 
-        add_child($$, make_read(make_var($1.name, index)));
+        add_child(ctx, $$, make_read(ctx, make_var(ctx, $1.name, index)));
+        free($1.name);
     }
     | VAR_NAME
     {
@@ -178,9 +258,10 @@ input_vars:
         }
 
         Node **cmds = (Node **)malloc(sizeof(Node *));
-        cmds[0] = make_read(make_var($1.name, index));
+        cmds[0] = make_read(ctx, make_var(ctx, $1.name, index));
+        free($1.name);
 
-        $$ = make_block(cmds, 1);
+        $$ = make_block(ctx, cmds, 1);
     };
 
 output:
@@ -201,11 +282,13 @@ out_string:
             index.value.integer = $1.length;
         }
 
-        $$ = make_write(NULL, make_var($1.name, index));
+        $$ = make_write(ctx, NULL, make_var(ctx, $1.name, index));
+        free($1.name);
     }
     | STRING
     {
-        $$ = make_write($1, NULL);
+        $$ = make_write(ctx, $1, NULL);
+        free($1);
     }
     | STRING ',' VAR_NAME
     {
@@ -218,23 +301,83 @@ out_string:
             index.value.integer = $3.length;
         }
 
-        $$ = make_write($1, make_var($3.name, index));
+        $$ = make_write(ctx, $1, make_var(ctx, $3.name, index));
+        free($1);
+        free($3.name);
+    };
+
+list_io:
+    LEIALISTA VAR_NAME list_range list_format list_file
+    {
+        $$ = make_listio(ctx, 0, $4, $2.name, $3, $5);
+        free($2.name);
+        free($5);
+    }
+    | ESCREVALISTA VAR_NAME list_range list_format list_file
+    {
+        $$ = make_listio(ctx, 1, $4, $2.name, $3, $5);
+        free($2.name);
+        free($5);
+    };
+
+list_op:
+    PREENCHE VAR_NAME COM expression
+    {
+        $$ = make_listop(ctx, $1, $2.name, $4);
+        free($2.name);
+    }
+    | ESCALA VAR_NAME POR expression
+    {
+        $$ = make_listop(ctx, $1, $2.name, $4);
+        free($2.name);
+    };
+
+list_range:
+    DE expression ATE expression
+    {
+        $$.start = $2;
+        $$.end = $4;
+    }
+    | %empty
+    {
+        $$.start = NULL;
+        $$.end = NULL;
+    };
+
+list_format:
+    BINARIO
+    {
+        $$ = 1;
+    }
+    | %empty
+    {
+        $$ = 0;
+    };
+
+list_file:
+    ARQUIVO STRING
+    {
+        $$ = $2;
+    }
+    | %empty
+    {
+        $$ = NULL;
     };
 
 if:
     SE complex ENTAO algorithm FIMSE
     {
-        $$ = make_if($2, $4, NULL);
+        $$ = make_if(ctx, $2, $4, NULL);
     }
     | SE complex ENTAO algorithm SENAO algorithm FIMSE
     {
-        $$ = make_if($2, $4, $6);
+        $$ = make_if(ctx, $2, $4, $6);
     };
 
 loop:
     ENQUANTO complex FACA algorithm FIMENQ
     {
-        $$ = make_while($2, $4);
+        $$ = make_while(ctx, $2, $4);
     };
 
 expression:
@@ -246,11 +389,11 @@ expression:
 lower:
     lower '+' middle
     {
-        $$ = make_binop(OP_ADD, $1, $3);
+        $$ = make_binop(ctx, OP_ADD, $1, $3);
     }
     | lower '-' middle
     {
-        $$ = make_binop(OP_SUB, $1, $3);
+        $$ = make_binop(ctx, OP_SUB, $1, $3);
     }
     | middle
     {
@@ -260,11 +403,11 @@ lower:
 middle:
     middle '*' high
     {
-        $$ = make_binop(OP_MUL, $1, $3);
+        $$ = make_binop(ctx, OP_MUL, $1, $3);
     }
     | middle '/' high
     {
-        $$ = make_binop(OP_DIV, $1, $3);
+        $$ = make_binop(ctx, OP_DIV, $1, $3);
     }
     | high
     {
@@ -274,11 +417,11 @@ middle:
 high:
     N_INT
     {
-        $$ = make_int($1);
+        $$ = make_int(ctx, $1);
     }
     | N_REAL
     {
-        $$ = make_real($1);
+        $$ = make_real(ctx, $1);
     }
     | VAR_NAME
     {
@@ -291,7 +434,19 @@ high:
             index.value.integer = $1.length;
         }
 
-        $$ = make_var($1.name, index);
+        $$ = make_var(ctx, $1.name, index);
+        free($1.name);
+    }
+    | reductions '(' VAR_NAME ')'
+    {
+        $$ = make_intrinsic(ctx, $1, $3.name, NULL);
+        free($3.name);
+    }
+    | PRODESCALAR '(' VAR_NAME ',' VAR_NAME ')'
+    {
+        $$ = make_intrinsic(ctx, $1, $3.name, $5.name);
+        free($3.name);
+        free($5.name);
     }
     | '(' lower ')'
     {
@@ -301,7 +456,7 @@ high:
 complex:
     relational b_operators high_relational
     {
-        $$ = make_relop($2, $1, $3);
+        $$ = make_relop(ctx, $2, $1, $3);
     }
     | high_relational
     {
@@ -311,13 +466,13 @@ complex:
 relational:
     expression r_operators expression
     {
-        $$ = make_relop($2, $1, $3);
+        $$ = make_relop(ctx, $2, $1, $3);
     };
 
 high_relational:
     NAO '(' relational ')'
     {
-        $$ = make_relop($1, $3 ,NULL);
+        $$ = make_relop(ctx, $1, $3 ,NULL);
     }
     | '(' relational ')'
     {
@@ -339,32 +494,706 @@ r_operators:
 b_operators:
     OU
     | E;
+
+reductions:
+    SOMA
+    | MEDIA
+    | MINIMO
+    | MAXIMO;
 %%
 
 /* Implementation of standard functions. */
 
-void yyerror(const char *s) {
-    fprintf(stderr, "An error has occurred: %s.\n", s);
+#undef yylex
+
+/**
+ * @brief Returns the next token of the scanner chosen by ctx->fast_scanner.
+ */
+static int next_token(YYSTYPE *lvalp, yyscan_t scanner, Context *ctx) {
+    if (ctx->fast_scanner) return fast_scanner_lex((FastScanner *)scanner, lvalp);
+    return yylex(lvalp, scanner);
+}
+
+static int timed_yylex(YYSTYPE *lvalp, yyscan_t scanner, Context *ctx) {
+    if (!ctx->stats.timing || !STATS_LEX_SAMPLED(&ctx->stats)) return next_token(lvalp, scanner, ctx);
 
-    clean(variables);
-    free(variables);
+    /* The clock is read inside the counters, so the time does not include their read() calls. */
+    perf_phase_start(ctx->stats.perf, PHASE_LEX);
+    double start = stats_clock();
+    int token = next_token(lvalp, scanner, ctx);
+    ctx->stats.wall[PHASE_LEX] += stats_clock() - start;
+    perf_phase_end(ctx->stats.perf, PHASE_LEX);
+    return token;
+}
+
+/**
+ * @brief With ctx->streaming, runs a top-level node and frees it; otherwise, returns it.
+ *
+ * The run is timed as the execution, and not as part of the parse it happens in.
+ *
+ * @return The node, or NULL if it was run.
+ */
+static Node *stream_node(Context *ctx, Node *n) {
+    if (!ctx->streaming) return n;
+
+    /* Held by the context while it runs, so it is freed with the context if it fails. */
+    ctx->program = n;
+    phase_end(&ctx->stats, PHASE_PARSE);
+    phase_start(&ctx->stats, PHASE_EXECUTE);
+    execute_node(ctx, n);
+    phase_end(&ctx->stats, PHASE_EXECUTE);
+    phase_start(&ctx->stats, PHASE_PARSE);
+
+    ctx->program = NULL;
+    free_node(n);
+    return NULL;
+}
+
+/**
+ * @brief Appends a statement to the top-level block (created if NULL), in amortized constant time.
+ *
+ * The block is only built here, so its array always holds the next power of 2 of its count, and is doubled when the
+ * count reaches a power of 2.
+ *
+ * @return The block (NULL if both are NULL).
+ */
+static Node *append_command(Context *ctx, Node *block, Node *cmd) {
+    if (!cmd) return block;
+
+    if (!block) {
+        Node **cmds = (Node **)malloc(sizeof(Node *));
+        if (!cmds) context_error(ctx, "malloc() failed: %s", strerror(errno));
+        cmds[0] = cmd;
+        return make_block(ctx, cmds, 1);
+    }
+
+    int count = block->block.count;
+    if ((count & (count - 1)) == 0) {
+        Node **cmds = (Node **)realloc(block->block.cmds, sizeof(Node *) * count * 2);
+        if (!cmds) context_error(ctx, "realloc() failed: %s", strerror(errno));
+        block->block.cmds = cmds;
+    }
+    block->block.cmds[block->block.count++] = cmd;
+    return block;
+}
+
+/**
+ * @brief Creates the scanner chosen by ctx->fast_scanner.
+ *
+ * @return 0 on success, 1 on an error (the message is in ctx->error).
+ */
+static int open_scanner(Context *ctx, FILE *in, yyscan_t *scanner) {
+    if (ctx->fast_scanner) {
+        *scanner = fast_scanner_create(ctx, in);
+        if (*scanner) return 0;
+    } else if (yylex_init_extra(ctx, scanner) == 0) {
+        yyset_in(in, *scanner);
+        return 0;
+    }
+
+    snprintf(ctx->error, sizeof(ctx->error), "could not create the scanner");
+    return 1;
+}
+
+static void close_scanner(Context *ctx, yyscan_t scanner) {
+    if (ctx->fast_scanner) fast_scanner_free((FastScanner *)scanner);
+    else yylex_destroy(scanner);
+}
+
+void yyerror(yyscan_t scanner, Context *ctx, const char *s) {
+    (void)scanner;
+    ctx->errors++;
+    snprintf(ctx->error, sizeof(ctx->error), "An error has occurred: %s.", s);
+}
+
+int context_parse(Context *ctx, FILE *in) {
+    yyscan_t scanner;
+    if (open_scanner(ctx, in, &scanner)) return 1;
+
+    /* Errors raised by the make_* functions come back here, so the scanner is always released. */
+    jmp_buf recover;
+    jmp_buf *previous = ctx->recover;
+    ctx->recover = &recover;
+
+    int failed = 1;
+    phase_start(&ctx->stats, PHASE_PARSE);
+    if (!setjmp(recover)) failed = yyparse(scanner, ctx) ? 1 : 0;
+    phase_end(&ctx->stats, PHASE_PARSE);
+
+    ctx->recover = previous;
+    close_scanner(ctx, scanner);
+    return failed;
+}
+
+int context_stream(Context *ctx, FILE *in) {
+    budget_start(ctx);
+    tier_free(ctx->tiers);
+    ctx->tiers = NULL;
+
+    ctx->streaming = 1;
+    int failed = context_parse(ctx, in);
+    ctx->streaming = 0;
+    budget_stop(ctx);
+    return failed;
+}
+
+#ifndef SIMPLE_COMPILER_LIBRARY
+
+/**
+ * @brief Parses the value of a limit given on the command line.
+ *
+ * @param text Value (a positive integer).
+ * @param value Receives the value.
+ *
+ * @return 1 if OK, 0 if the value is invalid.
+ */
+static int parse_limit(const char *text, unsigned long long *value) {
+    char *end;
+    errno = 0;
+    *value = strtoull(text, &end, 10);
+    return end != text && !*end && errno == 0 && *value > 0 && text[0] != '-';
+}
+
+/**
+ * @brief Prints the command line options.
+ *
+ * @param program Name of the executable.
+ */
+static void usage(const char *program) {
+    fprintf(stderr, "Usage: %s [options] [file]\n", program);
+    fprintf(stderr, "       %s --batch [--jobs=N] [options] file|directory...\n", program);
+    fprintf(stderr, "  --trace=CATEGORIES   record events (lexer,parser,ast,variables or all)\n");
+    fprintf(stderr, "  --trace-file=PATH    where the trace is saved (default: trace.bin)\n");
+    fprintf(stderr, "  --stats[=json]       print time per phase, node counts and memory usage to stderr\n");
+    fprintf(stderr, "  --perf[=sample]      add hardware counters per phase to --stats (sample: time by node type)\n");
+    fprintf(stderr, "  --pipeline-io        read stdin and write stdout on separate threads (not for interactive use)\n");
+    fprintf(stderr, "  --scanner=NAME       flex (default) or fast (hand-written, SIMD; needs the program in a file)\n");
+    fprintf(stderr, "  --tokens             print the tokens of the program instead of running it\n");
+    fprintf(stderr, "  --compact-ast        run the program from the compact AST (contiguous arrays of nodes)\n");
+    fprintf(stderr, "  --tiered[=N]         specialize loops after N iterations (default: %d; not with --compact-ast)\n",
+        TIER_DEFAULT_THRESHOLD);
+    fprintf(stderr, "  --unroll=N           copies of the body of counted loops (default: %d; 1 disables unrolling)\n",
+        OPT_UNROLL_FACTOR);
+    fprintf(stderr, "  --max-iterations=N   stop the program after N loop iterations\n");
+    fprintf(stderr, "  --max-time=SECONDS   stop the program after SECONDS of execution\n");
+    fprintf(stderr, "  --max-list-bytes=N   stop the program if its lists need more than N bytes\n");
+    fprintf(stderr, "  --max-output-bytes=N stop the program if it writes more than N bytes\n");
+    fprintf(stderr, "                       (a program stopped by a limit exits with status %d)\n", BUDGET_EXIT_STATUS);
+    fprintf(stderr, "  --record=PATH        save every value read by LEIA and LEIALISTA to an input log\n");
+    fprintf(stderr, "  --replay=PATH        read the values from an input log instead of stdin\n");
+    fprintf(stderr, "  --checkpoint=PATH    save snapshots of the run to PATH, to resume it after a crash\n");
+    fprintf(stderr, "  --checkpoint-interval=SECONDS\n");
+    fprintf(stderr, "                       seconds between two snapshots (default: %g)\n", CHECKPOINT_DEFAULT_INTERVAL);
+    fprintf(stderr, "  --restore=PATH       resume the run from the last snapshot saved to PATH\n");
+    fprintf(stderr, "  --cache=DIR          answer runs of the same program with the same input from DIR\n");
+    fprintf(stderr, "  --cache-size=BYTES   size of the results kept in the cache (default: %llu)\n", CACHE_DEFAULT_BYTES);
+    fprintf(stderr, "  --stream             run each top-level statement as soon as it is parsed, without keeping the\n");
+    fprintf(stderr, "                       program (not optimized; needs the program in a file)\n");
+    fprintf(stderr, "  --batch              compile (but do not run) many programs, or the files under directories\n");
+    fprintf(stderr, "  --jobs=N             threads used by --batch (default: one per core)\n");
+}
+
+/**
+ * @brief Prints one token per line, with its value, to compare the output of the two scanners.
+ *
+ * @param ctx Context (ctx->fast_scanner chooses the scanner).
+ * @param in Source of the program.
+ *
+ * @return 0 on success, 1 if the scanner could not be created or found an invalid character (the message is in
+ *         ctx->error).
+ */
+static int print_tokens(Context *ctx, FILE *in) {
+    yyscan_t scanner;
+    if (open_scanner(ctx, in, &scanner)) return 1;
+
+    jmp_buf recover;
+    ctx->recover = &recover;
+    if (setjmp(recover)) {
+        ctx->recover = NULL;
+        close_scanner(ctx, scanner);
+        return 1;
+    }
+
+    YYSTYPE value;
+    int token;
+    while ((token = next_token(&value, scanner, ctx)) != 0) {
+        printf("%s", scanner_token_name(token));
+        if (token == N_INT) {
+            printf(" %d", value.integer);
+        } else if (token == N_REAL) {
+            printf(" %.17g", value.real);
+        } else if (token == STRING) {
+            printf(" \"%s\"", value.string);
+            free(value.string);
+        } else if (token == VAR_NAME) {
+            printf(" %s", value.flex.name);
+            if (value.flex.variable) printf("[%s]", value.flex.variable);
+            else if (value.flex.length) printf("[%d]", value.flex.length);
+            free(value.flex.name);
+            free(value.flex.variable);
+        } else if (token == INTEIRO || token == REAL || token == LISTAINT || token == LISTAREAL) {
+            printf(" %d", value.type);
+        } else if (token >= SOMA && token <= ESCALA) {
+            printf(" %d", value.intrinsic);
+        } else if (token >= NAO && token <= E) {
+            printf(" %d", value.operand);
+        }
+        printf("\n");
+    }
+
+    ctx->recover = NULL;
+    close_scanner(ctx, scanner);
+    return 0;
 }
 
 int main(int argc, char **argv) {
-    if (argc > 1) {
-        yyin = fopen(argv[1], "r");
-        if (!yyin) {
+    const char *path = NULL;
+    const char *trace_file = "trace.bin";
+    unsigned int trace_categories = 0;
+    int pipeline_io = 0;
+    int tokens = 0;
+    int compact_ast = 0;
+    int perf = 0;
+    const char *record = NULL;
+    const char *replay = NULL;
+    const char *checkpoint = NULL;
+    double checkpoint_interval = CHECKPOINT_DEFAULT_INTERVAL;
+    const char *restore = NULL;
+    const char *cache_dir = NULL;
+    unsigned long long cache_size = CACHE_DEFAULT_BYTES;
+    int stream = 0;
+    int batch = 0;
+    unsigned long long jobs = 0;
+    int file_count = 0;
+
+    Context *ctx = context_create();
+    if (!ctx) return 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--trace=", 8) == 0) {
+            if (!trace_parse_categories(argv[i] + 8, &trace_categories)) {
+                fprintf(stderr, "Invalid trace categories: %s\n", argv[i] + 8);
+                context_free(ctx);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--trace-file=", 13) == 0) {
+            trace_file = argv[i] + 13;
+        } else if (strcmp(argv[i], "--stats") == 0) {
+            stats_enable(&ctx->stats, STATS_TEXT);
+        } else if (strcmp(argv[i], "--stats=json") == 0) {
+            stats_enable(&ctx->stats, STATS_JSON);
+        } else if (strcmp(argv[i], "--perf") == 0) {
+            perf = 1;
+        } else if (strcmp(argv[i], "--perf=sample") == 0) {
+            perf = 2;
+        } else if (strcmp(argv[i], "--pipeline-io") == 0) {
+            pipeline_io = 1;
+        } else if (strcmp(argv[i], "--scanner=flex") == 0) {
+            ctx->fast_scanner = 0;
+        } else if (strcmp(argv[i], "--scanner=fast") == 0) {
+            ctx->fast_scanner = 1;
+        } else if (strcmp(argv[i], "--tokens") == 0) {
+            tokens = 1;
+        } else if (strcmp(argv[i], "--compact-ast") == 0) {
+            compact_ast = 1;
+        } else if (strcmp(argv[i], "--tiered") == 0) {
+            ctx->tier_threshold = TIER_DEFAULT_THRESHOLD;
+        } else if (strncmp(argv[i], "--tiered=", 9) == 0) {
+            char *end;
+            long threshold = strtol(argv[i] + 9, &end, 10);
+            if (end == argv[i] + 9 || *end || threshold < 1 || threshold > INT_MAX) {
+                fprintf(stderr, "Invalid tier threshold: %s\n", argv[i] + 9);
+                context_free(ctx);
+                return 1;
+            }
+            ctx->tier_threshold = (int)threshold;
+        } else if (strncmp(argv[i], "--unroll=", 9) == 0) {
+            char *end;
+            long factor = strtol(argv[i] + 9, &end, 10);
+            if (end == argv[i] + 9 || *end || factor < 1 || factor > OPT_UNROLL_BUDGET) {
+                fprintf(stderr, "Invalid unroll factor: %s\n", argv[i] + 9);
+                context_free(ctx);
+                return 1;
+            }
+            ctx->unroll_factor = (int)factor;
+        } else if (strncmp(argv[i], "--max-iterations=", 17) == 0) {
+            if (!parse_limit(argv[i] + 17, &ctx->budget.max_iterations)) {
+                fprintf(stderr, "Invalid limit: %s\n", argv[i]);
+                context_free(ctx);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--max-time=", 11) == 0) {
+            char *end;
+            ctx->budget.max_seconds = strtod(argv[i] + 11, &end);
+            if (end == argv[i] + 11 || *end || !(ctx->budget.max_seconds > 0)) {
+                fprintf(stderr, "Invalid limit: %s\n", argv[i]);
+                context_free(ctx);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--max-list-bytes=", 17) == 0) {
+            if (!parse_limit(argv[i] + 17, &ctx->budget.max_list_bytes)) {
+                fprintf(stderr, "Invalid limit: %s\n", argv[i]);
+                context_free(ctx);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--max-output-bytes=", 19) == 0) {
+            if (!parse_limit(argv[i] + 19, &ctx->budget.max_output_bytes)) {
+                fprintf(stderr, "Invalid limit: %s\n", argv[i]);
+                context_free(ctx);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--record=", 9) == 0) {
+            record = argv[i] + 9;
+        } else if (strncmp(argv[i], "--replay=", 9) == 0) {
+            replay = argv[i] + 9;
+        } else if (strncmp(argv[i], "--checkpoint=", 13) == 0) {
+            checkpoint = argv[i] + 13;
+        } else if (strncmp(argv[i], "--checkpoint-interval=", 22) == 0) {
+            char *end;
+            checkpoint_interval = strtod(argv[i] + 22, &end);
+            if (end == argv[i] + 22 || *end || !(checkpoint_interval >= 0)) {
+                fprintf(stderr, "Invalid checkpoint interval: %s\n", argv[i] + 22);
+                context_free(ctx);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--restore=", 10) == 0) {
+            restore = argv[i] + 10;
+        } else if (strncmp(argv[i], "--cache=", 8) == 0) {
+            cache_dir = argv[i] + 8;
+        } else if (strncmp(argv[i], "--cache-size=", 13) == 0) {
+            if (!parse_limit(argv[i] + 13, &cache_size)) {
+                fprintf(stderr, "Invalid cache size: %s\n", argv[i] + 13);
+                context_free(ctx);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--stream") == 0) {
+            stream = 1;
+        } else if (strcmp(argv[i], "--batch") == 0) {
+            batch = 1;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            if (!parse_limit(argv[i] + 7, &jobs) || jobs > INT_MAX) {
+                fprintf(stderr, "Invalid number of jobs: %s\n", argv[i] + 7);
+                context_free(ctx);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            usage(argv[0]);
+            context_free(ctx);
+            return 1;
+        } else {
+            /* The files are moved to the start of argv (over options already parsed), for --batch. */
+            argv[1 + file_count++] = argv[i];
+        }
+    }
+
+    if (batch) {
+        /* Only the options of the compilation apply, since the programs are not run. */
+        if (tokens || pipeline_io || record || replay || checkpoint || restore || cache_dir || stream ||
+            trace_categories || perf || ctx->stats.timing) {
+            fprintf(stderr, "--batch cannot be used with --tokens, --pipeline-io, --record, --replay, --checkpoint, "
+                "--restore, --cache, --stream, --trace, --stats or --perf.\n");
+            context_free(ctx);
+            return 1;
+        }
+        if (!file_count) {
+            usage(argv[0]);
+            context_free(ctx);
+            return 1;
+        }
+
+        DriverOptions options = { (int)jobs, ctx->fast_scanner, ctx->unroll_factor, compact_ast };
+        context_free(ctx);
+        return driver_run(argv + 1, file_count, &options);
+    }
+    if (jobs) {
+        fprintf(stderr, "--jobs needs --batch.\n");
+        context_free(ctx);
+        return 1;
+    }
+    if (file_count > 1) {
+        usage(argv[0]);
+        context_free(ctx);
+        return 1;
+    }
+    if (file_count) path = argv[1];
+
+    /* The reader thread reads stdin directly, which would skip what the parser left in the buffer of stdin. */
+    if (pipeline_io && !path) {
+        fprintf(stderr, "--pipeline-io needs the program in a file.\n");
+        context_free(ctx);
+        return 1;
+    }
+
+    if (record && replay) {
+        fprintf(stderr, "--record and --replay cannot be used together.\n");
+        context_free(ctx);
+        return 1;
+    }
+
+    /*
+     * Snapshots are positioned in the tree, and hold the offset of stdin but not the position of the other sources
+     * of input; specialized loops have no back edges where a snapshot could be saved.
+     */
+    if ((checkpoint || restore) && (compact_ast || pipeline_io || record || replay)) {
+        fprintf(stderr, "--checkpoint and --restore cannot be used with --compact-ast, --pipeline-io, --record or "
+            "--replay.\n");
+        context_free(ctx);
+        return 1;
+    }
+    /* The key is the program and all of stdin, which is read before the run; a cached run does not run at all. */
+    if (cache_dir && (!path || pipeline_io || record || replay || checkpoint || restore)) {
+        fprintf(stderr, "--cache needs the program in a file, and cannot be used with --pipeline-io, --record, "
+            "--replay, --checkpoint or --restore.\n");
+        context_free(ctx);
+        return 1;
+    }
+    /*
+     * A streamed program is never whole, so nothing that needs the whole tree (or its hash) can be used. The program
+     * must come from a file, since it is read while the statements read stdin, and the fast scanner would read all of
+     * it before the first statement.
+     */
+    if (stream && (!path || ctx->fast_scanner || tokens || compact_ast || ctx->tier_threshold || pipeline_io ||
+        record || replay || checkpoint || restore || cache_dir)) {
+        fprintf(stderr, "--stream needs the program in a file, and cannot be used with --scanner=fast, --tokens, "
+            "--compact-ast, --tiered, --pipeline-io, --record, --replay, --checkpoint, --restore or --cache.\n");
+        context_free(ctx);
+        return 1;
+    }
+    if (checkpoint && ctx->tier_threshold) {
+        fprintf(stderr, "--checkpoint cannot be used with --tiered.\n");
+        context_free(ctx);
+        return 1;
+    }
+
+    /* The fast scanner reads its input to the end, which would leave nothing on stdin for LEIA. */
+    if (ctx->fast_scanner && !path && !tokens) {
+        fprintf(stderr, "--scanner=fast needs the program in a file.\n");
+        context_free(ctx);
+        return 1;
+    }
+
+    if (trace_categories && !trace_start(trace_categories, trace_file, 0)) {
+        fprintf(stderr, "Could not start the trace.\n");
+        context_free(ctx);
+        return 1;
+    }
+
+    /* The counters are reported with the other statistics, and count this thread only. */
+    if (perf) {
+        if (!ctx->stats.timing) stats_enable(&ctx->stats, STATS_TEXT);
+        ctx->stats.perf = perf_create(perf == 2);
+        if (!ctx->stats.perf) {
+            fprintf(stderr, "Could not open the performance counters.\n");
+            context_free(ctx);
+            return 1;
+        }
+    }
+
+    FILE *in = stdin;
+    if (path) {
+        in = fopen(path, "r");
+        if (!in) {
             perror("fopen() failed");
+            context_free(ctx);
             return 1;
         }
     }
 
-    variables = initialize();
-    if (!variables) return 1;
+    if (tokens) {
+        int failed = print_tokens(ctx, in);
+        if (in != stdin) fclose(in);
+        if (failed) {
+            fflush(stdout);
+            fprintf(stderr, "%s\n", ctx->error);
+        }
+        context_free(ctx);
+        return failed;
+    }
+
+    ResultCache *cache = NULL;
+    if (cache_dir && !(cache = cache_open(cache_dir, cache_size))) {
+        perror("Could not open the cache");
+        if (in != stdin) fclose(in);
+        context_free(ctx);
+        return 1;
+    }
 
-    yyparse();
+    /* A streamed program has already run when the parse ends. */
+    int failed = stream ? context_stream(ctx, in) : context_parse(ctx, in);
+    if (in != stdin) fclose(in);
 
-    clean(variables);
-    free(variables);
-    return 0;
-}
\ No newline at end of file
+    /*
+     * A program that uses files depends on more than its input, so it is not cached. On a miss, the run reads the
+     * input from memory and writes its output to memory, to be stored.
+     */
+    unsigned char *input = NULL;
+    size_t input_size = 0;
+    char *output = NULL;
+    size_t output_size = 0;
+    FILE *capture = NULL;
+    CacheKey key;
+    int cached = 0;
+    if (!failed && cache && cache_deterministic(ctx->program)) {
+        input = cache_read_input(stdin, &input_size);
+        if (!input) {
+            perror("Could not read the input");
+            cache_close(cache);
+            context_free(ctx);
+            return 1;
+        }
+
+        key = cache_key(ctx, input, input_size);
+        CacheResult result;
+        if (cache_lookup(cache, &key, &result, &ctx->stats)) {
+            fwrite(result.output, 1, result.output_size, stdout);
+            failed = result.status;
+            snprintf(ctx->error, sizeof(ctx->error), "%s", result.error);
+            cache_result_free(&result);
+            cached = 1;
+        } else {
+            if (input_size) ctx->in = fmemopen(input, input_size, "r");
+            ctx->out = capture = open_memstream(&output, &output_size);
+            if (!ctx->in || !capture) {
+                perror("Could not capture the run");
+                cache_close(cache);
+                context_free(ctx);
+                return 1;
+            }
+        }
+    }
+
+    if (!failed && !cached && !stream) {
+        phase_start(&ctx->stats, PHASE_OPTIMIZE);
+        ctx->program = optimize(ctx, ctx->program);
+        phase_end(&ctx->stats, PHASE_OPTIMIZE);
+
+        /* The log is tied to the optimized program, so a replay is refused if the program changed. */
+        if (record || replay) {
+            uint64_t hash = hash_node(ctx->program);
+            if (record && !(ctx->input_log = input_log_record(record, hash))) {
+                perror("fopen() failed");
+                context_free(ctx);
+                return 1;
+            }
+            if (replay && !(ctx->input_log = input_log_replay(replay, hash, ctx->error, sizeof(ctx->error)))) {
+                fprintf(stderr, "%s\n", ctx->error);
+                context_free(ctx);
+                return 1;
+            }
+        }
+
+        /* The tree is only needed to build the compact AST, so it is freed before the execution. */
+        CompactAst *compact = NULL;
+        if (compact_ast) {
+            compact = compact_from_tree(ctx, ctx->program);
+            ctx->stats.compact_bytes = compact_bytes(compact);
+            #ifdef DEBUG
+                if (!compact_matches(ctx, compact, ctx->program)) {
+                    context_error(ctx, "compact_from_tree(): the compact AST does not convert back to the same tree.");
+                }
+            #endif
+            free_node(ctx->program);
+            ctx->program = NULL;
+        }
+
+        PipelinedIo *pipeline = NULL;
+        if (pipeline_io) {
+            fflush(stdout);
+            pipeline = pipeio_start(STDIN_FILENO, STDOUT_FILENO);
+            if (!pipeline) {
+                fprintf(stderr, "Could not start the I/O threads.\n");
+                compact_free(compact);
+                input_log_close(ctx->input_log);
+                context_free(ctx);
+                return 1;
+            }
+            ctx->in = pipeio_in(pipeline);
+            ctx->out = pipeio_out(pipeline);
+        }
+
+        /* The snapshot is loaded before the checkpoint starts, since both can use the same file. */
+        uint64_t hash = (checkpoint || restore) ? hash_node(ctx->program) : 0;
+        uint32_t *position = NULL;
+        int depth = 0;
+        if (restore && checkpoint_restore(ctx, restore, hash, &position, &depth)) {
+            fprintf(stderr, "%s\n", ctx->error);
+            context_free(ctx);
+            return 1;
+        }
+        /* A snapshot has the offset of the input, and a run resumed from it must be able to move there. */
+        if (checkpoint && ftell(ctx->in) < 0) {
+            fprintf(stderr, "--checkpoint needs the input in a file, not a pipe or a terminal.\n");
+            free(position);
+            context_free(ctx);
+            return 1;
+        }
+        if (checkpoint && !(ctx->checkpoint = checkpoint_create(checkpoint, checkpoint_interval, ctx->program, hash))) {
+            perror("fopen() failed");
+            free(position);
+            context_free(ctx);
+            return 1;
+        }
+
+        phase_start(&ctx->stats, PHASE_EXECUTE);
+        if (compact) failed = context_execute_compact(ctx, compact);
+        else if (restore) failed = context_resume(ctx, ctx->program, position, depth);
+        else failed = context_execute(ctx, ctx->program);
+        phase_end(&ctx->stats, PHASE_EXECUTE);
+        compact_free(compact);
+        free(position);
+
+        /* A snapshot is kept if the run failed, and removed if it ended. */
+        if (!checkpoint_close(ctx->checkpoint, !failed) && !failed) {
+            snprintf(ctx->error, sizeof(ctx->error), "write() failed: could not save a snapshot to '%s'.", checkpoint);
+            failed = 1;
+        }
+        ctx->checkpoint = NULL;
+
+        /* A run stopped by a limit may have been stopped by the clock, so it is not stored. */
+        if (capture) {
+            int closed = fclose(capture) == 0;
+            ctx->out = stdout;
+            if (ctx->in != stdin) fclose(ctx->in);
+            ctx->in = stdin;
+
+            fwrite(output, 1, output_size, stdout);
+            if (closed && !ctx->budget.exceeded) {
+                CacheResult result = { failed, failed ? ctx->error : "", (unsigned char *)output, output_size };
+                cache_store(cache, &key, &result);
+            }
+            free(output);
+        }
+
+        if (!input_log_close(ctx->input_log) && !failed) {
+            snprintf(ctx->error, sizeof(ctx->error), "write() failed: the input log '%s' is incomplete.", record);
+            failed = 1;
+        }
+        ctx->input_log = NULL;
+
+        /* The output is written before any error message, as with the flush of stdout below. */
+        if (pipeline) {
+            ctx->in = stdin;
+            ctx->out = stdout;
+            if (!pipeio_finish(pipeline) && !failed) {
+                snprintf(ctx->error, sizeof(ctx->error), "write() failed: the output is incomplete.");
+                failed = 1;
+            }
+        }
+    }
+
+    if (failed) {
+        fflush(stdout);
+        fprintf(stderr, "%s\n", ctx->error);
+    }
+
+    /* A breached limit has its own status, so a supervisor can tell it from an error of the program. */
+    if (failed && ctx->budget.exceeded) failed = BUDGET_EXIT_STATUS;
+
+    free(input);
+    cache_close(cache);
+    context_report(ctx, stderr);
+    context_free(ctx);
+    return failed;
+}
+
+#endif // SIMPLE_COMPILER_LIBRARY
@@ -0,0 +1,125 @@
+#define _GNU_SOURCE
+#include <limits.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "budget.h"
+#include "context.h"
+
+/* Budget watched by the timer of this thread (the signal is delivered to the thread that started the run). */
+static __thread Budget *watched = NULL;
+
+/**
+ * @brief Sets the next iteration at which the limits are checked.
+ */
+static void schedule(Budget *b) {
+    if (!b->max_iterations && !(b->max_seconds > 0)) {
+        b->next_check = ULLONG_MAX;
+        return;
+    }
+
+    /* With the watchdog, the clock is not read by the loops. */
+    b->next_check = (b->max_seconds > 0 && !b->watchdog) ? b->iterations + BUDGET_CHECK_INTERVAL : ULLONG_MAX;
+    if (b->max_iterations && b->next_check > b->max_iterations + 1) b->next_check = b->max_iterations + 1;
+}
+
+/**
+ * @brief Marks the watched budget as expired, and makes the next BUDGET_TICK() check it.
+ */
+static void on_deadline(int signal, siginfo_t *info, void *context) {
+    (void)signal;
+    (void)context;
+
+    Budget *b = watched;
+    if (!b || info->si_value.sival_ptr != b) return;
+    b->expired = 1;
+    b->next_check = 0;
+}
+
+/**
+ * @brief Starts the timer that sets b->expired after max_seconds.
+ *
+ * @return 1 if OK, 0 if the loops must read the clock instead.
+ */
+static int start_watchdog(Budget *b) {
+    /* Without SA_RESTART, so a read blocked on a pipe or a terminal fails with EINTR. */
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = on_deadline;
+    action.sa_flags = SA_SIGINFO;
+    sigemptyset(&action.sa_mask);
+    if (sigaction(BUDGET_SIGNAL, &action, NULL) != 0) return 0;
+
+    struct sigevent event;
+    memset(&event, 0, sizeof(event));
+    event.sigev_notify = SIGEV_THREAD_ID;
+    event.sigev_signo = BUDGET_SIGNAL;
+    event.sigev_value.sival_ptr = b;
+    event._sigev_un._tid = (pid_t)syscall(SYS_gettid);
+    if (timer_create(CLOCK_MONOTONIC, &event, &b->timer) != 0) return 0;
+
+    struct itimerspec when;
+    memset(&when, 0, sizeof(when));
+    when.it_value.tv_sec = (time_t)b->max_seconds;
+    when.it_value.tv_nsec = (long)((b->max_seconds - (double)when.it_value.tv_sec) * 1e9);
+    if (when.it_value.tv_sec == 0 && when.it_value.tv_nsec == 0) when.it_value.tv_nsec = 1;
+
+    watched = b;
+    if (timer_settime(b->timer, 0, &when, NULL) != 0) {
+        watched = NULL;
+        timer_delete(b->timer);
+        return 0;
+    }
+    return 1;
+}
+
+void budget_start(Context *ctx) {
+    Budget *b = &ctx->budget;
+    budget_stop(ctx);
+    b->iterations = 0;
+    b->output_bytes = 0;
+    b->exceeded = 0;
+    b->expired = 0;
+    b->deadline = b->max_seconds > 0 ? stats_clock() + b->max_seconds : 0.0;
+    b->watchdog = b->max_seconds > 0 && start_watchdog(b);
+    schedule(b);
+}
+
+void budget_stop(Context *ctx) {
+    Budget *b = &ctx->budget;
+    if (!b->watchdog) return;
+
+    timer_delete(b->timer);
+    b->watchdog = 0;
+    if (watched == b) watched = NULL;
+}
+
+void budget_check(Context *ctx) {
+    Budget *b = &ctx->budget;
+    if (b->max_iterations && b->iterations > b->max_iterations) {
+        b->exceeded = 1;
+        context_error(ctx, "limit exceeded: more than %llu loop iterations.", b->max_iterations);
+    }
+    if (b->max_seconds > 0 && (b->expired || (!b->watchdog && stats_clock() > b->deadline))) {
+        b->exceeded = 1;
+        context_error(ctx, "limit exceeded: more than %g seconds of execution.", b->max_seconds);
+    }
+    schedule(b);
+}
+
+void budget_memory(Context *ctx, size_t bytes) {
+    Budget *b = &ctx->budget;
+    if (b->max_list_bytes && ctx->stats.list_bytes + bytes > b->max_list_bytes) {
+        b->exceeded = 1;
+        context_error(ctx, "limit exceeded: more than %llu bytes of lists.", b->max_list_bytes);
+    }
+}
+
+void budget_output(Context *ctx, size_t bytes) {
+    Budget *b = &ctx->budget;
+    if (b->max_output_bytes && b->output_bytes + bytes > b->max_output_bytes) {
+        b->exceeded = 1;
+        context_error(ctx, "limit exceeded: more than %llu bytes of output.", b->max_output_bytes);
+    }
+    b->output_bytes += bytes;
+}
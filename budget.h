@@ -0,0 +1,115 @@
+#ifndef BUDGET_H
+#define BUDGET_H
+
+#include <signal.h>
+#include <stddef.h>
+#include <time.h>
+
+/* Compilation context (see context.h). */
+typedef struct Context Context;
+
+/* Exit status of the compiler when a run exceeds one of its limits. */
+#define BUDGET_EXIT_STATUS 3
+
+/* Signal of the watchdog (see budget_start()). */
+#define BUDGET_SIGNAL (SIGRTMIN + 1)
+
+/* Loop iterations between two readings of the clock (only if the watchdog could not be started). */
+#define BUDGET_CHECK_INTERVAL 1024
+
+/* Elements filled, scaled or read by a list statement between two checks of the watchdog. */
+#define BUDGET_LIST_CHUNK 65536
+
+/**
+ * @struct Budget
+ *
+ * @brief Limits of a run, and what it has used of them (a limit of 0 means unlimited).
+ */
+typedef struct Budget {
+    unsigned long long max_iterations;      // Iterations of loops, as written in the source (with any unrolling).
+    double max_seconds;                     // Wall-clock time of the execution.
+    unsigned long long max_list_bytes;      // Memory of the lists.
+    unsigned long long max_output_bytes;    // Bytes written by ESCREVA and ESCREVALISTA (not to files).
+
+    /* State of the run (reset by budget_start()). */
+    unsigned long long iterations;
+    unsigned long long next_check;          // Value of iterations at which budget_check() is called.
+    double deadline;
+    unsigned long long output_bytes;
+    int exceeded;                           // The run failed because a limit was exceeded.
+
+    /* Watchdog of max_seconds (see budget_start()). */
+    volatile sig_atomic_t expired;          // Set by the timer when the time is over.
+    int watchdog;                           // The timer exists.
+    timer_t timer;
+} Budget;
+
+/**
+ * @brief Counts loop iterations, checking the limits every BUDGET_CHECK_INTERVAL iterations.
+ *
+ * Used on the back edge of every loop, so a loop that never ends is stopped. An unrolled loop counts the copies of
+ * the body it runs, and a fully unrolled one its trip count once its copies ran, so the limit is in iterations of the
+ * source in every mode. Without limits, it costs an addition and a comparison.
+ *
+ * @param ctx Context.
+ * @param count Iterations of the source loop.
+ */
+#define BUDGET_TICK(ctx, count) do { \
+    if (((ctx)->budget.iterations += (count)) >= (ctx)->budget.next_check) budget_check(ctx); \
+} while (0)
+
+/**
+ * @brief Stops the run if the watchdog found the time over.
+ *
+ * Used before every statement (and between the chunks of a list statement), so the time limit also stops a program
+ * without loops, or one long statement. Costs a load and a comparison.
+ *
+ * @param ctx Context.
+ */
+#define BUDGET_POLL(ctx) do { \
+    if ((ctx)->budget.expired) budget_check(ctx); \
+} while (0)
+
+/**
+ * @brief Resets the state of the budget at the start of a run.
+ *
+ * With max_seconds, a timer of the calling thread (the watchdog) sends it BUDGET_SIGNAL when the time is over: the
+ * handler sets expired, so the next BUDGET_TICK() or BUDGET_POLL() stops the run, and interrupts a blocking read or
+ * write (the signal does not restart them). If the timer cannot be created, the clock is read every
+ * BUDGET_CHECK_INTERVAL iterations instead.
+ *
+ * @param ctx Context.
+ */
+void budget_start(Context *ctx);
+
+/**
+ * @brief Stops the watchdog at the end of a run (does nothing if it was not started).
+ *
+ * @param ctx Context.
+ */
+void budget_stop(Context *ctx);
+
+/**
+ * @brief Checks the iterations and the time (called by BUDGET_TICK() and BUDGET_POLL()).
+ *
+ * @param ctx Context (a breach is reported with context_error(), and sets ctx->budget.exceeded).
+ */
+void budget_check(Context *ctx);
+
+/**
+ * @brief Checks if lists can allocate more memory, before they do.
+ *
+ * @param ctx Context (the memory already used is ctx->stats.list_bytes).
+ * @param bytes Bytes about to be allocated.
+ */
+void budget_memory(Context *ctx, size_t bytes);
+
+/**
+ * @brief Checks if the run can write more output, before it does, and counts it.
+ *
+ * @param ctx Context.
+ * @param bytes Bytes about to be written.
+ */
+void budget_output(Context *ctx, size_t bytes);
+
+#endif // BUDGET_H
@@ -0,0 +1,432 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/stat.h>
+#include "cache.h"
+#include "compact.h"
+
+/* The magic, the key, the status, the size of the error and the size of the output. */
+#define KEY_SIZE (2 * SHA256_SIZE + 40)
+#define HEADER_SIZE (8 + KEY_SIZE + 16)
+#define SUFFIX ".result"
+
+/* Hexadecimal digest, the suffix and the terminator. */
+#define NAME_SIZE (2 * SHA256_SIZE + sizeof(SUFFIX))
+
+struct ResultCache {
+    char *dir;
+    unsigned long long max_bytes;
+};
+
+/**
+ * @struct CacheFile
+ *
+ * @brief Result found in the directory, as a candidate for eviction.
+ */
+typedef struct CacheFile {
+    char *name;
+    off_t size;
+    struct timespec used;
+} CacheFile;
+
+/* Values are always little-endian in the files (and in the digests). */
+
+static void put_u32(unsigned char *p, uint32_t x) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(x >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t x) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(x >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    uint32_t x = 0;
+    for (int i = 0; i < 4; i++) x |= (uint32_t)p[i] << (8 * i);
+    return x;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    uint64_t x = 0;
+    for (int i = 0; i < 8; i++) x |= (uint64_t)p[i] << (8 * i);
+    return x;
+}
+
+/**
+ * @brief Returns the path of a file of the directory (to be freed), or NULL if there is no memory.
+ */
+static char *cache_path(const ResultCache *c, const char *name) {
+    size_t size = strlen(c->dir) + strlen(name) + 2;
+    char *path = (char *)malloc(size);
+    if (path) snprintf(path, size, "%s/%s", c->dir, name);
+    return path;
+}
+
+/**
+ * @brief Encodes a key as it is stored in the files.
+ */
+static void encode_key(const CacheKey *key, unsigned char *p) {
+    memcpy(p, key->program, SHA256_SIZE);
+    memcpy(p + SHA256_SIZE, key->input, SHA256_SIZE);
+    put_u64(p + 2 * SHA256_SIZE, key->input_size);
+    put_u64(p + 2 * SHA256_SIZE + 8, key->max_iterations);
+    put_u64(p + 2 * SHA256_SIZE + 16, key->max_list_bytes);
+    put_u64(p + 2 * SHA256_SIZE + 24, key->max_output_bytes);
+    put_u64(p + 2 * SHA256_SIZE + 32, key->unroll_factor);
+}
+
+/**
+ * @brief Returns the name of the file of a key (the digest of the encoded key, in hexadecimal).
+ */
+static void result_name(const CacheKey *key, char name[NAME_SIZE]) {
+    unsigned char encoded[KEY_SIZE], digest[SHA256_SIZE];
+    encode_key(key, encoded);
+
+    Sha256 s;
+    sha256_init(&s);
+    sha256_update(&s, encoded, KEY_SIZE);
+    sha256_final(&s, digest);
+    for (int i = 0; i < SHA256_SIZE; i++) snprintf(name + 2 * i, 3, "%02x", digest[i]);
+    memcpy(name + 2 * SHA256_SIZE, SUFFIX, sizeof(SUFFIX));
+}
+
+ResultCache *cache_open(const char *dir, unsigned long long max_bytes) {
+    if (mkdir(dir, 0777) != 0 && errno != EEXIST) return NULL;
+
+    ResultCache *c = (ResultCache *)calloc(1, sizeof(ResultCache));
+    if (!c) return NULL;
+    c->dir = strdup(dir);
+    c->max_bytes = max_bytes;
+    if (!c->dir) {
+        free(c);
+        return NULL;
+    }
+
+    /* The counters are created now, so a directory that cannot be written is reported before the run. */
+    char *path = cache_path(c, "counters");
+    int fd = path ? open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666) : -1;
+    int error = errno;
+    free(path);
+    if (fd < 0) {
+        cache_close(c);
+        errno = error;
+        return NULL;
+    }
+    close(fd);
+    return c;
+}
+
+void cache_close(ResultCache *c) {
+    if (!c) return;
+
+    free(c->dir);
+    free(c);
+}
+
+int cache_deterministic(const Node *n) {
+    if (!n) return 1;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+            for (int i = 0; i < n->block.count; i++) {
+                if (!cache_deterministic(n->block.cmds[i])) return 0;
+            }
+            return 1;
+        case NODE_IF:
+            return cache_deterministic(n->ifnode.then_block) && cache_deterministic(n->ifnode.else_block);
+        case NODE_WHILE:
+            return cache_deterministic(n->whilenode.body);
+        case NODE_LISTIO:
+            return n->listio.path == NULL;
+        default:
+            return 1;
+    }
+}
+
+unsigned char *cache_read_input(FILE *in, size_t *size) {
+    size_t capacity = 65536;
+    unsigned char *data = (unsigned char *)malloc(capacity);
+    if (!data) return NULL;
+
+    *size = 0;
+    size_t n;
+    while ((n = fread(data + *size, 1, capacity - *size, in)) > 0) {
+        *size += n;
+        if (*size < capacity) continue;
+
+        unsigned char *bigger = (unsigned char *)realloc(data, capacity * 2);
+        if (!bigger) {
+            free(data);
+            return NULL;
+        }
+        data = bigger;
+        capacity *= 2;
+    }
+
+    if (ferror(in)) {
+        free(data);
+        errno = EIO;
+        return NULL;
+    }
+    return data;
+}
+
+static void digest_u32(Sha256 *s, uint32_t x) {
+    unsigned char p[4];
+    put_u32(p, x);
+    sha256_update(s, p, 4);
+}
+
+/**
+ * @brief Digests a program through its compact AST, whose arrays describe the whole tree in a fixed order.
+ */
+static void digest_program(Context *ctx, unsigned char digest[SHA256_SIZE]) {
+    CompactAst *ast = compact_from_tree(ctx, ctx->program);
+
+    Sha256 s;
+    sha256_init(&s);
+    digest_u32(&s, ast->count);
+    for (uint32_t i = 0; i < ast->count; i++) {
+        unsigned char p[2] = { ast->kind[i], ast->op[i] };
+        sha256_update(&s, p, 2);
+        digest_u32(&s, ast->a[i]);
+        digest_u32(&s, ast->b[i]);
+        digest_u32(&s, ast->c[i]);
+    }
+
+    digest_u32(&s, ast->real_count);
+    for (uint32_t i = 0; i < ast->real_count; i++) {
+        uint64_t bits;
+        unsigned char p[8];
+        memcpy(&bits, &ast->reals[i], sizeof(bits));
+        put_u64(p, bits);
+        sha256_update(&s, p, 8);
+    }
+
+    digest_u32(&s, ast->string_count);
+    for (uint32_t i = 0; i < ast->string_count; i++) {
+        size_t length = strlen(ast->strings[i]);
+        digest_u32(&s, (uint32_t)length);
+        sha256_update(&s, ast->strings[i], length);
+    }
+
+    digest_u32(&s, ast->list_count);
+    for (uint32_t i = 0; i < ast->list_count; i++) digest_u32(&s, ast->lists[i]);
+
+    sha256_final(&s, digest);
+    compact_free(ast);
+}
+
+CacheKey cache_key(Context *ctx, const unsigned char *input, size_t size) {
+    CacheKey key;
+    digest_program(ctx, key.program);
+
+    Sha256 s;
+    sha256_init(&s);
+    sha256_update(&s, input, size);
+    sha256_final(&s, key.input);
+
+    key.input_size = size;
+    key.max_iterations = ctx->budget.max_iterations;
+    key.max_list_bytes = ctx->budget.max_list_bytes;
+    key.max_output_bytes = ctx->budget.max_output_bytes;
+
+    /* Every factor below 2 means no unrolling. */
+    int factor = ctx->unroll_factor < 2 ? 1 : ctx->unroll_factor;
+    key.unroll_factor = ctx->budget.max_iterations ? (uint64_t)factor : 0;
+    return key;
+}
+
+/**
+ * @brief Counts a lookup in the directory, and copies the counters to the stats.
+ *
+ * The counters are a line of text ("lookups hits bytes"), updated under a lock, since runs can share the directory.
+ */
+static void count_lookup(ResultCache *c, int hit, size_t bytes, Stats *stats) {
+    unsigned long long lookups = 0, hits = 0, saved = 0;
+
+    char *path = cache_path(c, "counters");
+    int fd = path ? open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0666) : -1;
+    free(path);
+    if (fd >= 0 && flock(fd, LOCK_EX) == 0) {
+        char text[96];
+        ssize_t n = pread(fd, text, sizeof(text) - 1, 0);
+        if (n > 0) {
+            text[n] = '\0';
+            if (sscanf(text, "%llu %llu %llu", &lookups, &hits, &saved) != 3) lookups = hits = saved = 0;
+        }
+
+        lookups++;
+        if (hit) {
+            hits++;
+            saved += bytes;
+        }
+
+        /* The counters are only statistics, so failing to update them does not fail the run. */
+        int length = snprintf(text, sizeof(text), "%llu %llu %llu\n", lookups, hits, saved);
+        if (ftruncate(fd, 0) == 0) {
+            ssize_t written = pwrite(fd, text, length, 0);
+            (void)written;
+        }
+        flock(fd, LOCK_UN);
+    } else {
+        lookups = 1;
+        hits = hit;
+        saved = hit ? bytes : 0;
+    }
+    if (fd >= 0) close(fd);
+
+    stats->cache_used = 1;
+    stats->cache_hit = hit;
+    stats->cache_lookups = lookups;
+    stats->cache_hits = hits;
+    stats->cache_bytes_saved = saved;
+}
+
+int cache_lookup(ResultCache *c, const CacheKey *key, CacheResult *result, Stats *stats) {
+    memset(result, 0, sizeof(*result));
+
+    char name[NAME_SIZE];
+    result_name(key, name);
+    char *path = cache_path(c, name);
+    FILE *f = path ? fopen(path, "rb") : NULL;
+
+    unsigned char header[HEADER_SIZE], encoded[KEY_SIZE];
+    encode_key(key, encoded);
+    int hit = 0;
+    if (f && fread(header, 1, HEADER_SIZE, f) == HEADER_SIZE && memcmp(header, CACHE_MAGIC, 8) == 0
+        && memcmp(header + 8, encoded, KEY_SIZE) == 0) {
+        uint32_t error_size = get_u32(header + 8 + KEY_SIZE + 4);
+        uint64_t output_size = get_u64(header + 8 + KEY_SIZE + 8);
+
+        result->status = (int)get_u32(header + 8 + KEY_SIZE);
+        result->error = (char *)malloc((size_t)error_size + 1);
+        result->output = (unsigned char *)malloc(output_size ? (size_t)output_size : 1);
+        result->output_size = (size_t)output_size;
+        if (result->error && result->output && fread(result->error, 1, error_size, f) == error_size
+            && fread(result->output, 1, result->output_size, f) == result->output_size) {
+            result->error[error_size] = '\0';
+            hit = 1;
+        } else {
+            cache_result_free(result);
+        }
+    }
+    if (f) fclose(f);
+
+    /* The modification time orders the results for the eviction, so a hit makes the result the most recent. */
+    if (hit) utimensat(AT_FDCWD, path, NULL, 0);
+    free(path);
+
+    count_lookup(c, hit, hit ? result->output_size : 0, stats);
+    return hit;
+}
+
+static int compare_used(const void *a, const void *b) {
+    const CacheFile *x = (const CacheFile *)a, *y = (const CacheFile *)b;
+    if (x->used.tv_sec != y->used.tv_sec) return x->used.tv_sec < y->used.tv_sec ? -1 : 1;
+    if (x->used.tv_nsec != y->used.tv_nsec) return x->used.tv_nsec < y->used.tv_nsec ? -1 : 1;
+    return 0;
+}
+
+/**
+ * @brief Removes the least recently used results until the directory fits in its size.
+ *
+ * @param keep Name of the result just stored, which is kept even if it is bigger than the cache.
+ */
+static void evict(ResultCache *c, const char *keep) {
+    DIR *dir = opendir(c->dir);
+    if (!dir) return;
+
+    CacheFile *files = NULL;
+    size_t count = 0, capacity = 0;
+    unsigned long long total = 0;
+
+    struct dirent *entry;
+    while ((entry = readdir(dir)) != NULL) {
+        size_t length = strlen(entry->d_name);
+        if (length <= strlen(SUFFIX) || strcmp(entry->d_name + length - strlen(SUFFIX), SUFFIX) != 0) continue;
+
+        char *path = cache_path(c, entry->d_name);
+        struct stat st;
+        if (!path || stat(path, &st) != 0) {
+            free(path);
+            continue;
+        }
+        free(path);
+
+        if (count == capacity) {
+            capacity = capacity ? capacity * 2 : 64;
+            CacheFile *bigger = (CacheFile *)realloc(files, sizeof(CacheFile) * capacity);
+            if (!bigger) break;
+            files = bigger;
+        }
+        files[count].name = strdup(entry->d_name);
+        if (!files[count].name) break;
+        files[count].size = st.st_size;
+        files[count].used = st.st_mtim;
+        total += (unsigned long long)st.st_size;
+        count++;
+    }
+    closedir(dir);
+
+    qsort(files, count, sizeof(CacheFile), compare_used);
+    for (size_t i = 0; i < count && total > c->max_bytes; i++) {
+        if (strcmp(files[i].name, keep) == 0) continue;
+
+        char *path = cache_path(c, files[i].name);
+        if (path && unlink(path) == 0) total -= (unsigned long long)files[i].size;
+        free(path);
+    }
+
+    for (size_t i = 0; i < count; i++) free(files[i].name);
+    free(files);
+}
+
+int cache_store(ResultCache *c, const CacheKey *key, const CacheResult *result) {
+    char name[NAME_SIZE];
+    result_name(key, name);
+
+    /* Written to a file of its own and renamed, so a reader never sees a partial result. */
+    char temp[NAME_SIZE + 32];
+    snprintf(temp, sizeof(temp), "%s.%ld.tmp", name, (long)getpid());
+    char *temp_path = cache_path(c, temp);
+    char *path = cache_path(c, name);
+    FILE *f = temp_path ? fopen(temp_path, "wb") : NULL;
+    if (!f || !path) {
+        if (f) fclose(f);
+        free(temp_path);
+        free(path);
+        return 0;
+    }
+
+    size_t error_size = result->error ? strlen(result->error) : 0;
+    unsigned char header[HEADER_SIZE];
+    memcpy(header, CACHE_MAGIC, 8);
+    encode_key(key, header + 8);
+    put_u32(header + 8 + KEY_SIZE, (uint32_t)result->status);
+    put_u32(header + 8 + KEY_SIZE + 4, (uint32_t)error_size);
+    put_u64(header + 8 + KEY_SIZE + 8, result->output_size);
+
+    int ok = fwrite(header, 1, HEADER_SIZE, f) == HEADER_SIZE
+        && fwrite(result->error ? result->error : "", 1, error_size, f) == error_size
+        && (!result->output_size || fwrite(result->output, 1, result->output_size, f) == result->output_size);
+    if (fclose(f) != 0) ok = 0;
+    if (ok) ok = rename(temp_path, path) == 0;
+    if (!ok) unlink(temp_path);
+
+    free(temp_path);
+    free(path);
+    if (ok) evict(c, name);
+    return ok;
+}
+
+void cache_result_free(CacheResult *result) {
+    free(result->error);
+    free(result->output);
+    result->error = NULL;
+    result->output = NULL;
+}
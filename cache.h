@@ -0,0 +1,137 @@
+#ifndef CACHE_H
+#define CACHE_H
+
+#include <stdio.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "context.h"
+#include "sha256.h"
+
+#define CACHE_MAGIC "SCCACHE2"
+
+/* Size of the cache directory, by default. */
+#define CACHE_DEFAULT_BYTES (64ULL * 1024 * 1024)
+
+/**
+ * @struct ResultCache
+ *
+ * @brief Results of runs, in a directory, keyed by the program and its input.
+ *
+ * Each result is a file with the output, the exit status and the message of the error (a runtime error is as
+ * deterministic as the output). The files are replaced atomically, so several processes can share a directory. When
+ * the directory grows beyond its size, the results used least recently (by modification time, which a hit updates)
+ * are removed. The directory also counts the lookups, the hits and the bytes of output answered from it.
+ */
+typedef struct ResultCache ResultCache;
+
+/**
+ * @struct CacheKey
+ *
+ * @brief What a run depends on.
+ *
+ * The program is digested as parsed (through its compact AST, see compact.h), so the layout and the comments of the
+ * source do not matter. The program and the input are SHA-256 digests, since a directory shared by many runs must
+ * never answer one with the result of another: a hit compares the whole key stored in the file, not only the name
+ * of the file. The limits that stop a run deterministically are part of the key; the time limit is not.
+ *
+ * The other options do not change the result, with one exception: an unrolled loop counts its iterations once per
+ * group of copies, so under an iteration limit an error in the middle of a group can come before the limit is
+ * noticed. The unroll factor is part of the key when there is an iteration limit (and is 0 otherwise).
+ */
+typedef struct CacheKey {
+    unsigned char program[SHA256_SIZE];
+    unsigned char input[SHA256_SIZE];
+    uint64_t input_size;
+    uint64_t max_iterations;
+    uint64_t max_list_bytes;
+    uint64_t max_output_bytes;
+    uint64_t unroll_factor;
+} CacheKey;
+
+/**
+ * @struct CacheResult
+ *
+ * @brief Result of a run.
+ */
+typedef struct CacheResult {
+    int status;                 // Exit status.
+    char *error;                // Message of the error ("" if none).
+    unsigned char *output;
+    size_t output_size;
+} CacheResult;
+
+/**
+ * @brief Opens a cache, creating its directory if needed.
+ *
+ * @param dir Directory.
+ * @param max_bytes Size of the results kept.
+ *
+ * @return The cache, or NULL on an error (errno is set).
+ */
+ResultCache *cache_open(const char *dir, unsigned long long max_bytes);
+
+/**
+ * @brief Returns 1 if the result of a program depends only on its input (it does not read or write files).
+ */
+int cache_deterministic(const Node *program);
+
+/**
+ * @brief Reads a whole input to memory.
+ *
+ * @param in Input.
+ * @param size Receives the size.
+ *
+ * @return The bytes (to be freed), or NULL on an error (errno is set).
+ */
+unsigned char *cache_read_input(FILE *in, size_t *size);
+
+/**
+ * @brief Computes the key of a run.
+ *
+ * @param ctx Context, with the program before the optimizer, the limits of the run and the unroll factor (a lack of
+ *            memory is reported with context_error()).
+ * @param input Bytes of the input.
+ * @param size Size of the input.
+ *
+ * @return The key.
+ */
+CacheKey cache_key(Context *ctx, const unsigned char *input, size_t size);
+
+/**
+ * @brief Looks up the result of a run, counting the lookup in the directory and in the stats.
+ *
+ * @param c Cache.
+ * @param key Key of the run.
+ * @param result Receives the result on a hit (free it with cache_result_free()).
+ * @param stats Receives the counters of the directory.
+ *
+ * @return 1 on a hit, 0 on a miss.
+ */
+int cache_lookup(ResultCache *c, const CacheKey *key, CacheResult *result, Stats *stats);
+
+/**
+ * @brief Stores the result of a run, removing the least recently used results if the directory is too big.
+ *
+ * @param c Cache.
+ * @param key Key of the run.
+ * @param result Result.
+ *
+ * @return 1 if OK, 0 if it could not be stored.
+ */
+int cache_store(ResultCache *c, const CacheKey *key, const CacheResult *result);
+
+/**
+ * @brief Frees the memory of a result.
+ *
+ * @param result Result (the struct itself is not freed).
+ */
+void cache_result_free(CacheResult *result);
+
+/**
+ * @brief Closes a cache.
+ *
+ * @param c Cache (can be NULL).
+ */
+void cache_close(ResultCache *c);
+
+#endif // CACHE_H
@@ -0,0 +1,845 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "checkpoint.h"
+#include "context.h"
+
+#define HEADER_SIZE 16
+
+/* Tag, size of the payload, payload, checksum. */
+#define RECORD_OVERHEAD (1 + 4 + 8)
+
+/* State of a variable in a snapshot. */
+#define VALUE_NONE 0            // No value was allocated.
+#define VALUE_SAVED 1           // The value follows.
+#define VALUE_UNCHANGED 2       // Same value as in the previous snapshot.
+
+/**
+ * @struct SavedVariable
+ *
+ * @brief Variable of a snapshot (its name and its value are in the data of the snapshot).
+ */
+typedef struct SavedVariable {
+    size_t name;                // Offset of the name.
+    Types type;
+    int size;
+    int initialized;
+    int has_value;
+    size_t value;               // Offset of the value, as it is in memory.
+    size_t bytes;
+    const Variable *source;     // Variable of the run (NULL in a decoded snapshot).
+    unsigned long long generation; // Of the source, when it was captured.
+    int reused;                 // The value is copied from the previous snapshot by the writer thread.
+} SavedVariable;
+
+/**
+ * @struct Snapshot
+ *
+ * @brief State of a run at the back edge of a loop.
+ */
+typedef struct Snapshot {
+    uint32_t *position;
+    int depth;
+    long long input_offset;     // -1 if the input could not tell its offset (a pipe).
+    EvalResult *temps;
+    int temp_count;
+    SavedVariable *variables;   // In the order they were declared.
+    int variable_count;
+    unsigned char *data;
+    size_t data_size;
+} Snapshot;
+
+/**
+ * @struct Buffer
+ *
+ * @brief Bytes that grow on demand (failed is set if there is no memory).
+ */
+typedef struct Buffer {
+    unsigned char *data;
+    size_t size;
+    size_t capacity;
+    int failed;
+} Buffer;
+
+/**
+ * @struct Reader
+ *
+ * @brief Bytes being decoded (failed is set if they end too soon).
+ */
+typedef struct Reader {
+    const unsigned char *p;
+    size_t left;
+    int failed;
+} Reader;
+
+struct Checkpoint {
+    char *path;
+    char *temp_path;            // The full snapshots are written here, and then renamed to path.
+    double interval;
+    double next_save;
+    unsigned ticks;
+    const Node *program;
+    uint64_t program_hash;
+
+    /* Path to the loop of the last snapshot (the same loop usually saves all of them). */
+    const Node *loop;
+    uint32_t *position;
+    int depth;
+
+    pthread_t writer;
+    pthread_mutex_t lock;
+    pthread_cond_t wake;
+    Snapshot *pending;          // Snapshot being written (guarded by lock).
+    int stop;                   // Guarded by lock.
+    int error;                  // errno of the first write that failed (guarded by lock).
+
+    /* State of the writer thread. */
+    FILE *file;
+    Snapshot *written;          // Last snapshot written to the file.
+    size_t file_size;
+    size_t full_size;           // Size of the file with only its full snapshot.
+    Buffer buffer;
+};
+
+/* Values are always little-endian in the file. */
+
+static void buffer_reserve(Buffer *b, size_t n) {
+    if (b->failed || b->capacity - b->size >= n) return;
+
+    size_t capacity = b->capacity ? b->capacity : 4096;
+    while (capacity - b->size < n) capacity *= 2;
+    unsigned char *data = (unsigned char *)realloc(b->data, capacity);
+    if (!data) {
+        b->failed = 1;
+        return;
+    }
+    b->data = data;
+    b->capacity = capacity;
+}
+
+static void put_bytes(Buffer *b, const void *p, size_t n) {
+    buffer_reserve(b, n);
+    if (b->failed) return;
+    memcpy(b->data + b->size, p, n);
+    b->size += n;
+}
+
+static void put_u8(Buffer *b, unsigned x) {
+    unsigned char c = (unsigned char)x;
+    put_bytes(b, &c, 1);
+}
+
+static void put_u32(Buffer *b, uint32_t x) {
+    unsigned char p[4];
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(x >> (8 * i));
+    put_bytes(b, p, 4);
+}
+
+static void put_u64(Buffer *b, uint64_t x) {
+    unsigned char p[8];
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(x >> (8 * i));
+    put_bytes(b, p, 8);
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    uint32_t x = 0;
+    for (int i = 0; i < 4; i++) x |= (uint32_t)p[i] << (8 * i);
+    return x;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    uint64_t x = 0;
+    for (int i = 0; i < 8; i++) x |= (uint64_t)p[i] << (8 * i);
+    return x;
+}
+
+static const unsigned char *read_bytes(Reader *r, size_t n) {
+    if (r->failed || r->left < n) {
+        r->failed = 1;
+        return NULL;
+    }
+    const unsigned char *p = r->p;
+    r->p += n;
+    r->left -= n;
+    return p;
+}
+
+static unsigned read_u8(Reader *r) {
+    const unsigned char *p = read_bytes(r, 1);
+    return p ? *p : 0;
+}
+
+static uint32_t read_u32(Reader *r) {
+    const unsigned char *p = read_bytes(r, 4);
+    return p ? get_u32(p) : 0;
+}
+
+static uint64_t read_u64(Reader *r) {
+    const unsigned char *p = read_bytes(r, 8);
+    return p ? get_u64(p) : 0;
+}
+
+/**
+ * @brief FNV-1a of the payload of a snapshot, to tell a complete one from one cut by a crash.
+ */
+static uint64_t checksum(const unsigned char *p, size_t n) {
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (size_t i = 0; i < n; i++) {
+        h ^= p[i];
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+static int is_int(Types type) {
+    return type == T_INTEIRO || type == T_LISTAINT;
+}
+
+/**
+ * @brief Returns the size of the value of a variable (its data, for a list).
+ */
+static size_t value_bytes(Types type, int size) {
+    size_t element = is_int(type) ? sizeof(int) : sizeof(double);
+    return (type == T_LISTAINT || type == T_LISTAREAL) ? element * (size_t)size : element;
+}
+
+static void snapshot_free(Snapshot *s) {
+    if (!s) return;
+
+    free(s->position);
+    free(s->temps);
+    free(s->variables);
+    free(s->data);
+    free(s);
+}
+
+/**
+ * @brief Finds the path from a node to a loop, storing it in c->position.
+ *
+ * @return 1 if the loop is inside the node, 0 otherwise (or if there is no memory).
+ */
+static int find_path(Checkpoint *c, const Node *n, const Node *loop, int depth) {
+    if (!n) return 0;
+    if (n == loop) {
+        c->position = (uint32_t *)malloc(sizeof(uint32_t) * (depth ? depth : 1));
+        c->depth = depth;
+        return c->position != NULL;
+    }
+
+    switch (n->type) {
+        case NODE_BLOCK:
+            for (int i = 0; i < n->block.count; i++) {
+                if (find_path(c, n->block.cmds[i], loop, depth + 1)) {
+                    c->position[depth] = (uint32_t)i;
+                    return 1;
+                }
+            }
+            return 0;
+        case NODE_IF:
+            if (find_path(c, n->ifnode.then_block, loop, depth + 1)) {
+                c->position[depth] = 0;
+                return 1;
+            }
+            if (find_path(c, n->ifnode.else_block, loop, depth + 1)) {
+                c->position[depth] = 1;
+                return 1;
+            }
+            return 0;
+        case NODE_WHILE:
+            if (find_path(c, n->whilenode.body, loop, depth + 1)) {
+                c->position[depth] = 0;
+                return 1;
+            }
+            return 0;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Returns the variable of the previous snapshot with the value a variable still has, or NULL.
+ *
+ * @param i Position of the variable, in the order they were declared.
+ */
+static const SavedVariable *same_generation(const Variable *v, int i, const Snapshot *previous) {
+    if (!previous || i >= previous->variable_count) return NULL;
+
+    const SavedVariable *p = &previous->variables[i];
+    if (p->source != v || p->generation != v->generation || !p->has_value || !v->data || p->size != v->size) {
+        return NULL;
+    }
+    return p;
+}
+
+/**
+ * @brief Copies the state of the run (done by the execution, so it only copies memory).
+ *
+ * Only the values that changed since the previous snapshot (by their generation) are copied; the others are marked
+ * as reused, and copied from it by the writer thread (see fill_reused()).
+ *
+ * @param previous Last snapshot written (NULL if none), not used by the writer thread while it is idle.
+ *
+ * @return The snapshot, or NULL if there is no memory.
+ */
+static Snapshot *capture(Context *ctx, const Checkpoint *c, const Snapshot *previous) {
+    int count = 0;
+    size_t size = 0;
+    for (ListNode *l = ctx->variables->start; l; l = l->next) {
+        Variable *v = l->variable;
+        count++;
+        size += strlen(v->name) + 1;
+        if (v->data) size += value_bytes(v->type, v->size);
+    }
+
+    Snapshot *s = (Snapshot *)calloc(1, sizeof(Snapshot));
+    if (!s) return NULL;
+    s->position = (uint32_t *)malloc(sizeof(uint32_t) * (c->depth ? c->depth : 1));
+    s->temps = (EvalResult *)malloc(sizeof(EvalResult) * (ctx->temp_count ? ctx->temp_count : 1));
+    s->variables = (SavedVariable *)malloc(sizeof(SavedVariable) * (count ? count : 1));
+    s->data = (unsigned char *)malloc(size ? size : 1);
+    if (!s->position || !s->temps || !s->variables || !s->data) {
+        snapshot_free(s);
+        return NULL;
+    }
+
+    memcpy(s->position, c->position, sizeof(uint32_t) * c->depth);
+    s->depth = c->depth;
+    if (ctx->temp_count) memcpy(s->temps, ctx->temps, sizeof(EvalResult) * ctx->temp_count);
+    s->temp_count = ctx->temp_count;
+    s->input_offset = ftell(ctx->in);
+    if (s->input_offset < 0) s->input_offset = -1;
+
+    /* The symbol table has the last declared variable first. */
+    s->variable_count = count;
+    int i = count;
+    for (ListNode *l = ctx->variables->start; l; l = l->next) {
+        Variable *v = l->variable;
+        SavedVariable *saved = &s->variables[--i];
+        size_t length = strlen(v->name) + 1;
+
+        saved->name = s->data_size;
+        memcpy(s->data + s->data_size, v->name, length);
+        s->data_size += length;
+
+        saved->type = v->type;
+        saved->size = v->size;
+        saved->initialized = v->initialized;
+        saved->has_value = v->data != NULL;
+        saved->value = s->data_size;
+        saved->bytes = v->data ? value_bytes(v->type, v->size) : 0;
+        saved->source = v;
+        saved->generation = v->generation;
+        saved->reused = same_generation(v, i, previous) != NULL;
+        if (v->data && !saved->reused) memcpy(s->data + s->data_size, v->data, saved->bytes);
+        s->data_size += saved->bytes;
+    }
+    return s;
+}
+
+/**
+ * @brief Copies the values that capture() left to be taken from the previous snapshot (done by the writer thread).
+ *
+ * @param previous The snapshot given to capture().
+ */
+static void fill_reused(Snapshot *s, const Snapshot *previous) {
+    for (int i = 0; i < s->variable_count; i++) {
+        SavedVariable *v = &s->variables[i];
+        if (v->reused) memcpy(s->data + v->value, previous->data + previous->variables[i].value, v->bytes);
+    }
+}
+
+/**
+ * @brief Returns 1 if a variable has the same value it had in the previous snapshot.
+ */
+static int unchanged(const Snapshot *s, int i, const Snapshot *previous) {
+    if (!previous || i >= previous->variable_count) return 0;
+    if (s->variables[i].reused) return 1;
+
+    const SavedVariable *v = &s->variables[i], *p = &previous->variables[i];
+    return p->has_value && p->type == v->type && p->size == v->size
+        && strcmp((const char *)previous->data + p->name, (const char *)s->data + v->name) == 0
+        && memcmp(previous->data + p->value, s->data + v->value, v->bytes) == 0;
+}
+
+/**
+ * @brief Encodes a snapshot as a record of the file.
+ *
+ * @param previous Last snapshot in the file (NULL for a full snapshot).
+ */
+static void encode(Buffer *b, const Snapshot *s, const Snapshot *previous) {
+    b->size = 0;
+    b->failed = 0;
+
+    put_u8(b, 'S');
+    put_u32(b, 0);      // Size of the payload, set below.
+
+    put_u32(b, (uint32_t)s->depth);
+    for (int i = 0; i < s->depth; i++) put_u32(b, s->position[i]);
+    put_u64(b, (uint64_t)s->input_offset);
+
+    put_u32(b, (uint32_t)s->temp_count);
+    for (int i = 0; i < s->temp_count; i++) {
+        const EvalResult *t = &s->temps[i];
+        uint64_t bits;
+        if (t->type == T_INTEIRO) {
+            bits = (uint32_t)t->v.i;
+        } else {
+            memcpy(&bits, &t->v.d, sizeof(bits));
+        }
+        put_u8(b, t->type == T_INTEIRO ? T_INTEIRO : T_REAL);
+        put_u64(b, bits);
+    }
+
+    put_u32(b, (uint32_t)s->variable_count);
+    for (int i = 0; i < s->variable_count; i++) {
+        const SavedVariable *v = &s->variables[i];
+        const char *name = (const char *)s->data + v->name;
+        size_t length = strlen(name);
+
+        put_u32(b, (uint32_t)length);
+        put_bytes(b, name, length);
+        put_u8(b, v->type);
+        put_u32(b, (uint32_t)v->size);
+        put_u8(b, v->initialized);
+
+        if (!v->has_value) {
+            put_u8(b, VALUE_NONE);
+        } else if (unchanged(s, i, previous)) {
+            put_u8(b, VALUE_UNCHANGED);
+        } else {
+            put_u8(b, VALUE_SAVED);
+            const unsigned char *p = s->data + v->value;
+            if (is_int(v->type)) {
+                for (size_t j = 0; j < v->bytes; j += sizeof(int)) {
+                    int x;
+                    memcpy(&x, p + j, sizeof(x));
+                    put_u32(b, (uint32_t)x);
+                }
+            } else {
+                for (size_t j = 0; j < v->bytes; j += sizeof(double)) {
+                    uint64_t x;
+                    memcpy(&x, p + j, sizeof(x));
+                    put_u64(b, x);
+                }
+            }
+        }
+    }
+
+    if (b->failed) return;
+    size_t length = b->size - 5;
+    for (int i = 0; i < 4; i++) b->data[1 + i] = (unsigned char)((uint32_t)length >> (8 * i));
+    put_u64(b, checksum(b->data + 5, length));
+}
+
+/**
+ * @brief Writes a snapshot to the file (done by the writer thread).
+ *
+ * @return 0 if OK, or the errno of the failure.
+ */
+static int write_snapshot(Checkpoint *c, const Snapshot *s) {
+    int full = !c->file || c->file_size >= CHECKPOINT_COMPACT_RATIO * c->full_size;
+    encode(&c->buffer, s, full ? NULL : c->written);
+    if (c->buffer.failed) return ENOMEM;
+
+    errno = 0;
+    if (!full) {
+        if (fwrite(c->buffer.data, 1, c->buffer.size, c->file) != c->buffer.size || fflush(c->file) != 0
+            || fdatasync(fileno(c->file)) != 0) {
+            /* The file may end with part of the snapshot, so the next one starts a new file. */
+            int error = errno ? errno : EIO;
+            fclose(c->file);
+            c->file = NULL;
+            return error;
+        }
+        c->file_size += c->buffer.size;
+        return 0;
+    }
+
+    /* The previous file is only replaced once the new one is complete. */
+    FILE *f = fopen(c->temp_path, "wb");
+    if (!f) return errno;
+
+    Buffer header = { NULL, 0, 0, 0 };
+    put_bytes(&header, CHECKPOINT_MAGIC, 8);
+    put_u64(&header, c->program_hash);
+    if (header.failed || fwrite(header.data, 1, header.size, f) != header.size
+        || fwrite(c->buffer.data, 1, c->buffer.size, f) != c->buffer.size || fflush(f) != 0
+        || fsync(fileno(f)) != 0 || rename(c->temp_path, c->path) != 0) {
+        int error = header.failed ? ENOMEM : (errno ? errno : EIO);
+        free(header.data);
+        fclose(f);
+        remove(c->temp_path);
+        return error;
+    }
+    free(header.data);
+
+    /* The next snapshots are appended to the same file, which now has the final name. */
+    if (c->file) fclose(c->file);
+    c->file = f;
+    c->file_size = c->full_size = HEADER_SIZE + c->buffer.size;
+    return 0;
+}
+
+static void *writer_main(void *arg) {
+    Checkpoint *c = (Checkpoint *)arg;
+
+    pthread_mutex_lock(&c->lock);
+    while (1) {
+        while (!c->pending && !c->stop) pthread_cond_wait(&c->wake, &c->lock);
+        Snapshot *s = c->pending;
+        if (!s) break;
+
+        pthread_mutex_unlock(&c->lock);
+        fill_reused(s, c->written);
+        int error = write_snapshot(c, s);
+        pthread_mutex_lock(&c->lock);
+
+        c->pending = NULL;
+        if (error) {
+            if (!c->error) c->error = error;
+            snapshot_free(s);
+        } else {
+            snapshot_free(c->written);
+            c->written = s;
+        }
+    }
+    pthread_mutex_unlock(&c->lock);
+    return NULL;
+}
+
+static void checkpoint_free(Checkpoint *c) {
+    free(c->path);
+    free(c->temp_path);
+    free(c->position);
+    snapshot_free(c->written);
+    free(c->buffer.data);
+    free(c);
+}
+
+Checkpoint *checkpoint_create(const char *path, double interval, const Node *program, uint64_t program_hash) {
+    Checkpoint *c = (Checkpoint *)calloc(1, sizeof(Checkpoint));
+    if (!c) return NULL;
+
+    size_t length = strlen(path);
+    c->path = (char *)malloc(length + 1);
+    c->temp_path = (char *)malloc(length + 5);
+    if (!c->path || !c->temp_path) {
+        checkpoint_free(c);
+        return NULL;
+    }
+    memcpy(c->path, path, length + 1);
+    snprintf(c->temp_path, length + 5, "%s.tmp", path);
+
+    /* A file that cannot be written is reported now, instead of at the end of a long run. */
+    FILE *f = fopen(c->temp_path, "wb");
+    if (!f) {
+        int error = errno;
+        checkpoint_free(c);
+        errno = error;
+        return NULL;
+    }
+    fclose(f);
+    remove(c->temp_path);
+
+    c->interval = interval;
+    c->next_save = stats_clock() + interval;
+    c->program = program;
+    c->program_hash = program_hash;
+
+    pthread_mutex_init(&c->lock, NULL);
+    pthread_cond_init(&c->wake, NULL);
+    int error = pthread_create(&c->writer, NULL, writer_main, c);
+    if (error) {
+        pthread_mutex_destroy(&c->lock);
+        pthread_cond_destroy(&c->wake);
+        checkpoint_free(c);
+        errno = error;
+        return NULL;
+    }
+    return c;
+}
+
+void checkpoint_tick(Context *ctx, const Node *loop) {
+    Checkpoint *c = ctx->checkpoint;
+    if (++c->ticks < CHECKPOINT_CHECK_INTERVAL) return;
+    c->ticks = 0;
+
+    double now = stats_clock();
+    if (now < c->next_save) return;
+
+    pthread_mutex_lock(&c->lock);
+    int busy = c->pending != NULL;
+    pthread_mutex_unlock(&c->lock);
+    if (busy) return;
+
+    if (loop != c->loop) {
+        free(c->position);
+        c->position = NULL;
+        c->loop = find_path(c, c->program, loop, 0) ? loop : NULL;
+        if (!c->loop) return;
+    }
+
+    /* The writer is idle, so its last snapshot can be read here. */
+    Snapshot *s = capture(ctx, c, c->written);
+    if (!s) return;
+
+    /* The output of the run up to the snapshot is not written again by a run that resumes from it. */
+    fflush(ctx->out);
+
+    pthread_mutex_lock(&c->lock);
+    c->pending = s;
+    pthread_cond_signal(&c->wake);
+    pthread_mutex_unlock(&c->lock);
+    c->next_save = now + c->interval;
+}
+
+int checkpoint_close(Checkpoint *c, int completed) {
+    if (!c) return 1;
+
+    pthread_mutex_lock(&c->lock);
+    c->stop = 1;
+    pthread_cond_signal(&c->wake);
+    pthread_mutex_unlock(&c->lock);
+    pthread_join(c->writer, NULL);
+    pthread_mutex_destroy(&c->lock);
+    pthread_cond_destroy(&c->wake);
+
+    int ok = !c->error;
+    if (c->file && fclose(c->file) != 0) ok = 0;
+
+    /* A run that ended has nothing to resume. */
+    if (completed) remove(c->path);
+
+    checkpoint_free(c);
+    return ok;
+}
+
+/**
+ * @brief Decodes the payload of a record.
+ *
+ * @param previous Snapshot of the previous record (NULL for the first one).
+ *
+ * @return The snapshot, or NULL if the payload is invalid or there is no memory.
+ */
+static Snapshot *decode(const unsigned char *payload, size_t length, const Snapshot *previous) {
+    Reader r = { payload, length, 0 };
+    Buffer data = { NULL, 0, 0, 0 };
+
+    Snapshot *s = (Snapshot *)calloc(1, sizeof(Snapshot));
+    if (!s) return NULL;
+
+    /* The counts are checked against the bytes left, so an invalid one does not allocate too much. */
+    uint32_t depth = read_u32(&r);
+    if (depth > r.left / 4) goto invalid;
+    s->position = (uint32_t *)malloc(sizeof(uint32_t) * (depth ? depth : 1));
+    if (!s->position) goto invalid;
+    s->depth = (int)depth;
+    for (uint32_t i = 0; i < depth; i++) s->position[i] = read_u32(&r);
+    s->input_offset = (long long)read_u64(&r);
+
+    uint32_t temps = read_u32(&r);
+    if (temps > r.left / 9) goto invalid;
+    s->temps = (EvalResult *)malloc(sizeof(EvalResult) * (temps ? temps : 1));
+    if (!s->temps) goto invalid;
+    s->temp_count = (int)temps;
+    for (uint32_t i = 0; i < temps; i++) {
+        EvalResult *t = &s->temps[i];
+        t->type = read_u8(&r) == T_INTEIRO ? T_INTEIRO : T_REAL;
+        uint64_t bits = read_u64(&r);
+        if (t->type == T_INTEIRO) {
+            t->v.i = (int)(uint32_t)bits;
+        } else {
+            memcpy(&t->v.d, &bits, sizeof(bits));
+        }
+    }
+
+    uint32_t count = read_u32(&r);
+    if (count > r.left / 11) goto invalid;
+    s->variables = (SavedVariable *)malloc(sizeof(SavedVariable) * (count ? count : 1));
+    if (!s->variables) goto invalid;
+    s->variable_count = (int)count;
+
+    for (uint32_t i = 0; i < count && !r.failed && !data.failed; i++) {
+        SavedVariable *v = &s->variables[i];
+        uint32_t name_length = read_u32(&r);
+        const unsigned char *name = read_bytes(&r, name_length);
+        if (!name) goto invalid;
+        v->name = data.size;
+        put_bytes(&data, name, name_length);
+        put_u8(&data, 0);
+        if (data.failed) goto invalid;
+
+        v->type = (Types)read_u8(&r);
+        v->size = (int)read_u32(&r);
+        v->initialized = read_u8(&r) != 0;
+        if (v->type >= T_UNTYPED || v->size < 0) goto invalid;
+
+        unsigned state = read_u8(&r);
+        v->has_value = state != VALUE_NONE;
+        v->value = data.size;
+        v->bytes = v->has_value ? value_bytes(v->type, v->size) : 0;
+
+        if (state == VALUE_SAVED) {
+            size_t width = is_int(v->type) ? 4 : 8;
+            size_t elements = v->bytes / (is_int(v->type) ? sizeof(int) : sizeof(double));
+            if (elements > r.left / width) goto invalid;
+            buffer_reserve(&data, v->bytes);
+            for (size_t j = 0; j < elements && !data.failed; j++) {
+                if (is_int(v->type)) {
+                    int x = (int)read_u32(&r);
+                    put_bytes(&data, &x, sizeof(x));
+                } else {
+                    uint64_t x = read_u64(&r);
+                    put_bytes(&data, &x, sizeof(x));
+                }
+            }
+        } else if (state == VALUE_UNCHANGED) {
+            if (!previous || i >= (uint32_t)previous->variable_count) goto invalid;
+            const SavedVariable *p = &previous->variables[i];
+            if (!p->has_value || p->type != v->type || p->size != v->size
+                || strcmp((const char *)previous->data + p->name, (const char *)data.data + v->name) != 0) {
+                goto invalid;
+            }
+            put_bytes(&data, previous->data + p->value, v->bytes);
+        } else if (state != VALUE_NONE) {
+            goto invalid;
+        }
+    }
+    if (r.failed || data.failed) goto invalid;
+
+    s->data = data.data;
+    s->data_size = data.size;
+    return s;
+
+invalid:
+    free(data.data);
+    snapshot_free(s);
+    return NULL;
+}
+
+/**
+ * @brief Reads a whole file to memory.
+ *
+ * @return 0 if OK, or the errno of the failure.
+ */
+static int load_file(const char *path, unsigned char **data, size_t *size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) return errno;
+
+    Buffer b = { NULL, 0, 0, 0 };
+    unsigned char chunk[65536];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0) put_bytes(&b, chunk, n);
+
+    int error = ferror(f) ? EIO : (b.failed ? ENOMEM : 0);
+    fclose(f);
+    if (error) {
+        free(b.data);
+        return error;
+    }
+
+    *data = b.data;
+    *size = b.size;
+    return 0;
+}
+
+int checkpoint_restore(Context *ctx, const char *path, uint64_t program_hash, uint32_t **position, int *depth) {
+    unsigned char *data = NULL;
+    size_t size = 0;
+    int error = load_file(path, &data, &size);
+    if (error) {
+        snprintf(ctx->error, sizeof(ctx->error), "restore: could not read '%s': %s", path, strerror(error));
+        return 1;
+    }
+
+    if (size < HEADER_SIZE || memcmp(data, CHECKPOINT_MAGIC, 8) != 0) {
+        snprintf(ctx->error, sizeof(ctx->error), "restore: '%s' is not a checkpoint.", path);
+        free(data);
+        return 1;
+    }
+    if (get_u64(data + 8) != program_hash) {
+        snprintf(ctx->error, sizeof(ctx->error), "restore: '%s' was saved by a different program.", path);
+        free(data);
+        return 1;
+    }
+
+    /* Each snapshot may refer to the previous one; a crash can leave the last one incomplete, and it is ignored. */
+    Snapshot *last = NULL;
+    size_t at = HEADER_SIZE;
+    while (size - at >= RECORD_OVERHEAD && data[at] == 'S') {
+        size_t length = get_u32(data + at + 1);
+        if (size - at - RECORD_OVERHEAD < length) break;
+
+        const unsigned char *payload = data + at + 5;
+        if (get_u64(payload + length) != checksum(payload, length)) break;
+
+        Snapshot *s = decode(payload, length, last);
+        if (!s) break;
+        snapshot_free(last);
+        last = s;
+        at += RECORD_OVERHEAD + length;
+    }
+    free(data);
+
+    if (!last) {
+        snprintf(ctx->error, sizeof(ctx->error), "restore: '%s' has no complete snapshot.", path);
+        return 1;
+    }
+
+    if (last->input_offset < 0) {
+        snprintf(ctx->error, sizeof(ctx->error), "restore: '%s' does not have the offset of the input (it was read "
+            "from a pipe), so the run cannot be resumed.", path);
+        snapshot_free(last);
+        return 1;
+    }
+    if (fseek(ctx->in, (long)last->input_offset, SEEK_SET) != 0) {
+        snprintf(ctx->error, sizeof(ctx->error), "restore: the input cannot be moved to offset %lld (it must be "
+            "the file the run was reading).", last->input_offset);
+        snapshot_free(last);
+        return 1;
+    }
+
+    if (last->temp_count) {
+        EvalResult *temps = (EvalResult *)malloc(sizeof(EvalResult) * last->temp_count);
+        if (!temps) goto no_memory;
+        memcpy(temps, last->temps, sizeof(EvalResult) * last->temp_count);
+        free(ctx->temps);
+        ctx->temps = temps;
+        ctx->temp_count = last->temp_count;
+    }
+
+    for (int i = 0; i < last->variable_count; i++) {
+        const SavedVariable *saved = &last->variables[i];
+        Variable *v = create_var((char *)last->data + saved->name, saved->type, saved->size);
+        if (!v) goto no_memory;
+
+        if (saved->has_value) {
+            v->data = malloc(saved->bytes ? saved->bytes : 1);
+            if (!v->data) {
+                free(v->name);
+                free(v);
+                goto no_memory;
+            }
+            memcpy(v->data, last->data + saved->value, saved->bytes);
+            if (saved->type == T_LISTAINT || saved->type == T_LISTAREAL) ctx->stats.list_bytes += saved->bytes;
+            else ctx->stats.variable_bytes += saved->bytes;
+        }
+        v->initialized = saved->initialized;
+        insert(ctx->variables, v);
+        ctx->stats.variable_bytes += sizeof(Variable) + strlen(v->name) + 1;
+    }
+
+    *position = last->position;
+    *depth = last->depth;
+    last->position = NULL;
+    snapshot_free(last);
+    return 0;
+
+no_memory:
+    snprintf(ctx->error, sizeof(ctx->error), "restore: malloc() failed: %s", strerror(errno));
+    snapshot_free(last);
+    return 1;
+}
@@ -0,0 +1,87 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+
+#define CHECKPOINT_MAGIC "SCCHKPT1"
+
+/* Seconds between two snapshots, by default. */
+#define CHECKPOINT_DEFAULT_INTERVAL 60.0
+
+/* Loop iterations between two readings of the clock. */
+#define CHECKPOINT_CHECK_INTERVAL 1024
+
+/* The snapshots are written again from scratch when the file grows to this many times the size of a full one. */
+#define CHECKPOINT_COMPACT_RATIO 4
+
+/**
+ * @struct Checkpoint
+ *
+ * @brief Saves snapshots of a run at the back edges of its loops, so it can be resumed (with checkpoint_restore())
+ * after a crash.
+ *
+ * A snapshot has the position of the run (the loop, as the path from the root of the program), the variables with
+ * their values and initialization flags, the temporaries of the optimizer, and the offset of the input. Since there
+ * are no functions, the loop fixes every statement the run is inside of, so this is the whole state.
+ *
+ * The execution only copies the state to memory, and only the variables whose generation changed since the previous
+ * snapshot (the writer copies the others from it); a thread encodes it and writes it. The file starts with
+ * CHECKPOINT_MAGIC and the hash of the program (hash_node()), followed by the snapshots, each one with its size and a
+ * checksum, so one cut by a crash is ignored. Only the first snapshot of the file is full: the others leave out the
+ * variables that did not change since the previous one. When the file grows to CHECKPOINT_COMPACT_RATIO times a full
+ * snapshot, a full one is written to a new file, which replaces the old one.
+ */
+typedef struct Checkpoint Checkpoint;
+
+/**
+ * @brief Starts saving snapshots of a run.
+ *
+ * @param path File of the snapshots (replaced by the first one).
+ * @param interval Minimum seconds between two snapshots.
+ * @param program Program being run (the snapshots are positioned in it).
+ * @param program_hash Hash of the program.
+ *
+ * @return The checkpoint, or NULL if it could not be created (errno is set).
+ */
+Checkpoint *checkpoint_create(const char *path, double interval, const Node *program, uint64_t program_hash);
+
+/**
+ * @brief Counts an iteration of a loop, saving a snapshot if the interval has passed (called on the back edges).
+ *
+ * If the previous snapshot is still being written, the new one is left for the next check.
+ *
+ * @param ctx Context (ctx->checkpoint is set).
+ * @param loop NODE_WHILE whose body was just executed.
+ */
+void checkpoint_tick(Context *ctx, const Node *loop);
+
+/**
+ * @brief Waits for the last snapshot to be written, and frees the checkpoint.
+ *
+ * @param c Checkpoint (can be NULL).
+ * @param completed 1 if the run ended normally, in which case the file is removed.
+ *
+ * @return 1 if OK, 0 if writing a snapshot failed.
+ */
+int checkpoint_close(Checkpoint *c, int completed);
+
+/**
+ * @brief Restores the state of the last complete snapshot of a file.
+ *
+ * The variables are created in the context (which must have none), and ctx->in is moved to the offset of the
+ * snapshot (it fails if the snapshot has no offset, or ctx->in cannot be moved). The run is then resumed with
+ * context_resume().
+ *
+ * @param ctx Context.
+ * @param path File of the snapshots.
+ * @param program_hash Hash of the program, which must be the one that saved the snapshots.
+ * @param position Receives the path to the loop (to be freed).
+ * @param depth Receives the length of the path.
+ *
+ * @return 0 on success, 1 on an error (the message is in ctx->error).
+ */
+int checkpoint_restore(Context *ctx, const char *path, uint64_t program_hash, uint32_t **position, int *depth);
+
+#endif // CHECKPOINT_H
@@ -0,0 +1,385 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "compact.h"
+#include "context.h"
+
+/**
+ * @struct Builder
+ *
+ * @brief State of compact_from_tree(): the AST being built and a hash table of the strings already stored.
+ */
+typedef struct Builder {
+    Context *ctx;
+    CompactAst *ast;
+    uint32_t *interned;     // Indices in ast->strings (NONE for empty buckets).
+    uint32_t buckets;       // Power of two, at least twice the number of strings.
+} Builder;
+
+/**
+ * @brief Frees everything built so far and reports that there is no memory.
+ */
+static void out_of_memory(Builder *b) {
+    compact_free(b->ast);
+    free(b->interned);
+    context_error(b->ctx, "malloc() failed: %s", strerror(errno));
+}
+
+/**
+ * @brief Makes room for one more entry in an array, doubling its capacity when it is full.
+ *
+ * @param b Builder.
+ * @param array Pointer to the array.
+ * @param size Size of each entry.
+ * @param count Entries in use.
+ * @param capacity Capacity (updated).
+ */
+static void reserve(Builder *b, void **array, size_t size, uint32_t count, uint32_t *capacity) {
+    if (count < *capacity) return;
+
+    uint32_t grown = *capacity ? *capacity * 2 : 16;
+    void *resized = realloc(*array, size * grown);
+    if (!resized) out_of_memory(b);
+    *array = resized;
+    *capacity = grown;
+}
+
+static uint32_t hash_string(const char *s) {
+    uint32_t h = 2166136261u;
+    for (; *s; s++) h = (h ^ (unsigned char)*s) * 16777619u;
+    return h;
+}
+
+/**
+ * @brief Returns the index of a string in the side table, storing it if it is not there yet.
+ */
+static uint32_t intern(Builder *b, const char *s) {
+    if (!s) return COMPACT_NONE;
+    CompactAst *ast = b->ast;
+
+    if ((ast->string_count + 1) * 2 > b->buckets) {
+        uint32_t buckets = b->buckets ? b->buckets * 2 : 64;
+        uint32_t *interned = (uint32_t *)malloc(sizeof(uint32_t) * buckets);
+        if (!interned) out_of_memory(b);
+        memset(interned, 0xFF, sizeof(uint32_t) * buckets);
+
+        for (uint32_t i = 0; i < ast->string_count; i++) {
+            uint32_t h = hash_string(ast->strings[i]) & (buckets - 1);
+            while (interned[h] != COMPACT_NONE) h = (h + 1) & (buckets - 1);
+            interned[h] = i;
+        }
+        free(b->interned);
+        b->interned = interned;
+        b->buckets = buckets;
+    }
+
+    uint32_t h = hash_string(s) & (b->buckets - 1);
+    for (; b->interned[h] != COMPACT_NONE; h = (h + 1) & (b->buckets - 1)) {
+        if (strcmp(ast->strings[b->interned[h]], s) == 0) return b->interned[h];
+    }
+
+    reserve(b, (void **)&ast->strings, sizeof(char *), ast->string_count, &ast->string_capacity);
+    char *copy = strdup(s);
+    if (!copy) out_of_memory(b);
+
+    ast->strings[ast->string_count] = copy;
+    b->interned[h] = ast->string_count;
+    return ast->string_count++;
+}
+
+static uint32_t add_real(Builder *b, double value) {
+    CompactAst *ast = b->ast;
+    reserve(b, (void **)&ast->reals, sizeof(double), ast->real_count, &ast->real_capacity);
+    ast->reals[ast->real_count] = value;
+    return ast->real_count++;
+}
+
+static uint32_t add_list_entry(Builder *b, uint32_t value) {
+    CompactAst *ast = b->ast;
+    reserve(b, (void **)&ast->lists, sizeof(uint32_t), ast->list_count, &ast->list_capacity);
+    ast->lists[ast->list_count] = value;
+    return ast->list_count++;
+}
+
+/**
+ * @brief Appends a node after all the nodes already stored (so after its children).
+ *
+ * @return The index of the node.
+ */
+static uint32_t add_node(Builder *b, NodeType kind, int op, uint32_t x, uint32_t y, uint32_t z) {
+    CompactAst *ast = b->ast;
+    if (ast->count == ast->capacity) {
+        uint32_t capacity = ast->capacity;
+        reserve(b, (void **)&ast->kind, sizeof(uint8_t), ast->count, &capacity);
+        capacity = ast->capacity;
+        reserve(b, (void **)&ast->op, sizeof(uint8_t), ast->count, &capacity);
+        capacity = ast->capacity;
+        reserve(b, (void **)&ast->a, sizeof(uint32_t), ast->count, &capacity);
+        capacity = ast->capacity;
+        reserve(b, (void **)&ast->b, sizeof(uint32_t), ast->count, &capacity);
+        capacity = ast->capacity;
+        reserve(b, (void **)&ast->c, sizeof(uint32_t), ast->count, &capacity);
+        ast->capacity = capacity;
+    }
+
+    ast->kind[ast->count] = (uint8_t)kind;
+    ast->op[ast->count] = (uint8_t)op;
+    ast->a[ast->count] = x;
+    ast->b[ast->count] = y;
+    ast->c[ast->count] = z;
+    return ast->count++;
+}
+
+/**
+ * @brief Stores the children of a node and then the node itself (post-order).
+ *
+ * @return The index of the node, or NONE for a NULL node.
+ */
+static uint32_t emit(Builder *b, Node *n) {
+    if (!n) return COMPACT_NONE;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+        {
+            uint32_t *children = (uint32_t *)malloc(sizeof(uint32_t) * (n->block.count ? n->block.count : 1));
+            if (!children) out_of_memory(b);
+
+            for (int i = 0; i < n->block.count; i++) children[i] = emit(b, n->block.cmds[i]);
+
+            /* Added only now, so the entries of nested blocks do not end up in the middle. */
+            uint32_t first = b->ast->list_count;
+            for (int i = 0; i < n->block.count; i++) add_list_entry(b, children[i]);
+            free(children);
+            return add_node(b, NODE_BLOCK, 0, first, (uint32_t)n->block.count, (uint32_t)n->block.iterations);
+        }
+        case NODE_DECL:
+            return add_node(b, NODE_DECL, n->decl.vartype, intern(b, n->decl.name), (uint32_t)n->decl.size,
+                COMPACT_NONE);
+        case NODE_ASSIGN:
+        {
+            uint32_t expr = emit(b, n->assign.expr);
+            uint32_t var = emit(b, n->assign.var);
+            return add_node(b, NODE_ASSIGN, 0, expr, var, COMPACT_NONE);
+        }
+        case NODE_IF:
+        {
+            uint32_t cond = emit(b, n->ifnode.cond);
+            uint32_t then_block = emit(b, n->ifnode.then_block);
+            uint32_t else_block = emit(b, n->ifnode.else_block);
+            return add_node(b, NODE_IF, 0, cond, then_block, else_block);
+        }
+        case NODE_WHILE:
+        {
+            uint32_t cond = emit(b, n->whilenode.cond);
+            uint32_t body = emit(b, n->whilenode.body);
+            return add_node(b, NODE_WHILE, 0, cond, body, (uint32_t)n->whilenode.copies);
+        }
+        case NODE_WRITE:
+        {
+            uint32_t var = emit(b, n->writenode.var);
+            return add_node(b, NODE_WRITE, 0, intern(b, n->writenode.string), var, COMPACT_NONE);
+        }
+        case NODE_READ:
+            return add_node(b, NODE_READ, 0, emit(b, n->readnode.var), COMPACT_NONE, COMPACT_NONE);
+        case NODE_LISTIO:
+        {
+            uint32_t slice = COMPACT_NONE;
+            if (n->listio.range.start) {
+                uint32_t start = emit(b, n->listio.range.start);
+                uint32_t end = emit(b, n->listio.range.end);
+                slice = add_list_entry(b, start);
+                add_list_entry(b, end);
+            }
+
+            int flags = (n->listio.write ? 1 : 0) | (n->listio.binary ? 2 : 0);
+            return add_node(b, NODE_LISTIO, flags, intern(b, n->listio.name), intern(b, n->listio.path), slice);
+        }
+        case NODE_LISTOP:
+        {
+            uint32_t expr = emit(b, n->listop.expr);
+            return add_node(b, NODE_LISTOP, n->listop.op, intern(b, n->listop.name), expr, COMPACT_NONE);
+        }
+        case NODE_INT:
+            return add_node(b, NODE_INT, 0, (uint32_t)n->intval, COMPACT_NONE, COMPACT_NONE);
+        case NODE_REAL:
+            return add_node(b, NODE_REAL, 0, add_real(b, n->realval), COMPACT_NONE, COMPACT_NONE);
+        case NODE_VAR:
+        {
+            int by_name = n->var.index.type == VARIABLE;
+            uint32_t index = by_name ? intern(b, n->var.index.value.name) : (uint32_t)n->var.index.value.integer;
+            return add_node(b, NODE_VAR, by_name, intern(b, n->var.name), index, COMPACT_NONE);
+        }
+        case NODE_BINOP:
+        {
+            uint32_t left = emit(b, n->binop.left);
+            uint32_t right = emit(b, n->binop.right);
+            return add_node(b, NODE_BINOP, n->binop.op, left, right, COMPACT_NONE);
+        }
+        case NODE_RELOP:
+        {
+            uint32_t left = emit(b, n->relop.left);
+            uint32_t right = emit(b, n->relop.right);
+            return add_node(b, NODE_RELOP, n->relop.op, left, right, COMPACT_NONE);
+        }
+        case NODE_INTRINSIC:
+            return add_node(b, NODE_INTRINSIC, n->intrinsic.op, intern(b, n->intrinsic.name),
+                intern(b, n->intrinsic.other), COMPACT_NONE);
+        case NODE_TEMP:
+        {
+            uint32_t expr = emit(b, n->temp.expr);
+            return add_node(b, NODE_TEMP, 0, (uint32_t)n->temp.slot, expr, COMPACT_NONE);
+        }
+        default:
+            compact_free(b->ast);
+            free(b->interned);
+            context_error(b->ctx, "compact_from_tree(): unsupported node type '%d'.", n->type);
+    }
+}
+
+CompactAst *compact_from_tree(Context *ctx, Node *program) {
+    Builder b = { ctx, NULL, NULL, 0 };
+    b.ast = (CompactAst *)calloc(1, sizeof(CompactAst));
+    if (!b.ast) out_of_memory(&b);
+
+    b.ast->root = emit(&b, program);
+    free(b.interned);
+
+    /* The capacity doubles while building, so the node arrays can be up to twice the size needed. */
+    CompactAst *ast = b.ast;
+    if (ast->count && ast->count < ast->capacity) {
+        uint8_t *kind = (uint8_t *)realloc(ast->kind, sizeof(uint8_t) * ast->count);
+        uint8_t *op = (uint8_t *)realloc(ast->op, sizeof(uint8_t) * ast->count);
+        uint32_t *x = (uint32_t *)realloc(ast->a, sizeof(uint32_t) * ast->count);
+        uint32_t *y = (uint32_t *)realloc(ast->b, sizeof(uint32_t) * ast->count);
+        uint32_t *z = (uint32_t *)realloc(ast->c, sizeof(uint32_t) * ast->count);
+
+        /* Shrinking does not fail in practice; if it does, the old array is still valid. */
+        if (kind) ast->kind = kind;
+        if (op) ast->op = op;
+        if (x) ast->a = x;
+        if (y) ast->b = y;
+        if (z) ast->c = z;
+        if (kind && op && x && y && z) ast->capacity = ast->count;
+    }
+    return ast;
+}
+
+static const char *string_at(const CompactAst *ast, uint32_t i) {
+    return i != COMPACT_NONE ? ast->strings[i] : NULL;
+}
+
+/**
+ * @brief Rebuilds the tree of a node of the compact AST.
+ */
+static Node *rebuild(Context *ctx, const CompactAst *ast, uint32_t n) {
+    if (n == COMPACT_NONE) return NULL;
+
+    uint32_t a = ast->a[n], b = ast->b[n], c = ast->c[n];
+
+    switch ((NodeType)ast->kind[n]) {
+        case NODE_BLOCK:
+        {
+            Node **cmds = (Node **)malloc(sizeof(Node *) * (b ? b : 1));
+            if (!cmds) {
+                context_error(ctx, "malloc() failed: %s", strerror(errno));
+            }
+            for (uint32_t i = 0; i < b; i++) cmds[i] = rebuild(ctx, ast, ast->lists[a + i]);
+            Node *block = make_block(ctx, cmds, (int)b);
+            block->block.iterations = (int)c;
+            return block;
+        }
+        case NODE_DECL:
+            return make_decl(ctx, (Types)ast->op[n], string_at(ast, a), (int)b);
+        case NODE_ASSIGN:
+            return make_assign(ctx, rebuild(ctx, ast, a), rebuild(ctx, ast, b));
+        case NODE_IF:
+            return make_if(ctx, rebuild(ctx, ast, a), rebuild(ctx, ast, b), rebuild(ctx, ast, c));
+        case NODE_WHILE:
+        {
+            Node *loop = make_while(ctx, rebuild(ctx, ast, a), rebuild(ctx, ast, b));
+            loop->whilenode.copies = (int)c;
+            return loop;
+        }
+        case NODE_WRITE:
+            return make_write(ctx, string_at(ast, a), rebuild(ctx, ast, b));
+        case NODE_READ:
+            return make_read(ctx, rebuild(ctx, ast, a));
+        case NODE_LISTIO:
+        {
+            ListRange range = { NULL, NULL };
+            if (c != COMPACT_NONE) {
+                range.start = rebuild(ctx, ast, ast->lists[c]);
+                range.end = rebuild(ctx, ast, ast->lists[c + 1]);
+            }
+            return make_listio(ctx, ast->op[n] & 1, (ast->op[n] & 2) != 0, string_at(ast, a), range,
+                string_at(ast, b));
+        }
+        case NODE_LISTOP:
+            return make_listop(ctx, (Intrinsic)ast->op[n], string_at(ast, a), rebuild(ctx, ast, b));
+        case NODE_INT:
+            return make_int(ctx, (int)a);
+        case NODE_REAL:
+            return make_real(ctx, ast->reals[a]);
+        case NODE_VAR:
+        {
+            Index index;
+            if (ast->op[n]) {
+                index.type = VARIABLE;
+                index.value.name = strdup(ast->strings[b]);
+                if (!index.value.name) {
+                    context_error(ctx, "strdup() failed: %s", strerror(errno));
+                }
+            } else {
+                index.type = INTEGER;
+                index.value.integer = (int)b;
+            }
+            return make_var(ctx, string_at(ast, a), index);
+        }
+        case NODE_BINOP:
+            return make_binop(ctx, (BinOp)ast->op[n], rebuild(ctx, ast, a), rebuild(ctx, ast, b));
+        case NODE_RELOP:
+            return make_relop(ctx, (RelOp)ast->op[n], rebuild(ctx, ast, a), rebuild(ctx, ast, b));
+        case NODE_INTRINSIC:
+            return make_intrinsic(ctx, (Intrinsic)ast->op[n], string_at(ast, a), string_at(ast, b));
+        case NODE_TEMP:
+            return make_temp(ctx, (int)a, rebuild(ctx, ast, b));
+        default:
+            context_error(ctx, "compact_to_tree(): unsupported node type '%d'.", ast->kind[n]);
+    }
+}
+
+Node *compact_to_tree(Context *ctx, const CompactAst *ast) {
+    return rebuild(ctx, ast, ast->root);
+}
+
+int compact_matches(Context *ctx, const CompactAst *ast, const Node *program) {
+    Node *tree = compact_to_tree(ctx, ast);
+    int same = hash_node(tree) == hash_node(program);
+    free_node(tree);
+    return same;
+}
+
+size_t compact_bytes(const CompactAst *ast) {
+    size_t bytes = sizeof(CompactAst);
+    bytes += (size_t)ast->capacity * (2 * sizeof(uint8_t) + 3 * sizeof(uint32_t));
+    bytes += (size_t)ast->real_capacity * sizeof(double);
+    bytes += (size_t)ast->list_capacity * sizeof(uint32_t);
+    bytes += (size_t)ast->string_capacity * sizeof(char *);
+    for (uint32_t i = 0; i < ast->string_count; i++) bytes += strlen(ast->strings[i]) + 1;
+    return bytes;
+}
+
+void compact_free(CompactAst *ast) {
+    if (!ast) return;
+
+    free(ast->kind);
+    free(ast->op);
+    free(ast->a);
+    free(ast->b);
+    free(ast->c);
+    free(ast->reals);
+    for (uint32_t i = 0; i < ast->string_count; i++) free(ast->strings[i]);
+    free(ast->strings);
+    free(ast->lists);
+    free(ast);
+}
@@ -0,0 +1,138 @@
+#ifndef COMPACT_H
+#define COMPACT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include "ast.h"
+
+/* Index of a missing child or string. */
+#define COMPACT_NONE UINT32_MAX
+
+/**
+ * @struct CompactAst
+ *
+ * @brief The AST stored in contiguous arrays (structure of arrays), instead of one heap object per node.
+ *
+ * Node i is described by kind[i], op[i], a[i], b[i] and c[i] (14 bytes per node, against sizeof(Node) plus the
+ * overhead of malloc() for each Node), and children are 32-bit indices. Nodes are stored in post-order, the order in
+ * which they are evaluated: the children of a node always come before it, and the root is the last node.
+ *
+ * Literals and names are kept in side tables; names are stored once, however many nodes use them.
+ *
+ * | kind           | op                       | a                      | b                       | c           |
+ * |----------------|--------------------------|------------------------|-------------------------|-------------|
+ * | NODE_BLOCK     |                          | first child in lists   | number of children      | iterations  |
+ * | NODE_DECL      | variable type            | name                   | size                    |             |
+ * | NODE_ASSIGN    |                          | expression             | NODE_VAR                |             |
+ * | NODE_IF        |                          | condition              | then block              | else block  |
+ * | NODE_WHILE     |                          | condition              | body                    | copies      |
+ * | NODE_WRITE     |                          | string (or NONE)       | NODE_VAR (or NONE)      |             |
+ * | NODE_READ      |                          | NODE_VAR               |                         |             |
+ * | NODE_LISTIO    | 1: write, 2: binary      | name                   | path                    | slice       |
+ * | NODE_LISTOP    | intrinsic                | name                   | expression              |             |
+ * | NODE_INT       |                          | value                  |                         |             |
+ * | NODE_REAL      |                          | value in reals         |                         |             |
+ * | NODE_VAR       | 1: indexed by a variable | name                   | index (value or name)   |             |
+ * | NODE_BINOP     | operator                 | left                   | right                   |             |
+ * | NODE_RELOP     | operator                 | left                   | right (NONE for .NAO.)  |             |
+ * | NODE_INTRINSIC | intrinsic                | name                   | other name              |             |
+ * | NODE_TEMP      |                          | slot                   | expression (or NONE)    |             |
+ *
+ * Names and strings are indices in strings. The slice of a NODE_LISTIO is the index in lists of its start and end
+ * nodes (NONE for the whole list).
+ */
+typedef struct CompactAst {
+    uint8_t *kind;      // NodeType.
+    uint8_t *op;
+    uint32_t *a;
+    uint32_t *b;
+    uint32_t *c;
+    uint32_t count;
+    uint32_t capacity;
+    uint32_t root;      // Index of the root (count - 1), or NONE if the AST is empty.
+
+    double *reals;
+    uint32_t real_count;
+    uint32_t real_capacity;
+
+    char **strings;
+    uint32_t string_count;
+    uint32_t string_capacity;
+
+    uint32_t *lists;    // Children of the blocks and slices of NODE_LISTIO, in consecutive entries.
+    uint32_t list_count;
+    uint32_t list_capacity;
+} CompactAst;
+
+/**
+ * @brief Converts a tree of Nodes to the compact form.
+ *
+ * The tree is not modified, and the compact form does not reference it (it can be freed).
+ *
+ * @param ctx Context (errors are reported with context_error()).
+ * @param program Root of the tree (can be NULL).
+ *
+ * @return The compact AST.
+ */
+CompactAst *compact_from_tree(Context *ctx, Node *program);
+
+/**
+ * @brief Converts the compact form back to a tree of Nodes (created with the make_* functions).
+ *
+ * @param ctx Context.
+ * @param ast Compact AST.
+ *
+ * @return The root of the tree (NULL if the AST is empty).
+ */
+Node *compact_to_tree(Context *ctx, const CompactAst *ast);
+
+/**
+ * @brief Checks that the compact form converts back to the tree it was built from.
+ *
+ * The tree rebuilt with compact_to_tree() is compared with the original by their hashes (hash_node()).
+ *
+ * @param ctx Context.
+ * @param ast Compact AST.
+ * @param program Tree the compact AST was built from.
+ *
+ * @return 1 if the trees are the same, 0 otherwise.
+ */
+int compact_matches(Context *ctx, const CompactAst *ast, const Node *program);
+
+/**
+ * @brief Returns the memory used by the compact AST (node arrays and side tables, including the strings).
+ *
+ * @param ast Compact AST.
+ *
+ * @return Size in bytes.
+ */
+size_t compact_bytes(const CompactAst *ast);
+
+/**
+ * @brief Frees the compact AST.
+ *
+ * @param ast Compact AST (can be NULL).
+ */
+void compact_free(CompactAst *ast);
+
+/**
+ * @brief Same as eval_node(), for a node of the compact AST (implemented in ast.c).
+ *
+ * @param ctx Context.
+ * @param ast Compact AST.
+ * @param n Index of the node (NONE results in the real 0.0, as a NULL node in eval_node()).
+ *
+ * @return The result of the calculation.
+ */
+EvalResult eval_compact(Context *ctx, const CompactAst *ast, uint32_t n);
+
+/**
+ * @brief Same as execute_node(), for a node of the compact AST (implemented in ast.c).
+ *
+ * @param ctx Context.
+ * @param ast Compact AST.
+ * @param n Index of the node (NONE does nothing).
+ */
+void execute_compact(Context *ctx, const CompactAst *ast, uint32_t n);
+
+#endif // COMPACT_H
@@ -0,0 +1,134 @@
+#include <stdlib.h>
+#include <stdarg.h>
+#include <string.h>
+#include "context.h"
+#include "optimizer.h"
+#include "perf.h"
+
+Context *context_create(void) {
+    Context *ctx = (Context *)calloc(1, sizeof(Context));
+    if (!ctx) return NULL;
+
+    ctx->variables = initialize();
+    if (!ctx->variables) {
+        free(ctx);
+        return NULL;
+    }
+
+    ctx->in = stdin;
+    ctx->out = stdout;
+    ctx->unroll_factor = OPT_UNROLL_FACTOR;
+    return ctx;
+}
+
+void context_free(Context *ctx) {
+    if (!ctx) return;
+
+    free_node(ctx->program);
+    free(ctx->temps);
+    tier_free(ctx->tiers);
+    perf_free(ctx->stats.perf);
+    checkpoint_close(ctx->checkpoint, 0);
+    budget_stop(ctx);
+    clean(ctx->variables);
+    free(ctx->variables);
+    free(ctx);
+}
+
+int context_execute(Context *ctx, Node *program) {
+    jmp_buf recover;
+    jmp_buf *previous = ctx->recover;
+
+    ctx->recover = &recover;
+    if (setjmp(recover)) {
+        budget_stop(ctx);
+        ctx->recover = previous;
+        return 1;
+    }
+
+    budget_start(ctx);
+
+    /* The specialized code of a previous run points to its variables. */
+    tier_free(ctx->tiers);
+    ctx->tiers = NULL;
+
+    execute_node(ctx, program);
+    budget_stop(ctx);
+    ctx->recover = previous;
+    return 0;
+}
+
+int context_optimize(Context *ctx) {
+    jmp_buf recover;
+    jmp_buf *previous = ctx->recover;
+    Node *program = ctx->program;
+    ctx->program = NULL;
+
+    ctx->recover = &recover;
+    if (setjmp(recover)) {
+        ctx->recover = previous;
+        return 1;
+    }
+
+    ctx->program = optimize(ctx, program);
+    ctx->recover = previous;
+    return 0;
+}
+
+int context_resume(Context *ctx, Node *program, const uint32_t *position, int depth) {
+    jmp_buf recover;
+    jmp_buf *previous = ctx->recover;
+
+    ctx->recover = &recover;
+    if (setjmp(recover)) {
+        budget_stop(ctx);
+        ctx->recover = previous;
+        return 1;
+    }
+
+    budget_start(ctx);
+    tier_free(ctx->tiers);
+    ctx->tiers = NULL;
+
+    resume_node(ctx, program, position, depth);
+    budget_stop(ctx);
+    ctx->recover = previous;
+    return 0;
+}
+
+int context_execute_compact(Context *ctx, const CompactAst *ast) {
+    jmp_buf recover;
+    jmp_buf *previous = ctx->recover;
+
+    ctx->recover = &recover;
+    if (setjmp(recover)) {
+        budget_stop(ctx);
+        ctx->recover = previous;
+        return 1;
+    }
+
+    budget_start(ctx);
+    execute_compact(ctx, ast, ast->root);
+    budget_stop(ctx);
+    ctx->recover = previous;
+    return 0;
+}
+
+void context_error(Context *ctx, const char *format, ...) {
+    va_list args;
+    va_start(args, format);
+    vsnprintf(ctx->error, sizeof(ctx->error), format, args);
+    va_end(args);
+    ctx->errors++;
+
+    if (ctx->recover) longjmp(*ctx->recover, 1);
+
+    fprintf(stderr, "%s\n", ctx->error);
+    exit(1);
+}
+
+void context_report(Context *ctx, FILE *out) {
+    ctx->stats.searches = ctx->variables->searches;
+    ctx->stats.search_steps = ctx->variables->search_steps;
+    stats_report(&ctx->stats, out);
+}
@@ -0,0 +1,150 @@
+#ifndef CONTEXT_H
+#define CONTEXT_H
+
+#include <stdio.h>
+#include <setjmp.h>
+#include "ast.h"
+#include "variables.h"
+#include "stats.h"
+#include "compact.h"
+#include "tier.h"
+#include "inputlog.h"
+#include "budget.h"
+#include "checkpoint.h"
+
+/**
+ * @struct Context
+ *
+ * @brief State of the compilation and execution of one program.
+ *
+ * Everything that used to be global (the symbol table, the parsed program, the counters and the error state) lives
+ * here, so several programs can be compiled and executed at the same time, each on its own thread with its own
+ * context. A context must not be shared between threads.
+ */
+struct Context {
+    List *variables;    // Symbol table.
+    Node *program;      // Program built by the parser (NULL until a successful parse).
+    Stats stats;        // Counters of the allocations, of the searches and of the time of each phase.
+    FILE *in;           // Read by LEIA and LEIALISTA (stdin by default).
+    FILE *out;          // Written by ESCREVA and ESCREVALISTA (stdout by default).
+    EvalResult *temps;  // Values of the temporaries created by the optimizer (NODE_TEMP), grown on demand.
+    int temp_count;
+    int errors;         // Number of errors.
+    char error[256];    // Message of the last error.
+    jmp_buf *recover;   // Where context_error() returns to (NULL: the message is printed and the process exits).
+    int fast_scanner;   // Parse with the hand-written scanner (scanner.c) instead of the one generated by flex.
+    int tier_threshold; // Iterations before a loop is specialized (0: tiered execution is disabled, see tier.h).
+    TierProfiles *tiers;
+    InputLog *input_log; // Records or replays the values read from ctx->in (NULL: they are only read).
+    int unroll_factor;  // Copies of the body of the loops unrolled by the optimizer (below 2: no unrolling).
+    Budget budget;      // Limits of the execution (see budget.h).
+    Checkpoint *checkpoint; // Saves snapshots of the run at the back edges of loops (NULL: disabled).
+    int streaming;      // The parser runs each top-level statement and frees it (see context_stream()).
+};
+
+/**
+ * @brief Creates an empty context.
+ *
+ * @return The context, or NULL if there is no memory.
+ */
+Context *context_create(void);
+
+/**
+ * @brief Frees the context, its program and its variables.
+ *
+ * @param ctx Context (can be NULL).
+ */
+void context_free(Context *ctx);
+
+/**
+ * @brief Parses a program, storing it in ctx->program.
+ *
+ * Uses a reentrant scanner and parser (implemented in bison.y), so it can be called by several threads at the same
+ * time with different contexts.
+ *
+ * @param ctx Context.
+ * @param in Source of the program.
+ *
+ * @return 0 on success, 1 on an error (the message is in ctx->error).
+ */
+int context_parse(Context *ctx, FILE *in);
+
+/**
+ * @brief Optimizes ctx->program (see optimize()), returning an error instead of exiting.
+ *
+ * The optimizer can only fail for lack of memory. The tree may then be half rewritten, so it is left allocated
+ * (ctx->program becomes NULL) rather than freed.
+ *
+ * @param ctx Context with a parsed program.
+ *
+ * @return 0 on success, 1 on an error (the message is in ctx->error).
+ */
+int context_optimize(Context *ctx);
+
+/**
+ * @brief Parses and runs a program at the same time, without keeping its tree.
+ *
+ * The declarations are run once all of them are parsed, and then each top-level statement of the algorithm as soon
+ * as it is parsed, after which it is freed. The memory is bounded by the largest statement rather than by the size
+ * of the program, and the output starts before the end of the source. Since the whole program is never known, it is
+ * not optimized; a syntax error stops the run after the statements before it (implemented in bison.y).
+ *
+ * @param ctx Context (ctx->program stays NULL).
+ * @param in Source of the program (not the input of the program, which is ctx->in).
+ *
+ * @return 0 on success, 1 on a syntax or runtime error (the message is in ctx->error).
+ */
+int context_stream(Context *ctx, FILE *in);
+
+/**
+ * @brief Executes a program, returning instead of exiting on a runtime error.
+ *
+ * @param ctx Context with the variables of the run (it does not need to be the one that parsed the program).
+ * @param program Program to be executed.
+ *
+ * @return 0 on success, 1 on a runtime error (the message is in ctx->error).
+ */
+int context_execute(Context *ctx, Node *program);
+
+/**
+ * @brief Same as context_execute(), for a program in the compact form (see compact.h).
+ *
+ * @param ctx Context with the variables of the run.
+ * @param ast Program to be executed.
+ *
+ * @return 0 on success, 1 on a runtime error (the message is in ctx->error).
+ */
+int context_execute_compact(Context *ctx, const CompactAst *ast);
+
+/**
+ * @brief Same as context_execute(), continuing the run from a snapshot restored by checkpoint_restore().
+ *
+ * @param ctx Context with the variables of the snapshot.
+ * @param program Program that saved the snapshot.
+ * @param position Path to the loop of the snapshot.
+ * @param depth Length of the path.
+ *
+ * @return 0 on success, 1 on a runtime error (the message is in ctx->error).
+ */
+int context_resume(Context *ctx, Node *program, const uint32_t *position, int depth);
+
+/**
+ * @brief Reports an error of the compilation or of the execution.
+ *
+ * The message is saved in ctx->error and the control goes back to context_parse() or context_execute(). Outside of
+ * them, the message is printed to stderr and the process exits.
+ *
+ * @param ctx Context.
+ * @param format Format of the message (as in printf()).
+ */
+void context_error(Context *ctx, const char *format, ...) __attribute__((noreturn, format(printf, 2, 3)));
+
+/**
+ * @brief Prints the counters of the context (see stats_report()).
+ *
+ * @param ctx Context.
+ * @param out Where the report is written.
+ */
+void context_report(Context *ctx, FILE *out);
+
+#endif // CONTEXT_H
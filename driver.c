@@ -0,0 +1,258 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <setjmp.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <sys/stat.h>
+#include "driver.h"
+#include "context.h"
+#include "compact.h"
+#include "stats.h"
+
+/**
+ * @struct BatchFile
+ *
+ * @brief A program of the batch and the result of its compilation.
+ */
+typedef struct BatchFile {
+    char *path;
+    int done;               // Set by the worker, under the lock of the batch.
+    int failed;
+    char error[256];
+    double parse;           // Seconds of CPU, lexing included.
+    double optimize;        // Seconds of CPU, building the compact AST included.
+} BatchFile;
+
+/**
+ * @struct Batch
+ *
+ * @brief Programs of a batch, shared by the workers.
+ *
+ * The workers take the programs in order from an atomic index, so a slow program does not hold back the others; the
+ * main thread waits for each one in turn to print its errors in the order of the paths.
+ */
+typedef struct Batch {
+    BatchFile *files;
+    int count;
+    int capacity;
+    atomic_int next;
+    const DriverOptions *options;
+    pthread_mutex_t lock;
+    pthread_cond_t done;
+} Batch;
+
+/**
+ * @brief Appends a program to the batch.
+ *
+ * @return 1 if OK, 0 if there is no memory.
+ */
+static int add_file(Batch *b, const char *path) {
+    if (b->count == b->capacity) {
+        int capacity = b->capacity ? b->capacity * 2 : 64;
+        BatchFile *files = (BatchFile *)realloc(b->files, capacity * sizeof(BatchFile));
+        if (!files) return 0;
+        b->files = files;
+        b->capacity = capacity;
+    }
+
+    BatchFile *f = &b->files[b->count];
+    memset(f, 0, sizeof(BatchFile));
+    f->path = strdup(path);
+    if (!f->path) return 0;
+    b->count++;
+    return 1;
+}
+
+/* CPU time of the calling thread, so the timings do not count the other workers. */
+static double cpu_clock(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static int visible(const struct dirent *entry) {
+    return entry->d_name[0] != '.';
+}
+
+/**
+ * @brief Appends the regular files under a directory, in the order of their names.
+ *
+ * Links to directories are not followed, so a link cannot make a cycle.
+ *
+ * @return 1 if OK, 0 on an error (errno is set).
+ */
+static int add_directory(Batch *b, const char *dir) {
+    struct dirent **entries;
+    int n = scandir(dir, &entries, visible, alphasort);
+    if (n < 0) return 0;
+
+    int ok = 1;
+    for (int i = 0; i < n; i++) {
+        char *path = NULL;
+        struct stat link, target;
+        if (ok && asprintf(&path, "%s/%s", dir, entries[i]->d_name) < 0) {
+            path = NULL;
+            ok = 0;
+        }
+
+        if (ok && lstat(path, &link) == 0 && stat(path, &target) == 0) {
+            if (S_ISREG(target.st_mode)) ok = add_file(b, path);
+            else if (S_ISDIR(link.st_mode)) ok = add_directory(b, path);
+        }
+
+        free(path);
+        free(entries[i]);
+    }
+    free(entries);
+    return ok;
+}
+
+/**
+ * @brief Parses and optimizes a program, saving the error and the timings in the file.
+ */
+static void compile_file(const DriverOptions *options, BatchFile *f) {
+    FILE *in = fopen(f->path, "r");
+    if (!in) {
+        char message[128];
+        snprintf(f->error, sizeof(f->error), "fopen() failed: %s", strerror_r(errno, message, sizeof(message)));
+        f->failed = 1;
+        return;
+    }
+
+    Context *ctx = context_create();
+    if (!ctx) {
+        fclose(in);
+        snprintf(f->error, sizeof(f->error), "context_create() failed: out of memory");
+        f->failed = 1;
+        return;
+    }
+    ctx->fast_scanner = options->fast_scanner;
+    ctx->unroll_factor = options->unroll_factor;
+
+    /*
+     * Only a lack of memory makes the optimizer or the compact AST fail, and it must not end the whole batch, so the
+     * three steps share a recovery point. A tree left half rewritten by the optimizer is not freed (see
+     * context_optimize()).
+     */
+    jmp_buf recover;
+    ctx->recover = &recover;
+    double start = cpu_clock();
+    volatile double parsed = start;
+    if (setjmp(recover)) {
+        f->failed = 1;
+    } else {
+        f->failed = context_parse(ctx, in);
+        parsed = cpu_clock();
+        if (!f->failed) f->failed = context_optimize(ctx);
+        if (!f->failed && options->compact_ast) {
+            CompactAst *compact = compact_from_tree(ctx, ctx->program);
+            if (!compact_matches(ctx, compact, ctx->program)) {
+                snprintf(ctx->error, sizeof(ctx->error), "the compact AST does not convert back to the same tree.");
+                f->failed = 1;
+            }
+            compact_free(compact);
+        }
+    }
+    ctx->recover = NULL;
+    f->parse = parsed - start;
+    f->optimize = cpu_clock() - parsed;
+    fclose(in);
+
+    if (f->failed) snprintf(f->error, sizeof(f->error), "%s", ctx->error);
+    context_free(ctx);
+}
+
+static void *worker(void *arg) {
+    Batch *b = (Batch *)arg;
+
+    int i;
+    while ((i = atomic_fetch_add(&b->next, 1)) < b->count) {
+        compile_file(b->options, &b->files[i]);
+
+        pthread_mutex_lock(&b->lock);
+        b->files[i].done = 1;
+        pthread_cond_broadcast(&b->done);
+        pthread_mutex_unlock(&b->lock);
+    }
+    return NULL;
+}
+
+int driver_run(char *const *paths, int count, const DriverOptions *options) {
+    double start = stats_clock();
+
+    Batch b;
+    memset(&b, 0, sizeof(Batch));
+    atomic_init(&b.next, 0);
+    b.options = options;
+
+    /* A path that is not a directory is compiled as is, so a missing file is reported as an error of the batch. */
+    int status = 0;
+    for (int i = 0; i < count && !status; i++) {
+        struct stat st;
+        int directory = stat(paths[i], &st) == 0 && S_ISDIR(st.st_mode);
+        int ok = directory ? add_directory(&b, paths[i]) : add_file(&b, paths[i]);
+        if (!ok) {
+            fprintf(stderr, "%s: %s\n", paths[i], strerror(errno));
+            status = 1;
+        }
+    }
+    if (!status && b.count == 0) {
+        fprintf(stderr, "No programs to compile.\n");
+        status = 1;
+    }
+
+    if (!status) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+        int jobs = options->jobs > 0 ? options->jobs : (cores > 0 ? (int)cores : 1);
+        if (jobs > b.count) jobs = b.count;
+
+        pthread_mutex_init(&b.lock, NULL);
+        pthread_cond_init(&b.done, NULL);
+
+        /* With no thread at all, the main thread compiles the programs itself before printing. */
+        pthread_t *threads = (pthread_t *)malloc(jobs * sizeof(pthread_t));
+        int started = 0;
+        while (threads && started < jobs && pthread_create(&threads[started], NULL, worker, &b) == 0) started++;
+        if (!started) worker(&b);
+
+        int failed = 0;
+        const BatchFile *slowest = NULL;
+        double parse = 0, optimize = 0;
+        for (int i = 0; i < b.count; i++) {
+            BatchFile *f = &b.files[i];
+            pthread_mutex_lock(&b.lock);
+            while (!f->done) pthread_cond_wait(&b.done, &b.lock);
+            pthread_mutex_unlock(&b.lock);
+
+            if (f->failed) {
+                fprintf(stderr, "%s: %s\n", f->path, f->error);
+                failed++;
+            }
+            parse += f->parse;
+            optimize += f->optimize;
+            if (!slowest || f->parse + f->optimize > slowest->parse + slowest->optimize) slowest = f;
+        }
+
+        for (int i = 0; i < started; i++) pthread_join(threads[i], NULL);
+        free(threads);
+        pthread_mutex_destroy(&b.lock);
+        pthread_cond_destroy(&b.done);
+
+        fprintf(stderr, "batch: %d programs, %d compiled, %d failed, %d threads, %.3f ms\n", b.count,
+            b.count - failed, failed, started ? started : 1, (stats_clock() - start) * 1e3);
+        fprintf(stderr, "batch: parse %.3f ms, optimize %.3f ms (CPU, summed over the programs)\n", parse * 1e3,
+            optimize * 1e3);
+        fprintf(stderr, "batch: slowest: %s (%.3f ms)\n", slowest->path, (slowest->parse + slowest->optimize) * 1e3);
+        status = failed != 0;
+    }
+
+    for (int i = 0; i < b.count; i++) free(b.files[i].path);
+    free(b.files);
+    return status;
+}
@@ -0,0 +1,33 @@
+#ifndef DRIVER_H
+#define DRIVER_H
+
+/**
+ * @struct DriverOptions
+ *
+ * @brief How the programs of a batch are compiled.
+ */
+typedef struct DriverOptions {
+    int jobs;           // Worker threads (0: one per online core).
+    int fast_scanner;   // Use the hand-written scanner (see Context).
+    int unroll_factor;  // Copies of the body of counted loops (see Context).
+    int compact_ast;    // Also build the compact AST of each program, and check that it converts back to the tree.
+} DriverOptions;
+
+/**
+ * @brief Compiles many programs in one process, on a pool of threads.
+ *
+ * Each program is parsed and optimized (and, with compact_ast, converted to the compact AST and back, which must give
+ * the same tree) in its own context, but not run. A directory stands for the regular files under it, recursively, in
+ * the order of their names; the names starting with a dot are skipped. The errors, those of the scanner included,
+ * are printed to stderr as "path: message", in the order of the paths (each one as soon as the programs before it are
+ * done), followed by a summary with the counts and the timings. The workers never write to stdout.
+ *
+ * @param paths Programs and directories.
+ * @param count Number of paths.
+ * @param options Options.
+ *
+ * @return 0 if every program compiled, 1 otherwise.
+ */
+int driver_run(char *const *paths, int count, const DriverOptions *options);
+
+#endif // DRIVER_H
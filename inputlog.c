@@ -0,0 +1,221 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "inputlog.h"
+#include "context.h"
+
+#define HEADER_SIZE 16
+
+struct InputLog {
+    FILE *file;                 // File being recorded (NULL when replaying).
+    unsigned char *data;        // Whole file being replayed.
+    size_t size;
+    size_t position;
+};
+
+/* Values are always little-endian in the file. */
+
+static void put_u32(unsigned char *p, uint32_t x) {
+    for (int i = 0; i < 4; i++) p[i] = (unsigned char)(x >> (8 * i));
+}
+
+static void put_u64(unsigned char *p, uint64_t x) {
+    for (int i = 0; i < 8; i++) p[i] = (unsigned char)(x >> (8 * i));
+}
+
+static uint32_t get_u32(const unsigned char *p) {
+    uint32_t x = 0;
+    for (int i = 0; i < 4; i++) x |= (uint32_t)p[i] << (8 * i);
+    return x;
+}
+
+static uint64_t get_u64(const unsigned char *p) {
+    uint64_t x = 0;
+    for (int i = 0; i < 8; i++) x |= (uint64_t)p[i] << (8 * i);
+    return x;
+}
+
+static void put_real(unsigned char *p, double d) {
+    uint64_t x;
+    memcpy(&x, &d, sizeof(x));
+    put_u64(p, x);
+}
+
+static double get_real(const unsigned char *p) {
+    uint64_t x = get_u64(p);
+    double d;
+    memcpy(&d, &x, sizeof(d));
+    return d;
+}
+
+InputLog *input_log_record(const char *path, uint64_t program_hash) {
+    InputLog *log = (InputLog *)calloc(1, sizeof(InputLog));
+    if (!log) return NULL;
+
+    log->file = fopen(path, "wb");
+    if (!log->file) {
+        free(log);
+        return NULL;
+    }
+
+    unsigned char header[HEADER_SIZE];
+    memcpy(header, INPUT_LOG_MAGIC, 8);
+    put_u64(header + 8, program_hash);
+    fwrite(header, 1, sizeof(header), log->file);
+    return log;
+}
+
+InputLog *input_log_replay(const char *path, uint64_t program_hash, char *error, size_t size) {
+    FILE *f = fopen(path, "rb");
+    if (!f) {
+        snprintf(error, size, "fopen() failed: %s", strerror(errno));
+        return NULL;
+    }
+
+    InputLog *log = (InputLog *)calloc(1, sizeof(InputLog));
+    size_t capacity = 65536;
+    if (log) log->data = (unsigned char *)malloc(capacity);
+    if (!log || !log->data) {
+        snprintf(error, size, "malloc() failed: %s", strerror(errno));
+        fclose(f);
+        input_log_close(log);
+        return NULL;
+    }
+
+    size_t n;
+    while ((n = fread(log->data + log->size, 1, capacity - log->size, f)) > 0) {
+        log->size += n;
+        if (log->size < capacity) continue;
+
+        unsigned char *data = (unsigned char *)realloc(log->data, capacity * 2);
+        if (!data) {
+            snprintf(error, size, "realloc() failed: %s", strerror(errno));
+            fclose(f);
+            input_log_close(log);
+            return NULL;
+        }
+        log->data = data;
+        capacity *= 2;
+    }
+
+    int failed = ferror(f);
+    fclose(f);
+    if (failed) {
+        snprintf(error, size, "fread() failed: %s", path);
+        input_log_close(log);
+        return NULL;
+    }
+
+    if (log->size < HEADER_SIZE || memcmp(log->data, INPUT_LOG_MAGIC, 8) != 0) {
+        snprintf(error, size, "'%s' is not an input log.", path);
+        input_log_close(log);
+        return NULL;
+    }
+    if (get_u64(log->data + 8) != program_hash) {
+        snprintf(error, size, "'%s' was recorded by a different program.", path);
+        input_log_close(log);
+        return NULL;
+    }
+
+    log->position = HEADER_SIZE;
+    return log;
+}
+
+int input_log_replaying(const InputLog *log) {
+    return log->file == NULL;
+}
+
+/**
+ * @brief Returns the next record of the log, checking its tag and its size.
+ *
+ * @param width Bytes of the record after the tag.
+ */
+static const unsigned char *next_record(Context *ctx, InputLog *log, char tag, size_t width) {
+    if (log->position >= log->size) {
+        context_error(ctx, "replay: the input log has no more values.");
+    }
+    if (log->data[log->position] != (unsigned char)tag) {
+        context_error(ctx, "replay: the input log does not match the reads of the program.");
+    }
+    if (log->size - log->position - 1 < width) {
+        context_error(ctx, "replay: the input log is truncated.");
+    }
+
+    const unsigned char *p = log->data + log->position + 1;
+    log->position += 1 + width;
+    return p;
+}
+
+void input_log_next(Context *ctx, InputLog *log, EvalResult *val) {
+    if (val->type == T_INTEIRO) {
+        val->v.i = (int)get_u32(next_record(ctx, log, 'i', 4));
+    } else {
+        val->v.d = get_real(next_record(ctx, log, 'r', 8));
+    }
+}
+
+void input_log_next_list(Context *ctx, InputLog *log, Variable *v, int start, int end) {
+    int ints = v->type == T_LISTAINT;
+    size_t width = ints ? 4 : 8;
+
+    const unsigned char *p = next_record(ctx, log, ints ? 'I' : 'R', 4);
+    if (get_u32(p) != (uint32_t)(end - start)) {
+        context_error(ctx, "replay: the input log does not match the reads of the program.");
+    }
+    if (log->size - log->position < (size_t)(end - start) * width) {
+        context_error(ctx, "replay: the input log is truncated.");
+    }
+
+    p = log->data + log->position;
+    for (int i = start; i < end; i++, p += width) {
+        if (ints) ((int *)v->data)[i] = (int)get_u32(p);
+        else ((double *)v->data)[i] = get_real(p);
+    }
+    log->position += (size_t)(end - start) * width;
+}
+
+void input_log_save(InputLog *log, const EvalResult *val) {
+    unsigned char record[9];
+    if (val->type == T_INTEIRO) {
+        record[0] = 'i';
+        put_u32(record + 1, (uint32_t)val->v.i);
+        fwrite(record, 1, 5, log->file);
+    } else {
+        record[0] = 'r';
+        put_real(record + 1, val->v.d);
+        fwrite(record, 1, 9, log->file);
+    }
+}
+
+void input_log_save_list(InputLog *log, const Variable *v, int start, int end) {
+    int ints = v->type == T_LISTAINT;
+    unsigned char record[8];
+
+    record[0] = ints ? 'I' : 'R';
+    put_u32(record + 1, (uint32_t)(end - start));
+    fwrite(record, 1, 5, log->file);
+
+    for (int i = start; i < end; i++) {
+        if (ints) {
+            put_u32(record, (uint32_t)((int *)v->data)[i]);
+            fwrite(record, 1, 4, log->file);
+        } else {
+            put_real(record, ((double *)v->data)[i]);
+            fwrite(record, 1, 8, log->file);
+        }
+    }
+}
+
+int input_log_close(InputLog *log) {
+    if (!log) return 1;
+
+    int ok = 1;
+    if (log->file) {
+        ok = !ferror(log->file);
+        if (fclose(log->file) != 0) ok = 0;
+    }
+    free(log->data);
+    free(log);
+    return ok;
+}
@@ -0,0 +1,97 @@
+#ifndef INPUTLOG_H
+#define INPUTLOG_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "ast.h"
+
+#define INPUT_LOG_MAGIC "SCINPUT1"
+
+/**
+ * @struct InputLog
+ *
+ * @brief Values read by a run (LEIA, and LEIALISTA without a file), recorded to a file or replayed from it.
+ *
+ * The file starts with INPUT_LOG_MAGIC and the hash of the program (hash_node()), followed by one record per read:
+ * a tag ('i' or 'r' for a value of LEIA, 'I' or 'R' for a list) and the values, little-endian (32-bit integers and
+ * IEEE-754 doubles). Lists have the number of values, as a 32-bit integer, before them.
+ */
+typedef struct InputLog InputLog;
+
+/**
+ * @brief Creates a log that records the values read by a run.
+ *
+ * @param path File of the log (overwritten).
+ * @param program_hash Hash of the program.
+ *
+ * @return The log, or NULL if the file could not be created (errno is set).
+ */
+InputLog *input_log_record(const char *path, uint64_t program_hash);
+
+/**
+ * @brief Loads a recorded log, to replay it.
+ *
+ * The whole file is read to memory, so replaying a value does not parse or read anything.
+ *
+ * @param path File of the log.
+ * @param program_hash Hash of the program, which must be the one that recorded the log.
+ * @param error Receives the message if it fails.
+ * @param size Size of error.
+ *
+ * @return The log, or NULL on an error.
+ */
+InputLog *input_log_replay(const char *path, uint64_t program_hash, char *error, size_t size);
+
+/**
+ * @brief Returns 1 if the log is being replayed, 0 if it is being recorded.
+ */
+int input_log_replaying(const InputLog *log);
+
+/**
+ * @brief Replays the next value of LEIA.
+ *
+ * @param ctx Context (errors are reported with context_error()).
+ * @param log Log being replayed.
+ * @param val Receives the value; its type must already be set, and must be the recorded one.
+ */
+void input_log_next(Context *ctx, InputLog *log, EvalResult *val);
+
+/**
+ * @brief Replays the next list of LEIALISTA, storing it in the elements [start, end) of a list.
+ *
+ * @param ctx Context (errors are reported with context_error()).
+ * @param log Log being replayed.
+ * @param v List, with data already allocated.
+ * @param start First index.
+ * @param end Index after the last one.
+ */
+void input_log_next_list(Context *ctx, InputLog *log, Variable *v, int start, int end);
+
+/**
+ * @brief Records a value read by LEIA.
+ *
+ * @param log Log being recorded.
+ * @param val Value.
+ */
+void input_log_save(InputLog *log, const EvalResult *val);
+
+/**
+ * @brief Records the elements [start, end) of a list read by LEIALISTA.
+ *
+ * @param log Log being recorded.
+ * @param v List.
+ * @param start First index.
+ * @param end Index after the last one.
+ */
+void input_log_save_list(InputLog *log, const Variable *v, int start, int end);
+
+/**
+ * @brief Closes the log, and frees it.
+ *
+ * @param log Log (can be NULL).
+ *
+ * @return 1 if OK, 0 if writing the recorded log failed.
+ */
+int input_log_close(InputLog *log);
+
+#endif // INPUTLOG_H
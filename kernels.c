@@ -0,0 +1,612 @@
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include "kernels.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define KERNELS_X86
+#endif
+
+/**
+ * @brief Combines the 8 lanes of a real sum and adds the remaining elements, in the documented order.
+ */
+static double combine_lanes(const double l[8], const double *tail, int count) {
+    double r = ((l[0] + l[4]) + (l[2] + l[6])) + ((l[1] + l[5]) + (l[3] + l[7]));
+    for (int i = 0; i < count; i++) r += tail[i];
+    return r;
+}
+
+static double combine_dot_lanes(const double l[8], const double *x, const double *y, int count) {
+    double r = ((l[0] + l[4]) + (l[2] + l[6])) + ((l[1] + l[5]) + (l[3] + l[7]));
+    for (int i = 0; i < count; i++) r += x[i] * y[i];
+    return r;
+}
+
+/* Scalar kernels. */
+
+static int sum_int_scalar(const int *x, int n) {
+    unsigned int r = 0;
+    for (int i = 0; i < n; i++) r += (unsigned int)x[i];
+    return (int)r;
+}
+
+static double sum_real_scalar(const double *x, int n) {
+    double l[8] = { 0.0 };
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (int j = 0; j < 8; j++) l[j] += x[i + j];
+    }
+    return combine_lanes(l, x + i, n - i);
+}
+
+static int dot_int_scalar(const int *x, const int *y, int n) {
+    unsigned int r = 0;
+    for (int i = 0; i < n; i++) r += (unsigned int)x[i] * (unsigned int)y[i];
+    return (int)r;
+}
+
+static double dot_real_scalar(const double *x, const double *y, int n) {
+    double l[8] = { 0.0 };
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        for (int j = 0; j < 8; j++) l[j] += x[i + j] * y[i + j];
+    }
+    return combine_dot_lanes(l, x + i, y + i, n - i);
+}
+
+static int min_int_scalar(const int *x, int n) {
+    int r = x[0];
+    for (int i = 1; i < n; i++) r = x[i] < r ? x[i] : r;
+    return r;
+}
+
+static int max_int_scalar(const int *x, int n) {
+    int r = x[0];
+    for (int i = 1; i < n; i++) r = x[i] > r ? x[i] : r;
+    return r;
+}
+
+static double min_real_scalar(const double *x, int n) {
+    double r = x[0];
+    for (int i = 1; i < n; i++) r = x[i] < r ? x[i] : r;
+    return r;
+}
+
+static double max_real_scalar(const double *x, int n) {
+    double r = x[0];
+    for (int i = 1; i < n; i++) r = x[i] > r ? x[i] : r;
+    return r;
+}
+
+/*
+ * -0.0 and +0.0 compare equal, so the scalar functions return the first zero of the list when the result is a zero.
+ * The vector ones combine lanes in another order, so they look for that first zero afterwards (only when the result
+ * is a zero, which is rare in a long list or found at its start).
+ */
+static double first_zero(const double *x, int n, double r) {
+    if (r != 0.0) return r;
+    for (int i = 0; i < n; i++) {
+        if (x[i] == 0.0) return x[i];
+    }
+    return r;
+}
+
+static void fill_int_scalar(int *x, int n, int value) {
+    for (int i = 0; i < n; i++) x[i] = value;
+}
+
+static void fill_real_scalar(double *x, int n, double value) {
+    for (int i = 0; i < n; i++) x[i] = value;
+}
+
+static void scale_int_scalar(int *x, int n, int factor) {
+    for (int i = 0; i < n; i++) x[i] = (int)((unsigned int)x[i] * (unsigned int)factor);
+}
+
+static void scale_real_scalar(double *x, int n, double factor) {
+    for (int i = 0; i < n; i++) x[i] *= factor;
+}
+
+static const Kernels scalar_kernels = {
+    "scalar",
+    sum_int_scalar, sum_real_scalar, dot_int_scalar, dot_real_scalar,
+    min_int_scalar, max_int_scalar, min_real_scalar, max_real_scalar,
+    fill_int_scalar, fill_real_scalar, scale_int_scalar, scale_real_scalar,
+};
+
+#ifdef KERNELS_X86
+
+/* SSE2 kernels (2 doubles or 4 ints per register). */
+
+__attribute__((target("sse2")))
+static int sum_int_sse2(const int *x, int n) {
+    __m128i acc = _mm_setzero_si128();
+    int i = 0;
+    for (; i + 4 <= n; i += 4) acc = _mm_add_epi32(acc, _mm_loadu_si128((const __m128i *)(x + i)));
+
+    int l[4];
+    _mm_storeu_si128((__m128i *)l, acc);
+    unsigned int r = (unsigned int)l[0] + (unsigned int)l[1] + (unsigned int)l[2] + (unsigned int)l[3];
+    return (int)(r + (unsigned int)sum_int_scalar(x + i, n - i));
+}
+
+__attribute__((target("sse2")))
+static double sum_real_sse2(const double *x, int n) {
+    __m128d r0 = _mm_setzero_pd(), r1 = _mm_setzero_pd(), r2 = _mm_setzero_pd(), r3 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        r0 = _mm_add_pd(r0, _mm_loadu_pd(x + i));
+        r1 = _mm_add_pd(r1, _mm_loadu_pd(x + i + 2));
+        r2 = _mm_add_pd(r2, _mm_loadu_pd(x + i + 4));
+        r3 = _mm_add_pd(r3, _mm_loadu_pd(x + i + 6));
+    }
+
+    double l[8];
+    _mm_storeu_pd(l, r0);
+    _mm_storeu_pd(l + 2, r1);
+    _mm_storeu_pd(l + 4, r2);
+    _mm_storeu_pd(l + 6, r3);
+    return combine_lanes(l, x + i, n - i);
+}
+
+__attribute__((target("sse2")))
+static double dot_real_sse2(const double *x, const double *y, int n) {
+    __m128d r0 = _mm_setzero_pd(), r1 = _mm_setzero_pd(), r2 = _mm_setzero_pd(), r3 = _mm_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        r0 = _mm_add_pd(r0, _mm_mul_pd(_mm_loadu_pd(x + i), _mm_loadu_pd(y + i)));
+        r1 = _mm_add_pd(r1, _mm_mul_pd(_mm_loadu_pd(x + i + 2), _mm_loadu_pd(y + i + 2)));
+        r2 = _mm_add_pd(r2, _mm_mul_pd(_mm_loadu_pd(x + i + 4), _mm_loadu_pd(y + i + 4)));
+        r3 = _mm_add_pd(r3, _mm_mul_pd(_mm_loadu_pd(x + i + 6), _mm_loadu_pd(y + i + 6)));
+    }
+
+    double l[8];
+    _mm_storeu_pd(l, r0);
+    _mm_storeu_pd(l + 2, r1);
+    _mm_storeu_pd(l + 4, r2);
+    _mm_storeu_pd(l + 6, r3);
+    return combine_dot_lanes(l, x + i, y + i, n - i);
+}
+
+/* SSE2 has no min/max for 32-bit integers, so they are selected with a comparison mask. */
+
+__attribute__((target("sse2")))
+static int min_int_sse2(const int *x, int n) {
+    if (n < 4) return min_int_scalar(x, n);
+
+    __m128i acc = _mm_loadu_si128((const __m128i *)x);
+    int i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i lower = _mm_cmplt_epi32(v, acc);
+        acc = _mm_or_si128(_mm_and_si128(lower, v), _mm_andnot_si128(lower, acc));
+    }
+
+    int l[4];
+    _mm_storeu_si128((__m128i *)l, acc);
+    int r = min_int_scalar(l, 4);
+    if (i < n) {
+        int t = min_int_scalar(x + i, n - i);
+        r = t < r ? t : r;
+    }
+    return r;
+}
+
+__attribute__((target("sse2")))
+static int max_int_sse2(const int *x, int n) {
+    if (n < 4) return max_int_scalar(x, n);
+
+    __m128i acc = _mm_loadu_si128((const __m128i *)x);
+    int i = 4;
+    for (; i + 4 <= n; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(x + i));
+        __m128i greater = _mm_cmpgt_epi32(v, acc);
+        acc = _mm_or_si128(_mm_and_si128(greater, v), _mm_andnot_si128(greater, acc));
+    }
+
+    int l[4];
+    _mm_storeu_si128((__m128i *)l, acc);
+    int r = max_int_scalar(l, 4);
+    if (i < n) {
+        int t = max_int_scalar(x + i, n - i);
+        r = t > r ? t : r;
+    }
+    return r;
+}
+
+__attribute__((target("sse2")))
+static double min_real_sse2(const double *x, int n) {
+    if (n < 2) return min_real_scalar(x, n);
+
+    __m128d acc = _mm_loadu_pd(x);
+    int i = 2;
+    for (; i + 2 <= n; i += 2) acc = _mm_min_pd(_mm_loadu_pd(x + i), acc);
+
+    double l[3];
+    _mm_storeu_pd(l, acc);
+    l[2] = (i < n) ? x[i] : l[0];
+    return first_zero(x, n, min_real_scalar(l, 3));
+}
+
+__attribute__((target("sse2")))
+static double max_real_sse2(const double *x, int n) {
+    if (n < 2) return max_real_scalar(x, n);
+
+    __m128d acc = _mm_loadu_pd(x);
+    int i = 2;
+    for (; i + 2 <= n; i += 2) acc = _mm_max_pd(_mm_loadu_pd(x + i), acc);
+
+    double l[3];
+    _mm_storeu_pd(l, acc);
+    l[2] = (i < n) ? x[i] : l[0];
+    return first_zero(x, n, max_real_scalar(l, 3));
+}
+
+__attribute__((target("sse2")))
+static void fill_int_sse2(int *x, int n, int value) {
+    __m128i v = _mm_set1_epi32(value);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) _mm_storeu_si128((__m128i *)(x + i), v);
+    fill_int_scalar(x + i, n - i, value);
+}
+
+__attribute__((target("sse2")))
+static void fill_real_sse2(double *x, int n, double value) {
+    __m128d v = _mm_set1_pd(value);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(x + i, v);
+    fill_real_scalar(x + i, n - i, value);
+}
+
+__attribute__((target("sse2")))
+static void scale_real_sse2(double *x, int n, double factor) {
+    __m128d f = _mm_set1_pd(factor);
+    int i = 0;
+    for (; i + 2 <= n; i += 2) _mm_storeu_pd(x + i, _mm_mul_pd(_mm_loadu_pd(x + i), f));
+    scale_real_scalar(x + i, n - i, factor);
+}
+
+/* SSE2 has no 32-bit multiplication, so dot_int and scale_int use the scalar kernels. */
+static const Kernels sse2_kernels = {
+    "sse2",
+    sum_int_sse2, sum_real_sse2, dot_int_scalar, dot_real_sse2,
+    min_int_sse2, max_int_sse2, min_real_sse2, max_real_sse2,
+    fill_int_sse2, fill_real_sse2, scale_int_scalar, scale_real_sse2,
+};
+
+/* AVX2 kernels (4 doubles or 8 ints per register). */
+
+__attribute__((target("avx2")))
+static int reduce_add_epi32_avx2(__m256i v) {
+    int l[8];
+    _mm256_storeu_si256((__m256i *)l, v);
+    return sum_int_scalar(l, 8);
+}
+
+__attribute__((target("avx2")))
+static int sum_int_avx2(const int *x, int n) {
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) acc = _mm256_add_epi32(acc, _mm256_loadu_si256((const __m256i *)(x + i)));
+    return (int)((unsigned int)reduce_add_epi32_avx2(acc) + (unsigned int)sum_int_scalar(x + i, n - i));
+}
+
+__attribute__((target("avx2")))
+static double sum_real_avx2(const double *x, int n) {
+    __m256d r0 = _mm256_setzero_pd(), r1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        r0 = _mm256_add_pd(r0, _mm256_loadu_pd(x + i));
+        r1 = _mm256_add_pd(r1, _mm256_loadu_pd(x + i + 4));
+    }
+
+    double l[8];
+    _mm256_storeu_pd(l, r0);
+    _mm256_storeu_pd(l + 4, r1);
+    return combine_lanes(l, x + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int dot_int_avx2(const int *x, const int *y, int n) {
+    __m256i acc = _mm256_setzero_si256();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i p = _mm256_mullo_epi32(_mm256_loadu_si256((const __m256i *)(x + i)),
+                                       _mm256_loadu_si256((const __m256i *)(y + i)));
+        acc = _mm256_add_epi32(acc, p);
+    }
+    return (int)((unsigned int)reduce_add_epi32_avx2(acc) + (unsigned int)dot_int_scalar(x + i, y + i, n - i));
+}
+
+__attribute__((target("avx2")))
+static double dot_real_avx2(const double *x, const double *y, int n) {
+    __m256d r0 = _mm256_setzero_pd(), r1 = _mm256_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        r0 = _mm256_add_pd(r0, _mm256_mul_pd(_mm256_loadu_pd(x + i), _mm256_loadu_pd(y + i)));
+        r1 = _mm256_add_pd(r1, _mm256_mul_pd(_mm256_loadu_pd(x + i + 4), _mm256_loadu_pd(y + i + 4)));
+    }
+
+    double l[8];
+    _mm256_storeu_pd(l, r0);
+    _mm256_storeu_pd(l + 4, r1);
+    return combine_dot_lanes(l, x + i, y + i, n - i);
+}
+
+__attribute__((target("avx2")))
+static int min_int_avx2(const int *x, int n) {
+    if (n < 8) return min_int_scalar(x, n);
+
+    __m256i acc = _mm256_loadu_si256((const __m256i *)x);
+    int i = 8;
+    for (; i + 8 <= n; i += 8) acc = _mm256_min_epi32(acc, _mm256_loadu_si256((const __m256i *)(x + i)));
+
+    int l[9];
+    _mm256_storeu_si256((__m256i *)l, acc);
+    l[8] = (i < n) ? min_int_scalar(x + i, n - i) : l[0];
+    return min_int_scalar(l, 9);
+}
+
+__attribute__((target("avx2")))
+static int max_int_avx2(const int *x, int n) {
+    if (n < 8) return max_int_scalar(x, n);
+
+    __m256i acc = _mm256_loadu_si256((const __m256i *)x);
+    int i = 8;
+    for (; i + 8 <= n; i += 8) acc = _mm256_max_epi32(acc, _mm256_loadu_si256((const __m256i *)(x + i)));
+
+    int l[9];
+    _mm256_storeu_si256((__m256i *)l, acc);
+    l[8] = (i < n) ? max_int_scalar(x + i, n - i) : l[0];
+    return max_int_scalar(l, 9);
+}
+
+__attribute__((target("avx2")))
+static double min_real_avx2(const double *x, int n) {
+    if (n < 4) return min_real_scalar(x, n);
+
+    __m256d acc = _mm256_loadu_pd(x);
+    int i = 4;
+    for (; i + 4 <= n; i += 4) acc = _mm256_min_pd(_mm256_loadu_pd(x + i), acc);
+
+    double l[5];
+    _mm256_storeu_pd(l, acc);
+    l[4] = (i < n) ? min_real_scalar(x + i, n - i) : l[0];
+    return first_zero(x, n, min_real_scalar(l, 5));
+}
+
+__attribute__((target("avx2")))
+static double max_real_avx2(const double *x, int n) {
+    if (n < 4) return max_real_scalar(x, n);
+
+    __m256d acc = _mm256_loadu_pd(x);
+    int i = 4;
+    for (; i + 4 <= n; i += 4) acc = _mm256_max_pd(_mm256_loadu_pd(x + i), acc);
+
+    double l[5];
+    _mm256_storeu_pd(l, acc);
+    l[4] = (i < n) ? max_real_scalar(x + i, n - i) : l[0];
+    return first_zero(x, n, max_real_scalar(l, 5));
+}
+
+__attribute__((target("avx2")))
+static void fill_int_avx2(int *x, int n, int value) {
+    __m256i v = _mm256_set1_epi32(value);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) _mm256_storeu_si256((__m256i *)(x + i), v);
+    fill_int_scalar(x + i, n - i, value);
+}
+
+__attribute__((target("avx2")))
+static void fill_real_avx2(double *x, int n, double value) {
+    __m256d v = _mm256_set1_pd(value);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(x + i, v);
+    fill_real_scalar(x + i, n - i, value);
+}
+
+__attribute__((target("avx2")))
+static void scale_int_avx2(int *x, int n, int factor) {
+    __m256i f = _mm256_set1_epi32(factor);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(x + i));
+        _mm256_storeu_si256((__m256i *)(x + i), _mm256_mullo_epi32(v, f));
+    }
+    scale_int_scalar(x + i, n - i, factor);
+}
+
+__attribute__((target("avx2")))
+static void scale_real_avx2(double *x, int n, double factor) {
+    __m256d f = _mm256_set1_pd(factor);
+    int i = 0;
+    for (; i + 4 <= n; i += 4) _mm256_storeu_pd(x + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), f));
+    scale_real_scalar(x + i, n - i, factor);
+}
+
+static const Kernels avx2_kernels = {
+    "avx2",
+    sum_int_avx2, sum_real_avx2, dot_int_avx2, dot_real_avx2,
+    min_int_avx2, max_int_avx2, min_real_avx2, max_real_avx2,
+    fill_int_avx2, fill_real_avx2, scale_int_avx2, scale_real_avx2,
+};
+
+/* AVX-512 kernels (8 doubles or 16 ints per register). */
+
+__attribute__((target("avx512f")))
+static int sum_int_avx512(const int *x, int n) {
+    __m512i acc = _mm512_setzero_si512();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) acc = _mm512_add_epi32(acc, _mm512_loadu_si512((const void *)(x + i)));
+    return (int)((unsigned int)_mm512_reduce_add_epi32(acc) + (unsigned int)sum_int_scalar(x + i, n - i));
+}
+
+__attribute__((target("avx512f")))
+static double sum_real_avx512(const double *x, int n) {
+    __m512d acc = _mm512_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) acc = _mm512_add_pd(acc, _mm512_loadu_pd(x + i));
+
+    double l[8];
+    _mm512_storeu_pd(l, acc);
+    return combine_lanes(l, x + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static int dot_int_avx512(const int *x, const int *y, int n) {
+    __m512i acc = _mm512_setzero_si512();
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i p = _mm512_mullo_epi32(_mm512_loadu_si512((const void *)(x + i)),
+                                       _mm512_loadu_si512((const void *)(y + i)));
+        acc = _mm512_add_epi32(acc, p);
+    }
+    return (int)((unsigned int)_mm512_reduce_add_epi32(acc) + (unsigned int)dot_int_scalar(x + i, y + i, n - i));
+}
+
+__attribute__((target("avx512f")))
+static double dot_real_avx512(const double *x, const double *y, int n) {
+    __m512d acc = _mm512_setzero_pd();
+    int i = 0;
+    for (; i + 8 <= n; i += 8) acc = _mm512_add_pd(acc, _mm512_mul_pd(_mm512_loadu_pd(x + i), _mm512_loadu_pd(y + i)));
+
+    double l[8];
+    _mm512_storeu_pd(l, acc);
+    return combine_dot_lanes(l, x + i, y + i, n - i);
+}
+
+__attribute__((target("avx512f")))
+static int min_int_avx512(const int *x, int n) {
+    if (n < 16) return min_int_avx2(x, n);
+
+    __m512i acc = _mm512_loadu_si512((const void *)x);
+    int i = 16;
+    for (; i + 16 <= n; i += 16) acc = _mm512_min_epi32(acc, _mm512_loadu_si512((const void *)(x + i)));
+
+    int r = _mm512_reduce_min_epi32(acc);
+    if (i < n) {
+        int t = min_int_scalar(x + i, n - i);
+        r = t < r ? t : r;
+    }
+    return r;
+}
+
+__attribute__((target("avx512f")))
+static int max_int_avx512(const int *x, int n) {
+    if (n < 16) return max_int_avx2(x, n);
+
+    __m512i acc = _mm512_loadu_si512((const void *)x);
+    int i = 16;
+    for (; i + 16 <= n; i += 16) acc = _mm512_max_epi32(acc, _mm512_loadu_si512((const void *)(x + i)));
+
+    int r = _mm512_reduce_max_epi32(acc);
+    if (i < n) {
+        int t = max_int_scalar(x + i, n - i);
+        r = t > r ? t : r;
+    }
+    return r;
+}
+
+__attribute__((target("avx512f")))
+static double min_real_avx512(const double *x, int n) {
+    if (n < 8) return min_real_avx2(x, n);
+
+    __m512d acc = _mm512_loadu_pd(x);
+    int i = 8;
+    for (; i + 8 <= n; i += 8) acc = _mm512_min_pd(_mm512_loadu_pd(x + i), acc);
+
+    double l[9];
+    _mm512_storeu_pd(l, acc);
+    l[8] = (i < n) ? min_real_scalar(x + i, n - i) : l[0];
+    return first_zero(x, n, min_real_scalar(l, 9));
+}
+
+__attribute__((target("avx512f")))
+static double max_real_avx512(const double *x, int n) {
+    if (n < 8) return max_real_avx2(x, n);
+
+    __m512d acc = _mm512_loadu_pd(x);
+    int i = 8;
+    for (; i + 8 <= n; i += 8) acc = _mm512_max_pd(_mm512_loadu_pd(x + i), acc);
+
+    double l[9];
+    _mm512_storeu_pd(l, acc);
+    l[8] = (i < n) ? max_real_scalar(x + i, n - i) : l[0];
+    return first_zero(x, n, max_real_scalar(l, 9));
+}
+
+__attribute__((target("avx512f")))
+static void fill_int_avx512(int *x, int n, int value) {
+    __m512i v = _mm512_set1_epi32(value);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) _mm512_storeu_si512((void *)(x + i), v);
+    fill_int_scalar(x + i, n - i, value);
+}
+
+__attribute__((target("avx512f")))
+static void fill_real_avx512(double *x, int n, double value) {
+    __m512d v = _mm512_set1_pd(value);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) _mm512_storeu_pd(x + i, v);
+    fill_real_scalar(x + i, n - i, value);
+}
+
+__attribute__((target("avx512f")))
+static void scale_int_avx512(int *x, int n, int factor) {
+    __m512i f = _mm512_set1_epi32(factor);
+    int i = 0;
+    for (; i + 16 <= n; i += 16) {
+        __m512i v = _mm512_loadu_si512((const void *)(x + i));
+        _mm512_storeu_si512((void *)(x + i), _mm512_mullo_epi32(v, f));
+    }
+    scale_int_scalar(x + i, n - i, factor);
+}
+
+__attribute__((target("avx512f")))
+static void scale_real_avx512(double *x, int n, double factor) {
+    __m512d f = _mm512_set1_pd(factor);
+    int i = 0;
+    for (; i + 8 <= n; i += 8) _mm512_storeu_pd(x + i, _mm512_mul_pd(_mm512_loadu_pd(x + i), f));
+    scale_real_scalar(x + i, n - i, factor);
+}
+
+static const Kernels avx512_kernels = {
+    "avx512",
+    sum_int_avx512, sum_real_avx512, dot_int_avx512, dot_real_avx512,
+    min_int_avx512, max_int_avx512, min_real_avx512, max_real_avx512,
+    fill_int_avx512, fill_real_avx512, scale_int_avx512, scale_real_avx512,
+};
+
+#endif // KERNELS_X86
+
+static const Kernels *selected = NULL;
+static pthread_once_t selected_once = PTHREAD_ONCE_INIT;
+
+/* Called once, even when several threads execute programs at the same time. */
+static void select_kernels(void) {
+    const char *limit = getenv("SIMPLE_COMPILER_ISA");
+    selected = &scalar_kernels;
+
+    #ifdef KERNELS_X86
+        __builtin_cpu_init();
+        int allow_sse2 = !limit || strcmp(limit, "scalar") != 0;
+        int allow_avx2 = allow_sse2 && (!limit || strcmp(limit, "sse2") != 0);
+        int allow_avx512 = allow_avx2 && (!limit || strcmp(limit, "avx2") != 0);
+
+        if (allow_avx512 && __builtin_cpu_supports("avx512f")) {
+            selected = &avx512_kernels;
+        } else if (allow_avx2 && __builtin_cpu_supports("avx2")) {
+            selected = &avx2_kernels;
+        } else if (allow_sse2 && __builtin_cpu_supports("sse2")) {
+            selected = &sse2_kernels;
+        }
+    #else
+        (void)limit;
+    #endif
+}
+
+const Kernels *get_kernels(void) {
+    pthread_once(&selected_once, select_kernels);
+    return selected;
+}
@@ -0,0 +1,45 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+/**
+ * @struct Kernels
+ *
+ * @brief Vectorized implementations of the list intrinsics for one instruction set.
+ *
+ * All the real sums (including the dot product) use the same order regardless of the instruction set, so the
+ * results are the same on every machine: element i of the first n - n % 8 elements is added to lane i % 8, the lanes
+ * are combined as ((l0 + l4) + (l2 + l6)) + ((l1 + l5) + (l3 + l7)), and the remaining elements are added one by one.
+ * Products are never fused with the sums.
+ *
+ * Integer operations wrap around on overflow. The min and max functions need n >= 1 and do not support NaN. Among
+ * equal values the first occurrence wins, as in a scalar loop with a strict comparison, so when the result is a zero
+ * its sign is the one of the first zero of the list (-0.0 and +0.0 compare equal) on every instruction set.
+ */
+typedef struct Kernels {
+    const char *name;
+
+    int (*sum_int)(const int *x, int n);
+    double (*sum_real)(const double *x, int n);
+    int (*dot_int)(const int *x, const int *y, int n);
+    double (*dot_real)(const double *x, const double *y, int n);
+    int (*min_int)(const int *x, int n);
+    int (*max_int)(const int *x, int n);
+    double (*min_real)(const double *x, int n);
+    double (*max_real)(const double *x, int n);
+    void (*fill_int)(int *x, int n, int value);
+    void (*fill_real)(double *x, int n, double value);
+    void (*scale_int)(int *x, int n, int factor);
+    void (*scale_real)(double *x, int n, double factor);
+} Kernels;
+
+/**
+ * @brief Returns the kernels for the best instruction set supported by the CPU (AVX-512, AVX2, SSE2 or scalar).
+ *
+ * The choice is made on the first call (it is thread-safe). The environment variable SIMPLE_COMPILER_ISA (scalar, sse2, avx2 or avx512)
+ * can force a lower instruction set.
+ *
+ * @return Pointer to the table of kernels.
+ */
+const Kernels *get_kernels(void);
+
+#endif // KERNELS_H
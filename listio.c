@@ -0,0 +1,200 @@
+#include <ctype.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
+#include "listio.h"
+
+#define LISTIO_BUFFER 65536
+#define TOKEN_MAX 128
+
+/**
+ * @brief Reads the next whitespace separated token.
+ *
+ * @return Returns 1 if OK, and 0 at the end of the file or if the token is too long.
+ */
+static int next_token(FILE *f, char *token) {
+    int c;
+    do {
+        c = getc_unlocked(f);
+    } while (c != EOF && isspace(c));
+    if (c == EOF) return 0;
+
+    int len = 0;
+    while (c != EOF && !isspace(c)) {
+        if (len == TOKEN_MAX - 1) return 0;
+        token[len++] = (char)c;
+        c = getc_unlocked(f);
+    }
+    token[len] = '\0';
+    return 1;
+}
+
+/**
+ * @brief Converts a token to an element of a LISTAINT: an integer, or a real truncated like an assignment.
+ *
+ * @return Returns 1 if OK, and 0 if the token is not a number or its value does not fit in an int.
+ */
+static int parse_int(const char *token, int *out) {
+    char *rest;
+    errno = 0;
+    long value = strtol(token, &rest, 10);
+    if (*rest == '\0' && rest != token) {
+        if (errno == ERANGE || value < INT_MIN || value > INT_MAX) return 0;
+        *out = (int)value;
+        return 1;
+    }
+
+    /* Converting a double that does not fit (or NaN) to an integer is undefined. */
+    double real = strtod(token, &rest);
+    if (*rest != '\0' || rest == token || !(real > (double)INT_MIN - 1.0 && real < (double)INT_MAX + 1.0)) return 0;
+    *out = (int)real;
+    return 1;
+}
+
+static int read_text(FILE *f, Variable *v, int start, int end) {
+    char token[TOKEN_MAX];
+    char *rest;
+
+    flockfile(f);
+    for (int i = start; i < end; i++) {
+        if (!next_token(f, token)) {
+            funlockfile(f);
+            return 0;
+        }
+
+        int ok;
+        if (v->type == T_LISTAINT) {
+            ok = parse_int(token, (int *)v->data + i);
+        } else {
+            ((double *)v->data)[i] = strtod(token, &rest);
+            ok = *rest == '\0' && rest != token;
+        }
+
+        if (!ok) {
+            funlockfile(f);
+            return 0;
+        }
+    }
+    funlockfile(f);
+    return 1;
+}
+
+/**
+ * @brief Reverses the bytes of each element (only used on big-endian hosts).
+ */
+static void swap_bytes(unsigned char *data, size_t count, size_t width) {
+    for (size_t i = 0; i < count; i++) {
+        unsigned char *e = data + i * width;
+        for (size_t j = 0; j < width / 2; j++) {
+            unsigned char t = e[j];
+            e[j] = e[width - 1 - j];
+            e[width - 1 - j] = t;
+        }
+    }
+}
+
+static int host_is_big_endian(void) {
+    const uint16_t probe = 1;
+    return *(const unsigned char *)&probe == 0;
+}
+
+int read_list(FILE *f, Variable *v, int start, int end, int binary) {
+    if (!f || !v || !v->data) return 0;
+    if (v->type != T_LISTAINT && v->type != T_LISTAREAL) return 0;
+    if (start >= end) return 1;
+
+    if (!binary) return read_text(f, v, start, end);
+
+    size_t width = (v->type == T_LISTAINT) ? sizeof(int32_t) : sizeof(double);
+    size_t count = (size_t)(end - start);
+    unsigned char *target = (unsigned char *)v->data + width * start;
+
+    if (fread(target, width, count, f) != count) return 0;
+    if (host_is_big_endian()) swap_bytes(target, count, width);
+    return 1;
+}
+
+/**
+ * @brief Writes an integer in decimal followed by a line break.
+ *
+ * @return The number of characters written.
+ */
+static int format_int(char *out, int value) {
+    char digits[16];
+    unsigned int u = (value < 0) ? 0u - (unsigned int)value : (unsigned int)value;
+    int len = 0;
+
+    do {
+        digits[len++] = (char)('0' + u % 10);
+        u /= 10;
+    } while (u);
+
+    int pos = 0;
+    if (value < 0) out[pos++] = '-';
+    while (len) out[pos++] = digits[--len];
+    out[pos++] = '\n';
+    return pos;
+}
+
+static int write_text(FILE *f, Variable *v, int start, int end) {
+    char *buffer = (char *)malloc(LISTIO_BUFFER);
+    if (!buffer) return 0;
+
+    size_t used = 0;
+    for (int i = start; i < end; i++) {
+        if (used > LISTIO_BUFFER - 512) {
+            if (fwrite(buffer, 1, used, f) != used) {
+                free(buffer);
+                return 0;
+            }
+            used = 0;
+        }
+
+        if (v->type == T_LISTAINT) {
+            used += format_int(buffer + used, ((int *)v->data)[i]);
+        } else {
+            /* Doubles keep the printf() format of ESCREVA so that both outputs are identical. */
+            used += snprintf(buffer + used, LISTIO_BUFFER - used, "%lf\n", ((double *)v->data)[i]);
+        }
+    }
+
+    int ok = fwrite(buffer, 1, used, f) == used;
+    free(buffer);
+    return ok;
+}
+
+size_t list_output_size(Variable *v, int start, int end, int binary) {
+    if (start >= end) return 0;
+    if (binary) return (size_t)(end - start) * ((v->type == T_LISTAINT) ? sizeof(int32_t) : sizeof(double));
+
+    char text[16];
+    size_t size = 0;
+    for (int i = start; i < end; i++) {
+        if (v->type == T_LISTAINT) size += format_int(text, ((int *)v->data)[i]);
+        else size += snprintf(NULL, 0, "%lf\n", ((double *)v->data)[i]);
+    }
+    return size;
+}
+
+int write_list(FILE *f, Variable *v, int start, int end, int binary) {
+    if (!f || !v || !v->data) return 0;
+    if (v->type != T_LISTAINT && v->type != T_LISTAREAL) return 0;
+    if (start >= end) return 1;
+
+    if (!binary) return write_text(f, v, start, end);
+
+    size_t width = (v->type == T_LISTAINT) ? sizeof(int32_t) : sizeof(double);
+    size_t count = (size_t)(end - start);
+    unsigned char *source = (unsigned char *)v->data + width * start;
+
+    if (!host_is_big_endian()) return fwrite(source, width, count, f) == count;
+
+    unsigned char *copy = (unsigned char *)malloc(width * count);
+    if (!copy) return 0;
+    memcpy(copy, source, width * count);
+    swap_bytes(copy, count, width);
+
+    int ok = fwrite(copy, width, count, f) == count;
+    free(copy);
+    return ok;
+}
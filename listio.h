@@ -0,0 +1,50 @@
+#ifndef LISTIO_H
+#define LISTIO_H
+
+#include "types.h"
+
+/**
+ * @brief Reads the elements [start, end) of a list from a file.
+ *
+ * In text mode the values are separated by any whitespace, and a LISTAINT takes integers and reals (truncated), but
+ * not a value that does not fit in an int. In binary mode LISTAINT values are 32-bit integers and
+ * LISTAREAL values are IEEE-754 doubles, both little-endian.
+ *
+ * @param f Source file.
+ * @param v List variable (T_LISTAINT or T_LISTAREAL), with data already allocated.
+ * @param start First index.
+ * @param end Index after the last one.
+ * @param binary 1 for raw little-endian values, 0 for text.
+ *
+ * @return Returns 1 if OK, and 0 if it fails.
+ */
+int read_list(FILE *f, Variable *v, int start, int end, int binary);
+
+/**
+ * @brief Writes the elements [start, end) of a list to a file.
+ *
+ * In text mode each value is written on its own line, with the same format used by ESCREVA.
+ *
+ * @param f Target file.
+ * @param v List variable (T_LISTAINT or T_LISTAREAL), already initialized.
+ * @param start First index.
+ * @param end Index after the last one.
+ * @param binary 1 for raw little-endian values, 0 for text.
+ *
+ * @return Returns 1 if OK, and 0 if it fails.
+ */
+int write_list(FILE *f, Variable *v, int start, int end, int binary);
+
+/**
+ * @brief Returns the number of bytes that write_list() writes for the elements [start, end) of a list.
+ *
+ * @param v List variable (T_LISTAINT or T_LISTAREAL), already initialized.
+ * @param start First index.
+ * @param end Index after the last one.
+ * @param binary 1 for raw little-endian values, 0 for text.
+ *
+ * @return Size in bytes.
+ */
+size_t list_output_size(Variable *v, int start, int end, int binary);
+
+#endif // LISTIO_H
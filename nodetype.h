@@ -0,0 +1,33 @@
+#ifndef NODETYPE_H
+#define NODETYPE_H
+
+/*
+ * Types of the nodes of the AST, as an X-macro, so the enum (ast.h) and the names printed by the statistics and by
+ * trace-decode (which does not link ast.c) always match. New types go before the last entry.
+ *
+ * Nodes are divided into nodes that represent some action, and nodes that result in some value.
+ */
+#define NODE_TYPES(X) \
+    /* Action nodes. */ \
+    X(NODE_BLOCK)       /* Contains nodes to be executed. */ \
+    X(NODE_DECL)        /* Node representing a statement. */ \
+    X(NODE_ASSIGN)      /* Node representing an assignment. */ \
+    X(NODE_IF)          /* Node representing an if. */ \
+    X(NODE_WHILE)       /* Node representing a while. */ \
+    X(NODE_WRITE)       /* Node representing a printf. */ \
+    X(NODE_READ)        /* Node representing a scanf. */ \
+    X(NODE_LISTIO)      /* Node representing a read or write of a whole list (or a slice). */ \
+    X(NODE_LISTOP)      /* Node representing an intrinsic that modifies a whole list (fill, scale). */ \
+    /* Value nodes. */ \
+    X(NODE_INT)         /* Node representing an integer. */ \
+    X(NODE_REAL)        /* Node representing a real. */ \
+    X(NODE_VAR)         /* Node representing a variable. */ \
+    X(NODE_BINOP)       /* Node representing a BinOp expression. */ \
+    X(NODE_RELOP)       /* Node representing a RelOP expression. */ \
+    X(NODE_INTRINSIC)   /* Node representing an intrinsic over whole lists (sum, mean, min, max, dot product). */ \
+    X(NODE_TEMP)        /* Node representing a value computed once and reused (created by the optimizer). */
+
+#define NODE_TYPE_ENUM(name) name,
+#define NODE_TYPE_NAME(name) #name,
+
+#endif // NODETYPE_H
@@ -0,0 +1,1173 @@
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
+#include "optimizer.h"
+#include "context.h"
+#include "ast.h"
+#include "types.h"
+
+/**
+ * @struct NameSet
+ *
+ * @brief Set of variable names (the strings belong to the AST).
+ */
+typedef struct NameSet {
+    char **names;
+    int count;
+    int capacity;
+} NameSet;
+
+/**
+ * @struct NodeSet
+ *
+ * @brief Hash set of node pointers (open addressing).
+ */
+typedef struct NodeSet {
+    Node **slots;
+    int capacity;
+    int count;
+} NodeSet;
+
+/**
+ * @struct Decl
+ *
+ * @brief Type of a declared variable.
+ */
+typedef struct Decl {
+    char *name;
+    Types type;
+} Decl;
+
+/**
+ * @struct Optimizer
+ *
+ * @brief State shared by the passes.
+ */
+typedef struct Optimizer {
+    Context *ctx;
+    Decl *decls;
+    int decl_count;
+    NodeSet safe;   // Assignments and conditions that can never fail at runtime.
+    OptStats stats;
+} Optimizer;
+
+/*
+ * Context being optimized by this thread, so the helpers that have no Optimizer at hand (the sets) can report a
+ * failed allocation through context_error().
+ */
+static _Thread_local Context *optimizing = NULL;
+
+static void *xrealloc(void *p, size_t size) {
+    void *r = realloc(p, size);
+    if (!r) context_error(optimizing, "realloc() failed: %s", strerror(errno));
+    return r;
+}
+
+/* Name sets. */
+
+static int set_has(NameSet *s, const char *name) {
+    for (int i = 0; i < s->count; i++) {
+        if (strcmp(s->names[i], name) == 0) return 1;
+    }
+    return 0;
+}
+
+static void set_add(NameSet *s, char *name) {
+    if (!name || set_has(s, name)) return;
+    if (s->count == s->capacity) {
+        s->capacity = s->capacity ? s->capacity * 2 : 8;
+        s->names = (char **)xrealloc(s->names, sizeof(char *) * s->capacity);
+    }
+    s->names[s->count++] = name;
+}
+
+static void set_remove(NameSet *s, const char *name) {
+    for (int i = 0; i < s->count; i++) {
+        if (strcmp(s->names[i], name) == 0) {
+            s->names[i] = s->names[--s->count];
+            return;
+        }
+    }
+}
+
+static NameSet set_copy(NameSet *s) {
+    NameSet r = { NULL, 0, 0 };
+    for (int i = 0; i < s->count; i++) set_add(&r, s->names[i]);
+    return r;
+}
+
+static void set_union(NameSet *dst, NameSet *src) {
+    for (int i = 0; i < src->count; i++) set_add(dst, src->names[i]);
+}
+
+static void set_intersect(NameSet *dst, NameSet *other) {
+    for (int i = 0; i < dst->count; ) {
+        if (!set_has(other, dst->names[i])) {
+            dst->names[i] = dst->names[--dst->count];
+        } else {
+            i++;
+        }
+    }
+}
+
+static int set_equal(NameSet *a, NameSet *b) {
+    if (a->count != b->count) return 0;
+    for (int i = 0; i < a->count; i++) {
+        if (!set_has(b, a->names[i])) return 0;
+    }
+    return 1;
+}
+
+static void set_free(NameSet *s) {
+    free(s->names);
+    s->names = NULL;
+    s->count = s->capacity = 0;
+}
+
+/* Node sets. */
+
+static size_t node_hash(Node *n, int capacity) {
+    uintptr_t p = (uintptr_t)n;
+    p ^= p >> 17;
+    p *= 0x9E3779B97F4A7C15ull;
+    return (size_t)(p >> 7) & (size_t)(capacity - 1);
+}
+
+static int nodeset_has(NodeSet *s, Node *n) {
+    if (!s->capacity) return 0;
+    for (size_t i = node_hash(n, s->capacity); s->slots[i]; i = (i + 1) & (s->capacity - 1)) {
+        if (s->slots[i] == n) return 1;
+    }
+    return 0;
+}
+
+static void nodeset_add(NodeSet *s, Node *n) {
+    if ((s->count + 1) * 2 > s->capacity) {
+        NodeSet grown = { NULL, s->capacity ? s->capacity * 2 : 64, 0 };
+        grown.slots = (Node **)calloc(grown.capacity, sizeof(Node *));
+        if (!grown.slots) context_error(optimizing, "calloc() failed: %s", strerror(errno));
+        for (int i = 0; i < s->capacity; i++) {
+            if (s->slots[i]) nodeset_add(&grown, s->slots[i]);
+        }
+        free(s->slots);
+        *s = grown;
+    }
+
+    size_t i = node_hash(n, s->capacity);
+    while (s->slots[i]) {
+        if (s->slots[i] == n) return;
+        i = (i + 1) & (s->capacity - 1);
+    }
+    s->slots[i] = n;
+    s->count++;
+}
+
+/* Helpers over the AST. */
+
+/**
+ * @brief Returns the declared type of a variable, or T_UNTYPED if it was not declared.
+ *
+ * The last declaration wins, since it is the one that search() will find.
+ */
+static Types decl_type(Optimizer *o, const char *name) {
+    for (int i = o->decl_count - 1; i >= 0; i--) {
+        if (strcmp(o->decls[i].name, name) == 0) return o->decls[i].type;
+    }
+    return T_UNTYPED;
+}
+
+static int is_scalar(Optimizer *o, const char *name) {
+    Types t = decl_type(o, name);
+    return t == T_INTEIRO || t == T_REAL;
+}
+
+/**
+ * @brief Type of the value produced by an expression (T_INTEIRO or T_REAL).
+ */
+static Types expr_type(Optimizer *o, Node *e) {
+    if (!e) return T_REAL;
+
+    switch (e->type) {
+        case NODE_INT:
+            return T_INTEIRO;
+        case NODE_VAR:
+        {
+            Types t = decl_type(o, e->var.name);
+            return (t == T_INTEIRO || t == T_LISTAINT) ? T_INTEIRO : T_REAL;
+        }
+        case NODE_BINOP:
+            if (expr_type(o, e->binop.left) == T_INTEIRO && expr_type(o, e->binop.right) == T_INTEIRO) {
+                return T_INTEIRO;
+            }
+            return T_REAL;
+        case NODE_RELOP:
+            return T_INTEIRO;
+        case NODE_INTRINSIC:
+            if (e->intrinsic.op == I_MEDIA) return T_REAL;
+            return (decl_type(o, e->intrinsic.name) == T_LISTAINT) ? T_INTEIRO : T_REAL;
+        case NODE_REAL:
+        default:
+            return T_REAL;
+    }
+}
+
+/**
+ * @brief Checks if an expression can be evaluated without failing.
+ *
+ * @param init Scalars that are surely initialized at this point.
+ */
+static int expr_is_safe(Optimizer *o, Node *e, NameSet *init) {
+    if (!e) return 1;
+
+    switch (e->type) {
+        case NODE_INT:
+        case NODE_REAL:
+            return 1;
+        case NODE_VAR:
+            return is_scalar(o, e->var.name) && set_has(init, e->var.name);
+        case NODE_BINOP:
+            if (!expr_is_safe(o, e->binop.left, init) || !expr_is_safe(o, e->binop.right, init)) return 0;
+            /* A division by -1 traps too, when the dividend is the smallest integer. */
+            if (e->binop.op == OP_DIV && expr_type(o, e) == T_INTEIRO) {
+                return e->binop.right->type == NODE_INT && e->binop.right->intval != 0 && e->binop.right->intval != -1;
+            }
+            return 1;
+        case NODE_RELOP:
+            return expr_is_safe(o, e->relop.left, init) && expr_is_safe(o, e->relop.right, init);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Checks if an expression only contains literals.
+ */
+static int expr_is_constant(Node *e) {
+    if (!e) return 1;
+
+    switch (e->type) {
+        case NODE_INT:
+        case NODE_REAL:
+            return 1;
+        case NODE_BINOP:
+            return expr_is_constant(e->binop.left) && expr_is_constant(e->binop.right);
+        case NODE_RELOP:
+            return expr_is_constant(e->relop.left) && expr_is_constant(e->relop.right);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Adds the variables read by an expression to the set.
+ */
+static void add_uses(NameSet *live, Node *e) {
+    if (!e) return;
+
+    switch (e->type) {
+        case NODE_VAR:
+            set_add(live, e->var.name);
+            if (e->var.index.type == VARIABLE) set_add(live, e->var.index.value.name);
+            break;
+        case NODE_BINOP:
+            add_uses(live, e->binop.left);
+            add_uses(live, e->binop.right);
+            break;
+        case NODE_RELOP:
+            add_uses(live, e->relop.left);
+            add_uses(live, e->relop.right);
+            break;
+        case NODE_INTRINSIC:
+            set_add(live, e->intrinsic.name);
+            set_add(live, e->intrinsic.other);
+            break;
+        case NODE_TEMP:
+            add_uses(live, e->temp.expr);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Forward pass: finds the statements that can never fail. */
+
+static void mark_safe(Optimizer *o, Node *n, NameSet *init) {
+    if (!n) return;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+            for (int i = 0; i < n->block.count; i++) {
+                mark_safe(o, n->block.cmds[i], init);
+            }
+            break;
+        case NODE_DECL:
+            set_remove(init, n->decl.name);
+            break;
+        case NODE_ASSIGN:
+        {
+            Node *var = n->assign.var;
+            if (is_scalar(o, var->var.name)) {
+                if (var->var.index.type == INTEGER && expr_is_safe(o, n->assign.expr, init)) {
+                    nodeset_add(&o->safe, n);
+                }
+                set_add(init, var->var.name);
+            }
+            break;
+        }
+        case NODE_READ:
+            if (is_scalar(o, n->readnode.var->var.name)) set_add(init, n->readnode.var->var.name);
+            break;
+        case NODE_IF:
+        {
+            if (expr_is_safe(o, n->ifnode.cond, init)) nodeset_add(&o->safe, n);
+
+            NameSet then_init = set_copy(init);
+            NameSet else_init = set_copy(init);
+            mark_safe(o, n->ifnode.then_block, &then_init);
+            mark_safe(o, n->ifnode.else_block, &else_init);
+
+            set_free(init);
+            *init = then_init;
+            set_intersect(init, &else_init);
+            set_free(&else_init);
+            break;
+        }
+        case NODE_WHILE:
+        {
+            /* The body may not run, so nothing it initializes is guaranteed after the loop. */
+            if (expr_is_safe(o, n->whilenode.cond, init)) nodeset_add(&o->safe, n);
+
+            NameSet body_init = set_copy(init);
+            mark_safe(o, n->whilenode.body, &body_init);
+            set_free(&body_init);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+/* Backward pass: liveness analysis and removal. */
+
+static int block_is_empty(Node *n) {
+    return !n || (n->type == NODE_BLOCK && n->block.count == 0);
+}
+
+/**
+ * @brief Updates the live set from the end to the start of the node, removing what is dead.
+ *
+ * When remove is 0 the tree is left untouched, but the live set is computed as if the removals were made (used by
+ * the fixed point of loops).
+ *
+ * @param n Node to be analyzed.
+ * @param live Variables live after the node; on return, variables live before it.
+ * @param remove Whether the dead nodes should be freed.
+ *
+ * @return The node that replaces n (NULL if it was removed).
+ */
+static Node *sweep(Optimizer *o, Node *n, NameSet *live, int remove) {
+    if (!n) return NULL;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+        {
+            int kept = n->block.count;
+            for (int i = n->block.count - 1; i >= 0; i--) {
+                Node *r = sweep(o, n->block.cmds[i], live, remove);
+                if (remove) {
+                    n->block.cmds[i] = r;
+                    if (!r) kept--;
+                }
+            }
+
+            if (remove && kept != n->block.count) {
+                int j = 0;
+                for (int i = 0; i < n->block.count; i++) {
+                    if (n->block.cmds[i]) n->block.cmds[j++] = n->block.cmds[i];
+                }
+                n->block.count = j;
+            }
+            return n;
+        }
+        case NODE_ASSIGN:
+        {
+            Node *var = n->assign.var;
+            if (is_scalar(o, var->var.name)) {
+                if (!set_has(live, var->var.name) && nodeset_has(&o->safe, n)) {
+                    if (remove) {
+                        o->stats.dead_stores++;
+                        free_node(n);
+                    }
+                    return NULL;
+                }
+                set_remove(live, var->var.name);
+            }
+
+            add_uses(live, n->assign.expr);
+            if (var->var.index.type == VARIABLE) set_add(live, var->var.index.value.name);
+            return n;
+        }
+        case NODE_READ:
+        {
+            Node *var = n->readnode.var;
+            if (is_scalar(o, var->var.name)) set_remove(live, var->var.name);
+            if (var->var.index.type == VARIABLE) set_add(live, var->var.index.value.name);
+            return n;
+        }
+        case NODE_WRITE:
+            add_uses(live, n->writenode.var);
+            return n;
+        case NODE_LISTIO:
+            if (n->listio.write) set_add(live, n->listio.name);
+            add_uses(live, n->listio.range.start);
+            add_uses(live, n->listio.range.end);
+            return n;
+        case NODE_LISTOP:
+            if (n->listop.op == I_ESCALA) set_add(live, n->listop.name);
+            add_uses(live, n->listop.expr);
+            return n;
+        case NODE_IF:
+        {
+            int safe = nodeset_has(&o->safe, n);
+
+            if (safe && expr_is_constant(n->ifnode.cond)) {
+                int taken = eval_node(o->ctx, n->ifnode.cond).v.i;
+                Node *branch = taken ? n->ifnode.then_block : n->ifnode.else_block;
+                Node *r = sweep(o, branch, live, remove);
+
+                if (remove) {
+                    if (taken) {
+                        n->ifnode.then_block = NULL;
+                    } else {
+                        n->ifnode.else_block = NULL;
+                    }
+                    free_node(n);
+                    o->stats.dead_branches++;
+                }
+                return r;
+            }
+
+            NameSet then_live = set_copy(live);
+            NameSet else_live = set_copy(live);
+            Node *then_block = sweep(o, n->ifnode.then_block, &then_live, remove);
+            Node *else_block = sweep(o, n->ifnode.else_block, &else_live, remove);
+
+            set_free(live);
+            *live = then_live;
+            set_union(live, &else_live);
+            set_free(&else_live);
+
+            if (safe && block_is_empty(then_block) && block_is_empty(else_block)) {
+                if (remove) {
+                    free_node(n);
+                    o->stats.dead_branches++;
+                }
+                return NULL;
+            }
+
+            add_uses(live, n->ifnode.cond);
+            return n;
+        }
+        case NODE_WHILE:
+        {
+            if (nodeset_has(&o->safe, n) && expr_is_constant(n->whilenode.cond)
+                && !eval_node(o->ctx, n->whilenode.cond).v.i) {
+                if (remove) {
+                    free_node(n);
+                    o->stats.dead_branches++;
+                }
+                return NULL;
+            }
+
+            /* Live at the loop head: after the loop, the condition, and whatever the body needs (fixed point). */
+            NameSet head = set_copy(live);
+            add_uses(&head, n->whilenode.cond);
+            while (1) {
+                NameSet body_live = set_copy(&head);
+                sweep(o, n->whilenode.body, &body_live, 0);
+
+                NameSet next = set_copy(live);
+                add_uses(&next, n->whilenode.cond);
+                set_union(&next, &body_live);
+                set_free(&body_live);
+
+                int stable = set_equal(&next, &head);
+                set_free(&head);
+                head = next;
+                if (stable) break;
+            }
+
+            if (remove) {
+                NameSet body_live = set_copy(&head);
+                sweep(o, n->whilenode.body, &body_live, 1);
+                set_free(&body_live);
+            }
+
+            set_free(live);
+            *live = head;
+            return n;
+        }
+        case NODE_DECL:
+        default:
+            return n;
+    }
+}
+
+/* Unused declarations. */
+
+static void add_refs(NameSet *refs, Node *n) {
+    if (!n) return;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+            for (int i = 0; i < n->block.count; i++) add_refs(refs, n->block.cmds[i]);
+            break;
+        case NODE_ASSIGN:
+            add_uses(refs, n->assign.var);
+            add_uses(refs, n->assign.expr);
+            break;
+        case NODE_IF:
+            add_uses(refs, n->ifnode.cond);
+            add_refs(refs, n->ifnode.then_block);
+            add_refs(refs, n->ifnode.else_block);
+            break;
+        case NODE_WHILE:
+            add_uses(refs, n->whilenode.cond);
+            add_refs(refs, n->whilenode.body);
+            break;
+        case NODE_WRITE:
+            add_uses(refs, n->writenode.var);
+            break;
+        case NODE_READ:
+            add_uses(refs, n->readnode.var);
+            break;
+        case NODE_LISTIO:
+            set_add(refs, n->listio.name);
+            add_uses(refs, n->listio.range.start);
+            add_uses(refs, n->listio.range.end);
+            break;
+        case NODE_LISTOP:
+            set_add(refs, n->listop.name);
+            add_uses(refs, n->listop.expr);
+            break;
+        default:
+            break;
+    }
+}
+
+static void remove_unused_decls(Optimizer *o, Node *program) {
+    NameSet refs = { NULL, 0, 0 };
+    add_refs(&refs, program);
+
+    int j = 0;
+    for (int i = 0; i < program->block.count; i++) {
+        Node *cmd = program->block.cmds[i];
+        if (cmd->type == NODE_DECL && !set_has(&refs, cmd->decl.name)) {
+            free_node(cmd);
+            o->stats.dead_decls++;
+            continue;
+        }
+        program->block.cmds[j++] = cmd;
+    }
+    program->block.count = j;
+
+    set_free(&refs);
+}
+
+/* Loop unrolling. */
+
+/**
+ * @brief Adds the variables modified by a statement to the set.
+ */
+static void add_defs(NameSet *defs, Node *n) {
+    if (!n) return;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+            for (int i = 0; i < n->block.count; i++) add_defs(defs, n->block.cmds[i]);
+            break;
+        case NODE_DECL:
+            set_add(defs, n->decl.name);
+            break;
+        case NODE_ASSIGN:
+            set_add(defs, n->assign.var->var.name);
+            break;
+        case NODE_READ:
+            set_add(defs, n->readnode.var->var.name);
+            break;
+        case NODE_LISTIO:
+            if (!n->listio.write) set_add(defs, n->listio.name);
+            break;
+        case NODE_LISTOP:
+            set_add(defs, n->listop.name);
+            break;
+        case NODE_IF:
+            add_defs(defs, n->ifnode.then_block);
+            add_defs(defs, n->ifnode.else_block);
+            break;
+        case NODE_WHILE:
+            add_defs(defs, n->whilenode.body);
+            break;
+        default:
+            break;
+    }
+}
+
+
+/**
+ * @struct CountedLoop
+ *
+ * @brief A loop whose condition compares an integer with a bound, and whose body ends by stepping it.
+ *
+ *     ENQUANTO i .MEQ. n FACA     (or .MEI.; .MAQ. or .MAI. when the step is negative)
+ *         ...                     (modifies neither i nor n)
+ *         i := i + 1              (or any other nonzero integer, added or subtracted)
+ *     FIMENQ
+ */
+typedef struct CountedLoop {
+    char *var;      // Induction variable.
+    int step;
+    RelOp op;
+    Node *bound;    // NODE_INT, or NODE_VAR of an integer scalar.
+    int size;       // Nodes of the body.
+} CountedLoop;
+
+static int count_nodes(Node *n) {
+    if (!n) return 0;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+        {
+            int count = 1;
+            for (int i = 0; i < n->block.count; i++) count += count_nodes(n->block.cmds[i]);
+            return count;
+        }
+        case NODE_ASSIGN:
+            return 1 + count_nodes(n->assign.expr) + count_nodes(n->assign.var);
+        case NODE_IF:
+            return 1 + count_nodes(n->ifnode.cond) + count_nodes(n->ifnode.then_block)
+                + count_nodes(n->ifnode.else_block);
+        case NODE_WHILE:
+            return 1 + count_nodes(n->whilenode.cond) + count_nodes(n->whilenode.body);
+        case NODE_WRITE:
+            return 1 + count_nodes(n->writenode.var);
+        case NODE_READ:
+            return 1 + count_nodes(n->readnode.var);
+        case NODE_LISTIO:
+            return 1 + count_nodes(n->listio.range.start) + count_nodes(n->listio.range.end);
+        case NODE_BINOP:
+            return 1 + count_nodes(n->binop.left) + count_nodes(n->binop.right);
+        case NODE_RELOP:
+            return 1 + count_nodes(n->relop.left) + count_nodes(n->relop.right);
+        case NODE_LISTOP:
+            return 1 + count_nodes(n->listop.expr);
+        case NODE_TEMP:
+            return 1 + count_nodes(n->temp.expr);
+        default:
+            return 1;
+    }
+}
+
+static int contains_loop(Node *n) {
+    if (!n) return 0;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+            for (int i = 0; i < n->block.count; i++) {
+                if (contains_loop(n->block.cmds[i])) return 1;
+            }
+            return 0;
+        case NODE_IF:
+            return contains_loop(n->ifnode.then_block) || contains_loop(n->ifnode.else_block);
+        case NODE_WHILE:
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Checks if a node reads a scalar variable by its name (and not an element of a list).
+ */
+static int is_scalar_var(Node *n, const char *name) {
+    return n && n->type == NODE_VAR && n->var.index.type == INTEGER && strcmp(n->var.name, name) == 0;
+}
+
+/**
+ * @brief Recognizes a counted loop (see CountedLoop).
+ *
+ * @return 1 if the loop is counted, 0 otherwise.
+ */
+static int counted_loop(Optimizer *o, Node *loop, CountedLoop *l) {
+    Node *cond = loop->whilenode.cond;
+    Node *body = loop->whilenode.body;
+    if (cond->type != NODE_RELOP || cond->relop.left->type != NODE_VAR) return 0;
+    if (body->type != NODE_BLOCK || body->block.count < 2 || contains_loop(body)) return 0;
+
+    l->var = cond->relop.left->var.name;
+    l->op = cond->relop.op;
+    l->bound = cond->relop.right;
+    if (!is_scalar_var(cond->relop.left, l->var) || decl_type(o, l->var) != T_INTEIRO) return 0;
+
+    /* The bound is compared as a double, so a real would also work, but its value is only known as an integer. */
+    if (l->bound->type == NODE_VAR) {
+        if (!is_scalar_var(l->bound, l->bound->var.name) || decl_type(o, l->bound->var.name) != T_INTEIRO) return 0;
+        if (strcmp(l->bound->var.name, l->var) == 0) return 0;
+    } else if (l->bound->type != NODE_INT) {
+        return 0;
+    }
+
+    Node *last = body->block.cmds[body->block.count - 1];
+    if (last->type != NODE_ASSIGN || !is_scalar_var(last->assign.var, l->var)) return 0;
+
+    Node *e = last->assign.expr;
+    if (e->type != NODE_BINOP || (e->binop.op != OP_ADD && e->binop.op != OP_SUB)) return 0;
+    if (!is_scalar_var(e->binop.left, l->var) || e->binop.right->type != NODE_INT) return 0;
+    if (e->binop.right->intval == 0 || e->binop.right->intval == INT_MIN) return 0;
+    l->step = e->binop.op == OP_ADD ? e->binop.right->intval : -e->binop.right->intval;
+
+    if (l->step > 0 && l->op != R_MEQ && l->op != R_MEI) return 0;
+    if (l->step < 0 && l->op != R_MAQ && l->op != R_MAI) return 0;
+
+    /* Only the last statement can modify the variable, and nothing can modify the bound. */
+    NameSet defs = { NULL, 0, 0 };
+    for (int i = 0; i < body->block.count - 1; i++) add_defs(&defs, body->block.cmds[i]);
+    int modified = set_has(&defs, l->var) || (l->bound->type == NODE_VAR && set_has(&defs, l->bound->var.name));
+    set_free(&defs);
+    if (modified) return 0;
+
+    l->size = count_nodes(body);
+    return 1;
+}
+
+/**
+ * @brief Returns the number of iterations of a counted loop that starts with a known value.
+ *
+ * @return The trip count, or -1 if it is more than max (or if the variable would overflow).
+ */
+static int trip_count(CountedLoop *l, int start, int max) {
+    long long i = start, bound = l->bound->intval;
+    for (int trips = 0; trips <= max; trips++) {
+        int runs;
+        switch (l->op) {
+            case R_MEQ: runs = i < bound; break;
+            case R_MEI: runs = i <= bound; break;
+            case R_MAQ: runs = i > bound; break;
+            case R_MAI:
+            default: runs = i >= bound;
+        }
+        if (!runs) return trips;
+
+        i += l->step;
+        if (i < INT_MIN || i > INT_MAX) return -1;
+    }
+    return -1;
+}
+
+/**
+ * @brief Appends copies of the statements of a block to an array.
+ */
+static void append_copies(Optimizer *o, Node ***cmds, int *count, Node *block) {
+    *cmds = (Node **)xrealloc(*cmds, sizeof(Node *) * (*count + block->block.count));
+    for (int i = 0; i < block->block.count; i++) {
+        (*cmds)[(*count)++] = copy_node(o->ctx, block->block.cmds[i]);
+    }
+}
+
+/**
+ * @brief Unrolls a counted loop.
+ *
+ * @param loop The loop.
+ * @param prev Statement right before the loop in the same block (NULL if there is none).
+ *
+ * @return The node that replaces the loop (the loop itself if it was not unrolled).
+ */
+static Node *unroll_loop(Optimizer *o, Node *loop, Node *prev) {
+    CountedLoop l;
+    int factor = o->ctx->unroll_factor;
+    if (factor < 2 || !counted_loop(o, loop, &l)) return loop;
+
+    Node *body = loop->whilenode.body;
+    Node **cmds = NULL;
+    int count = 0;
+
+    /*
+     * Starting from a constant, to a constant bound: the body is repeated once per iteration. The condition never
+     * fails in this case, so not evaluating it does not hide any error. The block still counts the iterations, so the
+     * limit of the budget does not depend on the unrolling.
+     */
+    if (prev && prev->type == NODE_ASSIGN && is_scalar_var(prev->assign.var, l.var)
+        && prev->assign.expr->type == NODE_INT && l.bound->type == NODE_INT) {
+        int trips = trip_count(&l, prev->assign.expr->intval, OPT_UNROLL_FULL_TRIPS);
+        if (trips >= 0 && trips * l.size <= OPT_UNROLL_BUDGET) {
+            for (int i = 0; i < trips; i++) append_copies(o, &cmds, &count, body);
+            if (!cmds) cmds = (Node **)xrealloc(NULL, sizeof(Node *));
+
+            free_node(loop);
+            o->stats.unrolled_loops++;
+            Node *block = make_block(o->ctx, cmds, count);
+            block->block.iterations = trips;
+            return block;
+        }
+    }
+
+    if (factor * l.size > OPT_UNROLL_BUDGET) factor = OPT_UNROLL_BUDGET / l.size;
+    if (factor < 2) return loop;
+
+    /*
+     * The unrolled loop only starts an iteration if the last of its copies would also run:
+     *     ENQUANTO i + (factor - 1) * step .MEQ. n FACA    body (factor times)    FIMENQ
+     * and the original loop runs what is left. The offset is real so the sum cannot overflow, and the comparison is
+     * made with doubles anyway.
+     */
+    for (int i = 0; i < factor; i++) append_copies(o, &cmds, &count, body);
+
+    Node *offset = make_real(o->ctx, (double)(factor - 1) * l.step);
+    Node *last = make_binop(o->ctx, OP_ADD, copy_node(o->ctx, loop->whilenode.cond->relop.left), offset);
+    Node *cond = make_relop(o->ctx, l.op, last, copy_node(o->ctx, l.bound));
+    Node *unrolled = make_while(o->ctx, cond, make_block(o->ctx, cmds, count));
+    unrolled->whilenode.copies = factor;
+
+    Node **pair = (Node **)xrealloc(NULL, sizeof(Node *) * 2);
+    pair[0] = unrolled;
+    pair[1] = loop;
+    o->stats.unrolled_loops++;
+    return make_block(o->ctx, pair, 2);
+}
+
+/**
+ * @brief Unrolls the innermost counted loops of a statement.
+ */
+static void unroll_stmt(Optimizer *o, Node *n) {
+    if (!n) return;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+            for (int i = 0; i < n->block.count; i++) {
+                Node *cmd = n->block.cmds[i];
+                unroll_stmt(o, cmd);
+                if (cmd->type == NODE_WHILE) {
+                    n->block.cmds[i] = unroll_loop(o, cmd, i > 0 ? n->block.cmds[i - 1] : NULL);
+                }
+            }
+            break;
+        case NODE_IF:
+            unroll_stmt(o, n->ifnode.then_block);
+            unroll_stmt(o, n->ifnode.else_block);
+            break;
+        case NODE_WHILE:
+            unroll_stmt(o, n->whilenode.body);
+            break;
+        default:
+            break;
+    }
+}
+
+/* Common subexpressions. */
+
+/**
+ * @struct Cse
+ *
+ * @brief State of the common subexpression elimination.
+ *
+ * An available expression is kept as the address of the pointer to it in the AST, so its first evaluation can be
+ * wrapped in a NODE_TEMP when it is found again.
+ */
+typedef struct Cse {
+    Optimizer *o;
+    Node ***avail;  // Expressions whose value is known at the current point.
+    int count;
+    int capacity;
+    Node **slots;   // Expression saved in each temporary.
+    int slot_count;
+} Cse;
+
+/**
+ * @brief Returns the expression behind a temporary.
+ */
+static Node *cse_resolve(Cse *c, Node *e) {
+    while (e && e->type == NODE_TEMP) {
+        e = e->temp.expr ? e->temp.expr : c->slots[e->temp.slot];
+    }
+    return e;
+}
+
+static int same_name(const char *a, const char *b) {
+    if (!a || !b) return a == b;
+    return strcmp(a, b) == 0;
+}
+
+/**
+ * @brief Checks if two expressions always have the same value in the same state.
+ */
+static int same_expr(Cse *c, Node *a, Node *b) {
+    a = cse_resolve(c, a);
+    b = cse_resolve(c, b);
+    if (a == b) return 1;
+    if (!a || !b || a->type != b->type) return 0;
+
+    switch (a->type) {
+        case NODE_INT:
+            return a->intval == b->intval;
+        case NODE_REAL:
+            return memcmp(&a->realval, &b->realval, sizeof(double)) == 0;
+        case NODE_VAR:
+            if (strcmp(a->var.name, b->var.name) != 0 || a->var.index.type != b->var.index.type) return 0;
+            if (a->var.index.type == INTEGER) return a->var.index.value.integer == b->var.index.value.integer;
+            return same_name(a->var.index.value.name, b->var.index.value.name);
+        case NODE_BINOP:
+            return a->binop.op == b->binop.op && same_expr(c, a->binop.left, b->binop.left)
+                && same_expr(c, a->binop.right, b->binop.right);
+        case NODE_RELOP:
+            return a->relop.op == b->relop.op && same_expr(c, a->relop.left, b->relop.left)
+                && same_expr(c, a->relop.right, b->relop.right);
+        case NODE_INTRINSIC:
+            return a->intrinsic.op == b->intrinsic.op && same_name(a->intrinsic.name, b->intrinsic.name)
+                && same_name(a->intrinsic.other, b->intrinsic.other);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Checks if an expression reads a variable.
+ */
+static int expr_reads(Cse *c, Node *e, const char *name) {
+    e = cse_resolve(c, e);
+    if (!e) return 0;
+
+    switch (e->type) {
+        case NODE_VAR:
+            return strcmp(e->var.name, name) == 0
+                || (e->var.index.type == VARIABLE && strcmp(e->var.index.value.name, name) == 0);
+        case NODE_BINOP:
+            return expr_reads(c, e->binop.left, name) || expr_reads(c, e->binop.right, name);
+        case NODE_RELOP:
+            return expr_reads(c, e->relop.left, name) || expr_reads(c, e->relop.right, name);
+        case NODE_INTRINSIC:
+            return same_name(e->intrinsic.name, name) || same_name(e->intrinsic.other, name);
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Removes the available expressions that read a variable that was modified.
+ */
+static void cse_kill(Cse *c, const char *name) {
+    for (int i = 0; i < c->count; ) {
+        if (expr_reads(c, *c->avail[i], name)) {
+            c->avail[i] = c->avail[--c->count];
+        } else {
+            i++;
+        }
+    }
+}
+
+static void cse_kill_all(Cse *c, NameSet *names) {
+    for (int i = 0; i < names->count; i++) cse_kill(c, names->names[i]);
+}
+
+static int is_cse_candidate(Node *e) {
+    return e->type == NODE_VAR || e->type == NODE_BINOP || e->type == NODE_INTRINSIC;
+}
+
+/**
+ * @brief Replaces the expression at ref by a temporary if it is available, or makes it available.
+ */
+static void cse_expr(Cse *c, Node **ref) {
+    Node *e = *ref;
+    if (!e) return;
+
+    if (is_cse_candidate(e)) {
+        for (int i = 0; i < c->count; i++) {
+            Node **first = c->avail[i];
+            if (!same_expr(c, *first, e)) continue;
+
+            /* The first evaluation starts saving its value the first time it is reused. */
+            if ((*first)->type != NODE_TEMP) {
+                c->slots = (Node **)xrealloc(c->slots, sizeof(Node *) * (c->slot_count + 1));
+                c->slots[c->slot_count] = *first;
+                *first = make_temp(c->o->ctx, c->slot_count, *first);
+                c->slot_count++;
+            }
+
+            *ref = make_temp(c->o->ctx, (*first)->temp.slot, NULL);
+            free_node(e);
+            c->o->stats.reused_exprs++;
+            return;
+        }
+    }
+
+    /* Operands are evaluated before the operation, so they become available first. */
+    switch (e->type) {
+        case NODE_BINOP:
+            cse_expr(c, &e->binop.left);
+            cse_expr(c, &e->binop.right);
+            break;
+        case NODE_RELOP:
+            cse_expr(c, &e->relop.left);
+            cse_expr(c, &e->relop.right);
+            break;
+        default:
+            break;
+    }
+
+    if (is_cse_candidate(e)) {
+        if (c->count == c->capacity) {
+            c->capacity = c->capacity ? c->capacity * 2 : 16;
+            c->avail = (Node ***)xrealloc(c->avail, sizeof(Node **) * c->capacity);
+        }
+        c->avail[c->count++] = ref;
+    }
+}
+
+/**
+ * @brief Copies the available expressions (to restore them after a branch).
+ */
+static Node ***cse_save(Cse *c, int *count) {
+    *count = c->count;
+    if (!c->count) return NULL;
+
+    Node ***saved = (Node ***)xrealloc(NULL, sizeof(Node **) * c->count);
+    memcpy(saved, c->avail, sizeof(Node **) * c->count);
+    return saved;
+}
+
+static void cse_restore(Cse *c, Node ***saved, int count) {
+    /* The array never shrinks, so the saved expressions always fit. */
+    if (count) memcpy(c->avail, saved, sizeof(Node **) * count);
+    c->count = count;
+}
+
+static void cse_stmt(Cse *c, Node *n) {
+    if (!n) return;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+            for (int i = 0; i < n->block.count; i++) cse_stmt(c, n->block.cmds[i]);
+            break;
+        case NODE_DECL:
+            cse_kill(c, n->decl.name);
+            break;
+        case NODE_ASSIGN:
+            cse_expr(c, &n->assign.expr);
+            cse_kill(c, n->assign.var->var.name);
+            break;
+        case NODE_WRITE:
+            cse_expr(c, &n->writenode.var);
+            break;
+        case NODE_READ:
+            cse_kill(c, n->readnode.var->var.name);
+            break;
+        case NODE_LISTIO:
+            cse_expr(c, &n->listio.range.start);
+            cse_expr(c, &n->listio.range.end);
+            if (!n->listio.write) cse_kill(c, n->listio.name);
+            break;
+        case NODE_LISTOP:
+            cse_expr(c, &n->listop.expr);
+            cse_kill(c, n->listop.name);
+            break;
+        case NODE_IF:
+        {
+            /* Both branches start right after the condition; after the if, only what neither branch modified. */
+            cse_expr(c, &n->ifnode.cond);
+
+            int count;
+            Node ***saved = cse_save(c, &count);
+            cse_stmt(c, n->ifnode.then_block);
+            cse_restore(c, saved, count);
+            cse_stmt(c, n->ifnode.else_block);
+            cse_restore(c, saved, count);
+            free(saved);
+
+            NameSet defs = { NULL, 0, 0 };
+            add_defs(&defs, n);
+            cse_kill_all(c, &defs);
+            set_free(&defs);
+            break;
+        }
+        case NODE_WHILE:
+        {
+            /* The condition is also evaluated after the body, so only what the loop never modifies is kept. */
+            NameSet defs = { NULL, 0, 0 };
+            add_defs(&defs, n);
+            cse_kill_all(c, &defs);
+            set_free(&defs);
+
+            cse_expr(c, &n->whilenode.cond);
+
+            /* The body starts right after the condition, and the loop always ends right after it. */
+            int count;
+            Node ***saved = cse_save(c, &count);
+            cse_stmt(c, n->whilenode.body);
+            cse_restore(c, saved, count);
+            free(saved);
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+static void eliminate_common_subexpressions(Optimizer *o, Node *program) {
+    Cse c;
+    memset(&c, 0, sizeof(Cse));
+    c.o = o;
+
+    cse_stmt(&c, program);
+
+    free(c.avail);
+    free(c.slots);
+}
+
+Node *optimize(Context *ctx, Node *program) {
+    if (!program || program->type != NODE_BLOCK) return program;
+
+    Optimizer o;
+    memset(&o, 0, sizeof(Optimizer));
+    o.ctx = ctx;
+    optimizing = ctx;
+
+    /* Declarations are always at the start of the program, so their types are known before the algorithm. */
+    for (int i = 0; i < program->block.count; i++) {
+        Node *cmd = program->block.cmds[i];
+        if (cmd->type != NODE_DECL) continue;
+
+        o.decls = (Decl *)xrealloc(o.decls, sizeof(Decl) * (o.decl_count + 1));
+        o.decls[o.decl_count].name = cmd->decl.name;
+        o.decls[o.decl_count].type = cmd->decl.vartype;
+        o.decl_count++;
+    }
+
+    NameSet init = { NULL, 0, 0 };
+    mark_safe(&o, program, &init);
+    set_free(&init);
+
+    NameSet live = { NULL, 0, 0 };
+    sweep(&o, program, &live, 1);
+    set_free(&live);
+
+    unroll_stmt(&o, program);
+
+    /* The decls array points to the names of the declarations, so it must be released before removing them. */
+    free(o.decls);
+    o.decls = NULL;
+    o.decl_count = 0;
+    remove_unused_decls(&o, program);
+
+    free(o.safe.slots);
+
+    eliminate_common_subexpressions(&o, program);
+
+    ctx->stats.opt.dead_decls += o.stats.dead_decls;
+    ctx->stats.opt.dead_stores += o.stats.dead_stores;
+    ctx->stats.opt.dead_branches += o.stats.dead_branches;
+    ctx->stats.opt.unrolled_loops += o.stats.unrolled_loops;
+    ctx->stats.opt.reused_exprs += o.stats.reused_exprs;
+    return program;
+}
@@ -0,0 +1,61 @@
+#ifndef OPTIMIZER_H
+#define OPTIMIZER_H
+
+#include "ast.h"
+
+/* Copies of the body of a counted loop in the unrolled loop (see optimize()), unless --unroll says otherwise. */
+#define OPT_UNROLL_FACTOR 4
+
+/* Nodes that the copies of the body of an unrolled loop can have at most. */
+#define OPT_UNROLL_BUDGET 64
+
+/* Iterations that a loop from a constant to a constant can have at most to be replaced by copies of its body. */
+#define OPT_UNROLL_FULL_TRIPS 8
+
+/**
+ * @struct OptStats
+ *
+ * @brief Counters of the nodes removed by the optimizer.
+ */
+typedef struct OptStats {
+    int dead_decls;     // Declarations of variables that are never referenced.
+    int dead_stores;    // Assignments whose value is overwritten before being read.
+    int dead_branches;  // Ifs and whiles removed because of a constant condition or empty body.
+    int unrolled_loops; // Counted loops unrolled, or replaced by copies of their body.
+    int reused_exprs;   // Repeated expressions and loads replaced by the value saved in a temporary.
+} OptStats;
+
+/**
+ * @brief Removes dead code from the program, and then common subexpressions.
+ *
+ * Uses a liveness analysis to remove assignments whose value is never read, declarations of variables that are
+ * never referenced, and branches that can never be executed.
+ *
+ * Statements with observable effects are always kept: reads, writes, and any expression that may fail at runtime
+ * (undeclared or uninitialized variables, list accesses and integer divisions by anything but a constant other than 0
+ * and -1, since the smallest integer divided by -1 traps too).
+ *
+ * Then, counted loops (an integer compared with a constant or with an integer that the loop does not modify, and
+ * stepped by a constant at the end of the body) without other loops inside are unrolled: their body is copied
+ * ctx->unroll_factor times, in a loop that only runs when all the copies would run, followed by the original loop
+ * for the remaining iterations. A loop that starts from a constant right before it, and has a few iterations, is
+ * replaced by one copy of its body per iteration. The copies are limited to OPT_UNROLL_BUDGET nodes. The unrolled
+ * loop records its copies (whilenode.copies) and the replacement block its iterations (block.iterations), so the
+ * budget still counts the iterations of the source.
+ *
+ * Then, an expression (variable or list load, arithmetic or list intrinsic) that is evaluated again without any of
+ * its variables being modified in between is replaced by a NODE_TEMP that reads the value saved by the first
+ * evaluation. Values are only reused along straight-line code: a loop keeps what it never modifies, and after an if
+ * only what neither branch modifies is kept.
+ *
+ * A failed allocation is reported with context_error(), after which the program may be half rewritten and must not
+ * be used or freed (see context_optimize()).
+ *
+ * @param ctx Compilation context (the counters are accumulated in ctx->stats.opt).
+ * @param program Node of type NODE_BLOCK with the whole program (declarations followed by the algorithm).
+ *
+ * @return The optimized program.
+ */
+Node *optimize(Context *ctx, Node *program);
+
+#endif // OPTIMIZER_H
@@ -0,0 +1,198 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include "perf.h"
+
+int perf_sampling = 0;
+__thread int perf_node_kind = NODE_COUNT;
+
+const char *perf_counter_names[PERF_COUNTER_COUNT] = { "cycles", "instructions", "cache-misses", "branch-misses" };
+
+static const uint64_t counter_configs[PERF_COUNTER_COUNT] = {
+    PERF_COUNT_HW_CPU_CYCLES,
+    PERF_COUNT_HW_INSTRUCTIONS,
+    PERF_COUNT_HW_CACHE_MISSES,
+    PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+/* Counters being sampled by this thread (the signal is delivered to the thread that opened them). */
+static __thread PerfCounters *sampler = NULL;
+
+/**
+ * @brief Opens a counter of the calling thread.
+ *
+ * @param period Sampling period (0: only counting).
+ * @param group Leader of the group the counter joins (-1: the counter leads a new group).
+ *
+ * @return The file descriptor, or -1 (errno is set).
+ */
+static int open_counter(uint32_t type, uint64_t config, uint64_t period, int group) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    if (period) {
+        attr.disabled = 1;
+        attr.sample_period = period;
+        attr.wakeup_events = 1;
+    } else {
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    }
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group, PERF_FLAG_FD_CLOEXEC);
+}
+
+/**
+ * @brief Reads every counter of the group with a single read().
+ *
+ * @param values Receives the value of each available counter.
+ * @param times Receives the time the group was enabled and the time it was running (counting).
+ */
+static void read_group(PerfCounters *p, uint64_t values[PERF_COUNTER_COUNT], uint64_t times[2]) {
+    /* Layout of PERF_FORMAT_GROUP with both times: number of counters, enabled, running, then the values. */
+    uint64_t data[3 + PERF_COUNTER_COUNT];
+    memset(values, 0, PERF_COUNTER_COUNT * sizeof(uint64_t));
+    times[0] = times[1] = 0;
+
+    ssize_t size = read(p->leader, data, sizeof(data));
+    if (size < (ssize_t)(3 * sizeof(uint64_t)) || size < (ssize_t)((3 + data[0]) * sizeof(uint64_t))) return;
+
+    times[0] = data[1];
+    times[1] = data[2];
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (p->fds[i] >= 0) values[i] = data[3 + p->slots[i]];
+    }
+}
+
+/**
+ * @brief Attributes a sample to the node being evaluated, and rearms the counter for the next one.
+ */
+static void on_sample(int signal, siginfo_t *info, void *context) {
+    (void)signal;
+    (void)context;
+
+    PerfCounters *p = sampler;
+    if (!p || info->si_fd != p->sample_fd) return;
+
+    int saved = errno;
+    p->samples[perf_node_kind]++;
+    ioctl(p->sample_fd, PERF_EVENT_IOC_REFRESH, 1);
+    errno = saved;
+}
+
+/**
+ * @brief Opens the sampling counter, which sends SIGPROF to this thread on every overflow.
+ *
+ * @return 1 if OK, 0 otherwise (p->sample_error is set).
+ */
+static int start_sampling(PerfCounters *p) {
+    p->sample_event = "cycles";
+    p->sample_period = PERF_SAMPLE_CYCLES;
+    p->sample_fd = open_counter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES, p->sample_period, -1);
+    if (p->sample_fd < 0) {
+        p->sample_event = "task-clock";
+        p->sample_period = PERF_SAMPLE_NANOSECONDS;
+        p->sample_fd = open_counter(PERF_TYPE_SOFTWARE, PERF_COUNT_SW_TASK_CLOCK, p->sample_period, -1);
+    }
+    if (p->sample_fd < 0) {
+        p->sample_error = errno;
+        return 0;
+    }
+
+    /* Interrupted reads and writes are restarted, so LEIA and ESCREVA are not affected by the samples. */
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_sigaction = on_sample;
+    action.sa_flags = SA_SIGINFO | SA_RESTART;
+    sigemptyset(&action.sa_mask);
+
+    struct f_owner_ex owner = { F_OWNER_TID, (pid_t)syscall(SYS_gettid) };
+    if (sigaction(SIGPROF, &action, NULL) != 0 || fcntl(p->sample_fd, F_SETFL, O_ASYNC | O_NONBLOCK) != 0
+        || fcntl(p->sample_fd, F_SETSIG, SIGPROF) != 0 || fcntl(p->sample_fd, F_SETOWN_EX, &owner) != 0) {
+        p->sample_error = errno;
+        close(p->sample_fd);
+        p->sample_fd = -1;
+        return 0;
+    }
+
+    sampler = p;
+    perf_sampling = 1;
+    return 1;
+}
+
+PerfCounters *perf_create(int sampling) {
+    PerfCounters *p = (PerfCounters *)calloc(1, sizeof(PerfCounters));
+    if (!p) return NULL;
+
+    /* The first counter that opens leads the group, and the others join it. */
+    p->leader = -1;
+    int members = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        p->fds[i] = open_counter(PERF_TYPE_HARDWARE, counter_configs[i], 0, p->leader);
+        if (p->fds[i] < 0) {
+            p->errors[i] = errno;
+            continue;
+        }
+        if (p->leader < 0) p->leader = p->fds[i];
+        p->slots[i] = members++;
+    }
+
+    p->sample_fd = -1;
+    if (sampling) start_sampling(p);
+    return p;
+}
+
+void perf_phase_start(PerfCounters *p, Phase phase) {
+    if (!p) return;
+
+    if (p->leader >= 0) read_group(p, p->start[phase], p->start_times[phase]);
+    if (phase == PHASE_EXECUTE && p->sample_fd >= 0) {
+        perf_node_kind = NODE_COUNT;    // A runtime error can leave the previous execution inside a node.
+        ioctl(p->sample_fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(p->sample_fd, PERF_EVENT_IOC_REFRESH, 1);
+    }
+}
+
+void perf_phase_end(PerfCounters *p, Phase phase) {
+    if (!p) return;
+
+    if (phase == PHASE_EXECUTE && p->sample_fd >= 0) ioctl(p->sample_fd, PERF_EVENT_IOC_DISABLE, 0);
+    if (p->leader < 0) return;
+
+    uint64_t values[PERF_COUNTER_COUNT], times[2];
+    read_group(p, values, times);
+    uint64_t enabled = times[0] - p->start_times[phase][0];
+    uint64_t running = times[1] - p->start_times[phase][1];
+    p->enabled[phase] += enabled;
+    p->running[phase] += running;
+
+    /* While other groups of the machine had the counters, this one did not count: the count is scaled to the time. */
+    double scale = running ? (double)enabled / running : 0.0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (p->fds[i] >= 0) p->counts[phase][i] += (uint64_t)((values[i] - p->start[phase][i]) * scale + 0.5);
+    }
+}
+
+void perf_free(PerfCounters *p) {
+    if (!p) return;
+
+    if (p->sample_fd >= 0) {
+        ioctl(p->sample_fd, PERF_EVENT_IOC_DISABLE, 0);
+        sampler = NULL;
+        perf_sampling = 0;
+        close(p->sample_fd);
+    }
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (p->fds[i] >= 0) close(p->fds[i]);
+    }
+    free(p);
+}
@@ -0,0 +1,103 @@
+#ifndef PERF_H
+#define PERF_H
+
+#include <stdint.h>
+#include "stats.h"
+
+/* Sampling period of the cycles counter. */
+#define PERF_SAMPLE_CYCLES 1000000
+
+/* Sampling period of the task clock, in nanoseconds (used when the cycles counter is unavailable). */
+#define PERF_SAMPLE_NANOSECONDS 100000
+
+/**
+ * @enum PerfCounter
+ *
+ * @brief Hardware counters read for each phase.
+ */
+typedef enum PerfCounter {
+    PERF_CYCLES,
+    PERF_INSTRUCTIONS,
+    PERF_CACHE_MISSES,
+    PERF_BRANCH_MISSES,
+    PERF_COUNTER_COUNT,
+} PerfCounter;
+
+/**
+ * @struct PerfCounters
+ *
+ * @brief Counters of the thread that runs the phases (Linux perf_event_open()), counting only user space.
+ *
+ * The counters are opened as one group, so they are read with a single read() at each phase boundary and are
+ * scheduled on the PMU together. The ones the machine does not have (in a virtual machine, or when perf_event_paranoid
+ * forbids them) are left out of the group and reported as unavailable, and the others still work. When the kernel
+ * multiplexes the group with other events, the counts of a phase are scaled by the time the group was enabled over the
+ * time it was running, and the report tells that they are estimates.
+ *
+ * In sampling mode, the execution is interrupted every PERF_SAMPLE_CYCLES cycles (or PERF_SAMPLE_NANOSECONDS of CPU
+ * time, if there is no cycles counter), and each sample is attributed to the type of the node being evaluated.
+ */
+typedef struct PerfCounters {
+    int fds[PERF_COUNTER_COUNT];                        // -1 if unavailable.
+    int errors[PERF_COUNTER_COUNT];                     // errno of perf_event_open() for the unavailable ones.
+    int leader;                                         // First available counter (-1 if none).
+    int slots[PERF_COUNTER_COUNT];                      // Position of each available counter in the group.
+    uint64_t start[PHASE_COUNT][PERF_COUNTER_COUNT];
+    uint64_t start_times[PHASE_COUNT][2];               // Time enabled and running at the start of the phase.
+    uint64_t counts[PHASE_COUNT][PERF_COUNTER_COUNT];   // Scaled to the time the group was enabled.
+    uint64_t enabled[PHASE_COUNT];                      // Nanoseconds the group was enabled in the phase.
+    uint64_t running[PHASE_COUNT];                      // Nanoseconds it was counting (less if multiplexed).
+
+    int sample_fd;                                      // -1 if not sampling.
+    int sample_error;                                   // errno if sampling was requested and is unavailable.
+    const char *sample_event;                           // "cycles" or "task-clock".
+    uint64_t sample_period;
+    unsigned long long samples[NODE_COUNT + 1];         // By NodeType; the last one is outside any node.
+} PerfCounters;
+
+/**
+ * @brief Nonzero while samples are attributed to node types (checked by eval_node() and execute_node()).
+ */
+extern int perf_sampling;
+
+/**
+ * @brief Type of the node being evaluated by this thread (NODE_COUNT outside any node).
+ */
+extern __thread int perf_node_kind;
+
+/* Names of the counters, as reported. */
+extern const char *perf_counter_names[PERF_COUNTER_COUNT];
+
+/**
+ * @brief Opens the counters for the calling thread.
+ *
+ * @param sampling 1 to also sample the execution by node type.
+ *
+ * @return The counters (possibly all unavailable), or NULL if there is no memory.
+ */
+PerfCounters *perf_create(int sampling);
+
+/**
+ * @brief Reads the counters at the start of a phase (sampling starts with PHASE_EXECUTE).
+ *
+ * @param p Counters (can be NULL).
+ * @param phase Phase.
+ */
+void perf_phase_start(PerfCounters *p, Phase phase);
+
+/**
+ * @brief Adds what was counted since perf_phase_start() to the phase.
+ *
+ * @param p Counters (can be NULL).
+ * @param phase Phase.
+ */
+void perf_phase_end(PerfCounters *p, Phase phase);
+
+/**
+ * @brief Closes the counters, and frees them.
+ *
+ * @param p Counters (can be NULL).
+ */
+void perf_free(PerfCounters *p);
+
+#endif // PERF_H
@@ -0,0 +1,302 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include "pipeio.h"
+
+#define RING_SIZE (1 << 20)     // Must be a power of 2.
+#define CHUNK 65536
+
+/**
+ * @struct Ring
+ *
+ * @brief Single-producer/single-consumer byte ring.
+ *
+ * Each side only writes its own index, so the transfer itself takes no lock. The mutex and the condition are only
+ * used to sleep when the ring is empty (consumer) or full (producer); the other side only takes the mutex to wake it
+ * when someone is waiting.
+ */
+typedef struct Ring {
+    unsigned char *data;
+    atomic_size_t head;     // Total of bytes read (written by the consumer).
+    atomic_size_t tail;     // Total of bytes written (written by the producer).
+    atomic_int closed;      // No more bytes will be transferred.
+    atomic_int waiting;     // Number of sides sleeping.
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} Ring;
+
+struct PipelinedIo {
+    int in_fd;
+    int out_fd;
+    int stop_pipe[2];       // Wakes the reader thread when it is waiting for input.
+    Ring in_ring;
+    Ring out_ring;
+    unsigned char *read_chunk;
+    unsigned char *write_chunk;
+    FILE *in;
+    FILE *out;
+    pthread_t reader;
+    pthread_t writer;
+    atomic_int write_failed;
+};
+
+/**
+ * @brief Initializes the ring (it can always be destroyed afterwards, even if this fails).
+ *
+ * @return Returns 1 if OK, and 0 if there is no memory.
+ */
+static int ring_init(Ring *r) {
+    memset(r, 0, sizeof(Ring));
+    atomic_init(&r->head, 0);
+    atomic_init(&r->tail, 0);
+    atomic_init(&r->closed, 0);
+    atomic_init(&r->waiting, 0);
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->changed, NULL);
+
+    r->data = (unsigned char *)malloc(RING_SIZE);
+    return r->data != NULL;
+}
+
+static void ring_destroy(Ring *r) {
+    pthread_mutex_destroy(&r->lock);
+    pthread_cond_destroy(&r->changed);
+    free(r->data);
+}
+
+static void ring_wake(Ring *r) {
+    if (!atomic_load(&r->waiting)) return;
+
+    pthread_mutex_lock(&r->lock);
+    pthread_cond_broadcast(&r->changed);
+    pthread_mutex_unlock(&r->lock);
+}
+
+static void ring_close(Ring *r) {
+    atomic_store(&r->closed, 1);
+
+    pthread_mutex_lock(&r->lock);
+    pthread_cond_broadcast(&r->changed);
+    pthread_mutex_unlock(&r->lock);
+}
+
+/**
+ * @brief Sleeps until the ring has bytes to read (wait_space = 0) or space to write (wait_space = 1), or is closed.
+ */
+static void ring_wait(Ring *r, int wait_space) {
+    pthread_mutex_lock(&r->lock);
+    atomic_fetch_add(&r->waiting, 1);
+    for (;;) {
+        size_t used = atomic_load(&r->tail) - atomic_load(&r->head);
+        if (atomic_load(&r->closed) || (wait_space ? used < RING_SIZE : used > 0)) break;
+        pthread_cond_wait(&r->changed, &r->lock);
+    }
+    atomic_fetch_sub(&r->waiting, 1);
+    pthread_mutex_unlock(&r->lock);
+}
+
+/**
+ * @brief Writes all the bytes, waiting for space when the ring is full.
+ *
+ * @return Returns 1 if OK, and 0 if the ring was closed.
+ */
+static int ring_write(Ring *r, const unsigned char *buffer, size_t size) {
+    while (size) {
+        size_t tail = atomic_load_explicit(&r->tail, memory_order_relaxed);
+        size_t space = RING_SIZE - (tail - atomic_load_explicit(&r->head, memory_order_acquire));
+        if (atomic_load(&r->closed)) return 0;
+        if (!space) {
+            ring_wait(r, 1);
+            continue;
+        }
+
+        size_t n = size < space ? size : space;
+        size_t offset = tail & (RING_SIZE - 1);
+        size_t first = (RING_SIZE - offset) < n ? RING_SIZE - offset : n;
+        memcpy(r->data + offset, buffer, first);
+        memcpy(r->data, buffer + first, n - first);
+
+        atomic_store(&r->tail, tail + n);
+        ring_wake(r);
+        buffer += n;
+        size -= n;
+    }
+    return 1;
+}
+
+/**
+ * @brief Reads up to size bytes, waiting while the ring is empty.
+ *
+ * @return The number of bytes read, 0 when the ring is closed and empty.
+ */
+static size_t ring_read(Ring *r, unsigned char *buffer, size_t size) {
+    for (;;) {
+        size_t head = atomic_load_explicit(&r->head, memory_order_relaxed);
+        size_t used = atomic_load_explicit(&r->tail, memory_order_acquire) - head;
+        if (!used) {
+            if (atomic_load(&r->closed)) {
+                /* The producer may have written right before closing. */
+                if (atomic_load(&r->tail) == head) return 0;
+                continue;
+            }
+            ring_wait(r, 0);
+            continue;
+        }
+
+        size_t n = size < used ? size : used;
+        size_t offset = head & (RING_SIZE - 1);
+        size_t first = (RING_SIZE - offset) < n ? RING_SIZE - offset : n;
+        memcpy(buffer, r->data + offset, first);
+        memcpy(buffer + first, r->data, n - first);
+
+        atomic_store(&r->head, head + n);
+        ring_wake(r);
+        return n;
+    }
+}
+
+static void *reader_main(void *arg) {
+    PipelinedIo *p = (PipelinedIo *)arg;
+
+    for (;;) {
+        struct pollfd fds[2] = { { p->in_fd, POLLIN, 0 }, { p->stop_pipe[0], POLLIN, 0 } };
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        if (fds[1].revents) break;
+
+        ssize_t n = read(p->in_fd, p->read_chunk, CHUNK);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0 || !ring_write(&p->in_ring, p->read_chunk, (size_t)n)) break;
+    }
+
+    ring_close(&p->in_ring);
+    return NULL;
+}
+
+static void *writer_main(void *arg) {
+    PipelinedIo *p = (PipelinedIo *)arg;
+
+    size_t n;
+    while ((n = ring_read(&p->out_ring, p->write_chunk, CHUNK))) {
+        /* After a failure the output is only drained, so the program does not block. */
+        size_t done = 0;
+        while (done < n && !atomic_load(&p->write_failed)) {
+            ssize_t w = write(p->out_fd, p->write_chunk + done, n - done);
+            if (w < 0 && errno == EINTR) continue;
+            if (w <= 0) {
+                atomic_store(&p->write_failed, 1);
+                break;
+            }
+            done += (size_t)w;
+        }
+    }
+    return NULL;
+}
+
+static ssize_t cookie_read(void *cookie, char *buffer, size_t size) {
+    PipelinedIo *p = (PipelinedIo *)cookie;
+    return (ssize_t)ring_read(&p->in_ring, (unsigned char *)buffer, size);
+}
+
+static ssize_t cookie_write(void *cookie, const char *buffer, size_t size) {
+    PipelinedIo *p = (PipelinedIo *)cookie;
+    if (atomic_load(&p->write_failed)) return -1;
+    if (!ring_write(&p->out_ring, (const unsigned char *)buffer, size)) return -1;
+    return (ssize_t)size;
+}
+
+static void stop_reader(PipelinedIo *p) {
+    ring_close(&p->in_ring);
+    ssize_t r = write(p->stop_pipe[1], "", 1);
+    (void)r;
+    pthread_join(p->reader, NULL);
+}
+
+/**
+ * @brief Frees the pipeline (the threads must have been joined).
+ */
+static void release(PipelinedIo *p) {
+    ring_destroy(&p->in_ring);
+    ring_destroy(&p->out_ring);
+    free(p->read_chunk);
+    free(p->write_chunk);
+    close(p->stop_pipe[0]);
+    close(p->stop_pipe[1]);
+    free(p);
+}
+
+PipelinedIo *pipeio_start(int in_fd, int out_fd) {
+    PipelinedIo *p = (PipelinedIo *)calloc(1, sizeof(PipelinedIo));
+    if (!p) return NULL;
+
+    p->in_fd = in_fd;
+    p->out_fd = out_fd;
+    atomic_init(&p->write_failed, 0);
+
+    if (pipe(p->stop_pipe) != 0) {
+        free(p);
+        return NULL;
+    }
+
+    /* Both rings are always initialized, so release() can destroy them. */
+    int ready = ring_init(&p->in_ring) & ring_init(&p->out_ring);
+    p->read_chunk = (unsigned char *)malloc(CHUNK);
+    p->write_chunk = (unsigned char *)malloc(CHUNK);
+    if (ready && p->read_chunk && p->write_chunk) {
+        p->in = fopencookie(p, "r", (cookie_io_functions_t){ .read = cookie_read });
+        p->out = fopencookie(p, "w", (cookie_io_functions_t){ .write = cookie_write });
+    }
+    if (!p->in || !p->out) {
+        if (p->in) fclose(p->in);
+        if (p->out) fclose(p->out);
+        release(p);
+        return NULL;
+    }
+    setvbuf(p->out, NULL, _IOFBF, CHUNK);
+
+    if (pthread_create(&p->reader, NULL, reader_main, p) != 0) {
+        fclose(p->in);
+        fclose(p->out);
+        release(p);
+        return NULL;
+    }
+    if (pthread_create(&p->writer, NULL, writer_main, p) != 0) {
+        stop_reader(p);
+        fclose(p->in);
+        fclose(p->out);
+        release(p);
+        return NULL;
+    }
+    return p;
+}
+
+FILE *pipeio_in(PipelinedIo *p) {
+    return p->in;
+}
+
+FILE *pipeio_out(PipelinedIo *p) {
+    return p->out;
+}
+
+int pipeio_finish(PipelinedIo *p) {
+    /* All the output reaches the descriptor before this returns, as with the final flush of stdout. */
+    int ok = fclose(p->out) == 0;
+    ring_close(&p->out_ring);
+    pthread_join(p->writer, NULL);
+    if (atomic_load(&p->write_failed)) ok = 0;
+
+    /* The input that was read ahead and not used is discarded. */
+    stop_reader(p);
+    fclose(p->in);
+
+    release(p);
+    return ok;
+}
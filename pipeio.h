@@ -0,0 +1,53 @@
+#ifndef PIPEIO_H
+#define PIPEIO_H
+
+#include <stdio.h>
+
+/**
+ * @struct PipelinedIo
+ *
+ * @brief Input and output handled by dedicated threads (opaque).
+ *
+ * A reader thread prefetches the input into a single-producer/single-consumer ring, and a writer thread drains the
+ * output from another ring, so the thread that executes the program does not block on the read() and write()
+ * system calls. The bytes (and so LEIA, ESCREVA, LEIALISTA and ESCREVALISTA) are exactly the same as without it.
+ */
+typedef struct PipelinedIo PipelinedIo;
+
+/**
+ * @brief Starts the reader and writer threads.
+ *
+ * The input is read ahead, so it should not be used for anything else until pipeio_finish(). Anything still
+ * buffered in stdio for these descriptors must be flushed before.
+ *
+ * @param in_fd Descriptor the input is read from.
+ * @param out_fd Descriptor the output is written to.
+ *
+ * @return The pipeline, or NULL if it could not be started.
+ */
+PipelinedIo *pipeio_start(int in_fd, int out_fd);
+
+/**
+ * @brief Returns the stream that reads the prefetched input.
+ *
+ * @param p Pipeline.
+ */
+FILE *pipeio_in(PipelinedIo *p);
+
+/**
+ * @brief Returns the stream whose output is written by the writer thread.
+ *
+ * @param p Pipeline.
+ */
+FILE *pipeio_out(PipelinedIo *p);
+
+/**
+ * @brief Flushes the output, waits for the writer thread to write all of it, stops the reader and frees the pipeline.
+ *
+ * @param p Pipeline.
+ *
+ * @return Returns 1 if OK, and 0 if some output could not be written.
+ */
+int pipeio_finish(PipelinedIo *p);
+
+#endif // PIPEIO_H
@@ -0,0 +1,527 @@
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <pthread.h>
+#include "scanner.h"
+#include "context.h"
+#include "trace.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+    #include <immintrin.h>
+    #define SCANNER_X86
+#endif
+
+/* Zero bytes after the source, so the vector loads never go past the buffer and every run stops at the end. */
+#define SCANNER_PADDING 64
+
+struct FastScanner {
+    Context *ctx;
+    char *text;     // Source followed by SCANNER_PADDING zero bytes.
+    size_t length;  // Length of the source.
+    size_t pos;     // Start of the next token.
+};
+
+/* Classes of the first byte of a token. */
+enum { C_OTHER, C_SPACE, C_LETTER, C_DIGIT };
+
+static const unsigned char char_class[256] = {
+    [' '] = C_SPACE, ['\t'] = C_SPACE, ['\r'] = C_SPACE, ['\n'] = C_SPACE,
+    ['a' ... 'z'] = C_LETTER, ['A' ... 'Z'] = C_LETTER, ['_'] = C_LETTER,
+    ['0' ... '9'] = C_DIGIT,
+};
+
+static int is_letter(unsigned char c) { return char_class[c] == C_LETTER; }
+static int is_digit(unsigned char c) { return char_class[c] == C_DIGIT; }
+static int is_ident(unsigned char c) { return char_class[c] >= C_LETTER; }
+
+/**
+ * @struct ScanKernels
+ *
+ * @brief Functions that measure runs of bytes, for one instruction set.
+ *
+ * Runs of whitespace and identifiers stop at the first zero byte of the padding, and find() never returns more than
+ * end, so the vector versions may read up to 32 bytes past the source.
+ */
+typedef struct ScanKernels {
+    size_t (*space_run)(const char *p);                         // Bytes in [ \t\r\n].
+    size_t (*ident_run)(const char *p);                         // Bytes in [a-zA-Z0-9_].
+    size_t (*digit_run)(const char *p);                         // Bytes in [0-9].
+    const char *(*find)(const char *p, const char *end, char a, char b);  // First a or b before end (or end).
+} ScanKernels;
+
+/* Scalar kernels. */
+
+static size_t space_run_scalar(const char *p) {
+    size_t n = 0;
+    while (char_class[(unsigned char)p[n]] == C_SPACE) n++;
+    return n;
+}
+
+static size_t ident_run_scalar(const char *p) {
+    size_t n = 0;
+    while (is_ident((unsigned char)p[n])) n++;
+    return n;
+}
+
+static size_t digit_run_scalar(const char *p) {
+    size_t n = 0;
+    while (is_digit((unsigned char)p[n])) n++;
+    return n;
+}
+
+static const char *find_scalar(const char *p, const char *end, char a, char b) {
+    while (p < end && *p != a && *p != b) p++;
+    return p;
+}
+
+static const ScanKernels scalar_kernels = { space_run_scalar, ident_run_scalar, digit_run_scalar, find_scalar };
+
+#ifdef SCANNER_X86
+
+/*
+ * Bytes are classified with signed comparisons: x is in [lo, lo + n) when x - lo, moved to the signed range by adding
+ * 0x80, is less than n - 128. Letters are tested in lowercase (x | 0x20), which does not join any other byte to them.
+ */
+
+__attribute__((target("sse2")))
+static __m128i in_range_sse2(__m128i x, char lo, int n) {
+    __m128i shifted = _mm_add_epi8(x, _mm_set1_epi8((char)(0x80 - lo)));
+    return _mm_cmplt_epi8(shifted, _mm_set1_epi8((char)(n - 128)));
+}
+
+__attribute__((target("sse2")))
+static size_t space_run_sse2(const char *p) {
+    for (size_t n = 0;; n += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + n));
+        __m128i space = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8(' ')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\t'))),
+            _mm_or_si128(_mm_cmpeq_epi8(x, _mm_set1_epi8('\r')), _mm_cmpeq_epi8(x, _mm_set1_epi8('\n'))));
+        unsigned int other = ~(unsigned int)_mm_movemask_epi8(space) & 0xFFFF;
+        if (other) return n + (size_t)__builtin_ctz(other);
+    }
+}
+
+__attribute__((target("sse2")))
+static size_t ident_run_sse2(const char *p) {
+    for (size_t n = 0;; n += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + n));
+        __m128i letter = in_range_sse2(_mm_or_si128(x, _mm_set1_epi8(0x20)), 'a', 26);
+        __m128i ident = _mm_or_si128(_mm_or_si128(letter, in_range_sse2(x, '0', 10)),
+            _mm_cmpeq_epi8(x, _mm_set1_epi8('_')));
+        unsigned int other = ~(unsigned int)_mm_movemask_epi8(ident) & 0xFFFF;
+        if (other) return n + (size_t)__builtin_ctz(other);
+    }
+}
+
+__attribute__((target("sse2")))
+static size_t digit_run_sse2(const char *p) {
+    for (size_t n = 0;; n += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(p + n));
+        unsigned int other = ~(unsigned int)_mm_movemask_epi8(in_range_sse2(x, '0', 10)) & 0xFFFF;
+        if (other) return n + (size_t)__builtin_ctz(other);
+    }
+}
+
+__attribute__((target("sse2")))
+static const char *find_sse2(const char *p, const char *end, char a, char b) {
+    __m128i va = _mm_set1_epi8(a), vb = _mm_set1_epi8(b);
+    for (; p < end; p += 16) {
+        __m128i x = _mm_loadu_si128((const __m128i *)p);
+        unsigned int found = (unsigned int)_mm_movemask_epi8(
+            _mm_or_si128(_mm_cmpeq_epi8(x, va), _mm_cmpeq_epi8(x, vb)));
+        if (found) {
+            p += __builtin_ctz(found);
+            return p < end ? p : end;
+        }
+    }
+    return end;
+}
+
+static const ScanKernels sse2_kernels = { space_run_sse2, ident_run_sse2, digit_run_sse2, find_sse2 };
+
+/* AVX2 kernels (the same tests, 32 bytes at a time). */
+
+__attribute__((target("avx2")))
+static __m256i in_range_avx2(__m256i x, char lo, int n) {
+    __m256i shifted = _mm256_add_epi8(x, _mm256_set1_epi8((char)(0x80 - lo)));
+    return _mm256_cmpgt_epi8(_mm256_set1_epi8((char)(n - 128)), shifted);
+}
+
+__attribute__((target("avx2")))
+static size_t space_run_avx2(const char *p) {
+    for (size_t n = 0;; n += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + n));
+        __m256i blank = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8(' ')),
+            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\t')));
+        __m256i line = _mm256_or_si256(_mm256_cmpeq_epi8(x, _mm256_set1_epi8('\r')),
+            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('\n')));
+        __m256i space = _mm256_or_si256(blank, line);
+        unsigned int other = ~(unsigned int)_mm256_movemask_epi8(space);
+        if (other) return n + (size_t)__builtin_ctz(other);
+    }
+}
+
+__attribute__((target("avx2")))
+static size_t ident_run_avx2(const char *p) {
+    for (size_t n = 0;; n += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + n));
+        __m256i letter = in_range_avx2(_mm256_or_si256(x, _mm256_set1_epi8(0x20)), 'a', 26);
+        __m256i ident = _mm256_or_si256(_mm256_or_si256(letter, in_range_avx2(x, '0', 10)),
+            _mm256_cmpeq_epi8(x, _mm256_set1_epi8('_')));
+        unsigned int other = ~(unsigned int)_mm256_movemask_epi8(ident);
+        if (other) return n + (size_t)__builtin_ctz(other);
+    }
+}
+
+__attribute__((target("avx2")))
+static size_t digit_run_avx2(const char *p) {
+    for (size_t n = 0;; n += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(p + n));
+        unsigned int other = ~(unsigned int)_mm256_movemask_epi8(in_range_avx2(x, '0', 10));
+        if (other) return n + (size_t)__builtin_ctz(other);
+    }
+}
+
+__attribute__((target("avx2")))
+static const char *find_avx2(const char *p, const char *end, char a, char b) {
+    __m256i va = _mm256_set1_epi8(a), vb = _mm256_set1_epi8(b);
+    for (; p < end; p += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)p);
+        unsigned int found = (unsigned int)_mm256_movemask_epi8(
+            _mm256_or_si256(_mm256_cmpeq_epi8(x, va), _mm256_cmpeq_epi8(x, vb)));
+        if (found) {
+            p += __builtin_ctz(found);
+            return p < end ? p : end;
+        }
+    }
+    return end;
+}
+
+static const ScanKernels avx2_kernels = { space_run_avx2, ident_run_avx2, digit_run_avx2, find_avx2 };
+
+#endif // SCANNER_X86
+
+static const ScanKernels *kernels = NULL;
+static pthread_once_t kernels_once = PTHREAD_ONCE_INIT;
+
+static void select_kernels(void) {
+    const char *limit = getenv("SIMPLE_COMPILER_ISA");
+    kernels = &scalar_kernels;
+
+    #ifdef SCANNER_X86
+        __builtin_cpu_init();
+        int allow_sse2 = !limit || strcmp(limit, "scalar") != 0;
+        int allow_avx2 = allow_sse2 && (!limit || strcmp(limit, "sse2") != 0);
+
+        if (allow_avx2 && __builtin_cpu_supports("avx2")) {
+            kernels = &avx2_kernels;
+        } else if (allow_sse2 && __builtin_cpu_supports("sse2")) {
+            kernels = &sse2_kernels;
+        }
+    #else
+        (void)limit;
+    #endif
+}
+
+/* Keywords and dotted operators. */
+
+enum { V_NONE, V_TYPE, V_OPERAND, V_INTRINSIC };
+
+typedef struct Keyword {
+    const char *text;
+    int length;
+    int token;
+    int kind;   // Which field of the value is set (V_*).
+    int value;
+} Keyword;
+
+/*
+ * Perfect hash of the 39 keywords: the first 4 bytes, the last 4 bytes and the length are packed in 64 bits and
+ * multiplied by KEYWORD_MULTIPLIER, and the top 7 bits are the slot. The multiplier was found by a search that gives
+ * every keyword its own slot; if a keyword is added, search again and rebuild the table.
+ */
+#define KEYWORD_MULTIPLIER 0x0ee99416c402f4d9ull
+#define KEYWORD_SLOTS 128
+#define KEYWORD_MAX_LENGTH 12
+
+static const Keyword keywords[KEYWORD_SLOTS] = {
+    [  0] = { "LEIA", 4, LEIA, V_NONE, 0 },
+    [  8] = { ".DIF.", 5, DIF, V_OPERAND, R_DIF },
+    [ 14] = { ".MEI.", 5, MEI, V_OPERAND, R_MEI },
+    [ 20] = { "MEDIA", 5, MEDIA, V_INTRINSIC, I_MEDIA },
+    [ 29] = { "FIMENQ", 6, FIMENQ, V_NONE, 0 },
+    [ 33] = { "MINIMO", 6, MINIMO, V_INTRINSIC, I_MINIMO },
+    [ 35] = { "PREENCHE", 8, PREENCHE, V_INTRINSIC, I_PREENCHE },
+    [ 39] = { "POR", 3, POR, V_NONE, 0 },
+    [ 40] = { "PRODESCALAR", 11, PRODESCALAR, V_INTRINSIC, I_PRODESCALAR },
+    [ 43] = { ".MEQ.", 5, MEQ, V_OPERAND, R_MEQ },
+    [ 44] = { "INTEIRO", 7, INTEIRO, V_TYPE, T_INTEIRO },
+    [ 50] = { "DE", 2, DE, V_NONE, 0 },
+    [ 54] = { ".IGU.", 5, IGU, V_OPERAND, R_IGU },
+    [ 55] = { "ESCREVA", 7, ESCREVA, V_NONE, 0 },
+    [ 56] = { "SE", 2, SE, V_NONE, 0 },
+    [ 57] = { ".NAO.", 5, NAO, V_OPERAND, R_NAO },
+    [ 61] = { "LISTAREAL", 9, LISTAREAL, V_TYPE, T_LISTAREAL },
+    [ 68] = { "SENAO", 5, SENAO, V_NONE, 0 },
+    [ 74] = { "ESCALA", 6, ESCALA, V_INTRINSIC, I_ESCALA },
+    [ 79] = { "ATE", 3, ATE, V_NONE, 0 },
+    [ 81] = { "MAXIMO", 6, MAXIMO, V_INTRINSIC, I_MAXIMO },
+    [ 82] = { "LEIALISTA", 9, LEIALISTA, V_NONE, 0 },
+    [ 83] = { "PROGRAMA", 8, PROGRAMA, V_NONE, 0 },
+    [ 84] = { "REAL", 4, REAL, V_TYPE, T_REAL },
+    [ 87] = { "FIMSE", 5, FIMSE, V_NONE, 0 },
+    [ 88] = { "BINARIO", 7, BINARIO, V_NONE, 0 },
+    [ 94] = { ".MAI.", 5, MAI, V_OPERAND, R_MAI },
+    [ 97] = { "FIMPROG", 7, FIMPROG, V_NONE, 0 },
+    [ 98] = { "ESCREVALISTA", 12, ESCREVALISTA, V_NONE, 0 },
+    [100] = { ".OU.", 4, OU, V_OPERAND, R_OU },
+    [102] = { ".E.", 3, E, V_OPERAND, R_E },
+    [106] = { "LISTAINT", 8, LISTAINT, V_TYPE, T_LISTAINT },
+    [107] = { "ARQUIVO", 7, ARQUIVO, V_NONE, 0 },
+    [109] = { "ENQUANTO", 8, ENQUANTO, V_NONE, 0 },
+    [110] = { "FACA", 4, FACA, V_NONE, 0 },
+    [118] = { "COM", 3, COM, V_NONE, 0 },
+    [123] = { ".MAQ.", 5, MAQ, V_OPERAND, R_MAQ },
+    [125] = { "ENTAO", 5, ENTAO, V_NONE, 0 },
+    [127] = { "SOMA", 4, SOMA, V_INTRINSIC, I_SOMA },
+};
+
+/**
+ * @brief Reads n bytes (at most 4) as a little-endian number.
+ */
+static uint64_t load_bytes(const char *p, int n) {
+    uint64_t r = 0;
+    for (int i = n - 1; i >= 0; i--) r = (r << 8) | (unsigned char)p[i];
+    return r;
+}
+
+/**
+ * @brief Finds a keyword or dotted operator.
+ *
+ * @return The keyword, or NULL if the text is not one.
+ */
+static const Keyword *find_keyword(const char *p, int n) {
+    if (n > KEYWORD_MAX_LENGTH) return NULL;
+
+    int edge = n < 4 ? n : 4;
+    uint64_t first = load_bytes(p, edge);
+    uint64_t last = load_bytes(p + n - edge, edge) << (8 * (4 - edge));
+    uint64_t key = first ^ (last << 24) ^ ((uint64_t)n << 56);
+
+    const Keyword *k = &keywords[(key * KEYWORD_MULTIPLIER) >> 57];
+    if (k->length != n || memcmp(k->text, p, (size_t)n) != 0) return NULL;
+    return k;
+}
+
+/* Scanner. */
+
+/**
+ * @brief Records a match in the trace, as YY_USER_ACTION does in lexical.lex.
+ */
+static void trace_match(const char *p, size_t n) {
+    char text[9];
+    size_t copied = n < 8 ? n : 8;
+    memcpy(text, p, copied);
+    text[copied] = '\0';
+    trace_record(TRACE_LEXER, EV_TOKEN, (int64_t)n, text);
+}
+
+#define TRACE_MATCH(p, n) \
+    do { \
+        if (__builtin_expect(TRACE_ENABLED(TRACE_LEXER), 0)) trace_match((p), (n)); \
+    } while (0)
+
+/**
+ * @brief Converts a run of digits with atoi() or atof(), as the flex scanner does.
+ *
+ * The byte after the run is replaced by a terminator for the call (the source is a private copy).
+ */
+static int parse_int(char *p, size_t n) {
+    char saved = p[n];
+    p[n] = '\0';
+    int value = atoi(p);
+    p[n] = saved;
+    return value;
+}
+
+static double parse_real(char *p, size_t n) {
+    char saved = p[n];
+    p[n] = '\0';
+    double value = atof(p);
+    p[n] = saved;
+    return value;
+}
+
+FastScanner *fast_scanner_create(Context *ctx, FILE *in) {
+    FastScanner *s = (FastScanner *)calloc(1, sizeof(FastScanner));
+    if (!s) return NULL;
+    s->ctx = ctx;
+    pthread_once(&kernels_once, select_kernels);
+
+    size_t capacity = 0;
+    for (;;) {
+        if (s->length + 65536 + SCANNER_PADDING > capacity) {
+            capacity = capacity ? capacity * 2 : 65536 + SCANNER_PADDING;
+            char *grown = (char *)realloc(s->text, capacity);
+            if (!grown) {
+                fast_scanner_free(s);
+                return NULL;
+            }
+            s->text = grown;
+        }
+
+        size_t read = fread(s->text + s->length, 1, capacity - s->length - SCANNER_PADDING, in);
+        s->length += read;
+        if (read == 0) break;
+    }
+
+    if (ferror(in)) {
+        fast_scanner_free(s);
+        return NULL;
+    }
+    memset(s->text + s->length, 0, SCANNER_PADDING);
+    return s;
+}
+
+void fast_scanner_free(FastScanner *s) {
+    if (!s) return;
+    free(s->text);
+    free(s);
+}
+
+/**
+ * @brief Matches an identifier, a keyword or a list declaration (name[size] or name[variable]).
+ *
+ * @return The token, and the number of bytes matched in *matched.
+ */
+static int lex_word(char *p, YYSTYPE *lvalp, size_t *matched) {
+    size_t n = kernels->ident_run(p);
+
+    /* The list rules match more than the identifier alone, so they win even over keywords. */
+    if (p[n] == '[') {
+        char *inside = p + n + 1;
+        size_t size = is_digit((unsigned char)*inside) ? kernels->digit_run(inside) : 0;
+        size_t var = is_letter((unsigned char)*inside) ? kernels->ident_run(inside) : 0;
+        size_t m = size ? size : var;
+
+        if (m && inside[m] == ']') {
+            lvalp->flex.name = strndup(p, n);
+            lvalp->flex.length = size ? parse_int(inside, size) : 0;
+            lvalp->flex.variable = size ? NULL : strndup(inside, var);
+            *matched = n + m + 2;
+            return VAR_NAME;
+        }
+    }
+
+    *matched = n;
+    const Keyword *k = find_keyword(p, (int)n);
+    if (k) {
+        if (k->kind == V_TYPE) lvalp->type = (Types)k->value;
+        else if (k->kind == V_INTRINSIC) lvalp->intrinsic = (Intrinsic)k->value;
+        return k->token;
+    }
+
+    lvalp->flex.name = strndup(p, n);
+    lvalp->flex.length = 0;
+    lvalp->flex.variable = NULL;
+    return VAR_NAME;
+}
+
+int fast_scanner_lex(FastScanner *s, YYSTYPE *lvalp) {
+    const char *end = s->text + s->length;
+
+    while (s->pos < s->length) {
+        char *p = s->text + s->pos;
+        unsigned char c = (unsigned char)*p;
+        size_t n = 0;
+        int token = -1;
+
+        switch (char_class[c]) {
+            case C_SPACE:
+                n = kernels->space_run(p);
+                break;
+
+            case C_LETTER:
+                token = lex_word(p, lvalp, &n);
+                break;
+
+            case C_DIGIT:
+                n = kernels->digit_run(p);
+                if (p[n] == '.' && is_digit((unsigned char)p[n + 1])) {
+                    n += 1 + kernels->digit_run(p + n + 1);
+                    lvalp->real = parse_real(p, n);
+                    token = N_REAL;
+                } else {
+                    lvalp->integer = parse_int(p, n);
+                    token = N_INT;
+                }
+                break;
+
+            default:
+                n = 0;
+                if (c == '{' || c == '"') {
+                    /* Comments and strings end on the same line. */
+                    const char *close = kernels->find(p + 1, end, c == '{' ? '}' : '"', '\n');
+                    if (close < end && *close != '\n') {
+                        n = (size_t)(close - p) + 1;
+                        if (c == '"') {
+                            lvalp->string = strndup(p + 1, n - 2);
+                            token = STRING;
+                        }
+                    }
+                } else if (c == '.') {
+                    size_t letters = kernels->ident_run(p + 1);
+                    const Keyword *k = p[letters + 1] == '.' ? find_keyword(p, (int)letters + 2) : NULL;
+                    if (k) {
+                        n = letters + 2;
+                        lvalp->operand = (RelOp)k->value;
+                        token = k->token;
+                    }
+                } else if (c == ':' && p[1] == '=') {
+                    n = 2;
+                    token = ATRIB;
+                } else if (c && strchr("+-*/,()", c)) {
+                    n = 1;
+                    token = c;
+                }
+
+                /* As the last rule of lexical.lex, any other byte is an error. */
+                if (n == 0) {
+                    TRACE_MATCH(p, 1);
+                    scanner_invalid_char(s->ctx, (unsigned char)c);
+                }
+        }
+
+        TRACE_MATCH(p, n);
+        s->pos += n;
+        if (token >= 0) return token;
+    }
+
+    return 0;
+}
+
+void scanner_invalid_char(Context *ctx, unsigned char c) {
+    if (c >= ' ' && c < 127) context_error(ctx, "An error has occurred: invalid character '%c'.", c);
+    context_error(ctx, "An error has occurred: invalid character '\\x%02x'.", c);
+}
+
+const char *scanner_token_name(int token) {
+    #define NAME(t) case t: return #t;
+    switch (token) {
+        NAME(PROGRAMA) NAME(FIMPROG) NAME(ATRIB) NAME(LEIA) NAME(ESCREVA) NAME(SE) NAME(ENTAO) NAME(SENAO)
+        NAME(FIMSE) NAME(ENQUANTO) NAME(FACA) NAME(FIMENQ) NAME(LEIALISTA) NAME(ESCREVALISTA) NAME(DE) NAME(ATE)
+        NAME(BINARIO) NAME(ARQUIVO) NAME(COM) NAME(POR) NAME(N_INT) NAME(N_REAL) NAME(STRING) NAME(NAO) NAME(MAQ)
+        NAME(MAI) NAME(MEQ) NAME(MEI) NAME(IGU) NAME(DIF) NAME(OU) NAME(E) NAME(INTEIRO) NAME(REAL) NAME(LISTAINT)
+        NAME(LISTAREAL) NAME(SOMA) NAME(MEDIA) NAME(MINIMO) NAME(MAXIMO) NAME(PRODESCALAR) NAME(PREENCHE)
+        NAME(ESCALA) NAME(VAR_NAME)
+        case '+': return "'+'";
+        case '-': return "'-'";
+        case '*': return "'*'";
+        case '/': return "'/'";
+        case ',': return "','";
+        case '(': return "'('";
+        case ')': return "')'";
+        default: return "?";
+    }
+    #undef NAME
+}
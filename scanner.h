@@ -0,0 +1,73 @@
+#ifndef SCANNER_H
+#define SCANNER_H
+
+#include <stdio.h>
+#include "ast.h"
+#include "types.h"
+#include "bison.tab.h"
+
+/* Compilation context (see context.h). */
+typedef struct Context Context;
+
+/**
+ * @struct FastScanner
+ *
+ * @brief Hand-written scanner, an alternative to the one generated by flex (lexical.lex).
+ *
+ * The whole source is read to memory, so runs of whitespace, identifiers, comments and strings are measured 16 or 32
+ * bytes at a time with SSE2 or AVX2 (chosen on the first use, and limited by SIMPLE_COMPILER_ISA as in kernels.h).
+ * Keywords and the dotted operators are found with a perfect hash computed when the compiler is built.
+ *
+ * It returns exactly the same tokens and values as the flex scanner, including the longest match rules (LEIA[3] is
+ * a list and not a keyword), the invalid character errors and the lexer trace events.
+ */
+typedef struct FastScanner FastScanner;
+
+/**
+ * @brief Creates a scanner with the whole content of a file.
+ *
+ * @param ctx Context (errors are reported with context_error()).
+ * @param in Source of the program (read until the end).
+ *
+ * @return The scanner, or NULL if there is no memory or the file could not be read.
+ */
+FastScanner *fast_scanner_create(Context *ctx, FILE *in);
+
+/**
+ * @brief Returns the next token (the same interface as yylex() of the flex scanner).
+ *
+ * @param s Scanner.
+ * @param lvalp Where the value of the token is stored.
+ *
+ * @return Token, or 0 at the end of the input.
+ */
+int fast_scanner_lex(FastScanner *s, YYSTYPE *lvalp);
+
+/**
+ * @brief Frees the scanner and its copy of the source.
+ *
+ * @param s Scanner (can be NULL).
+ */
+void fast_scanner_free(FastScanner *s);
+
+/**
+ * @brief Reports a byte that starts no token, with context_error(), for both scanners.
+ *
+ * The parse fails with the message, instead of skipping the byte, so a library call does not succeed with a part of
+ * the source left out.
+ *
+ * @param ctx Context.
+ * @param c The byte.
+ */
+void scanner_invalid_char(Context *ctx, unsigned char c) __attribute__((noreturn));
+
+/**
+ * @brief Returns the name of a token, as declared in bison.y.
+ *
+ * @param token Token returned by one of the scanners.
+ *
+ * @return The name, or "?" for an unknown token.
+ */
+const char *scanner_token_name(int token);
+
+#endif // SCANNER_H
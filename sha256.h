@@ -0,0 +1,47 @@
+#ifndef SHA256_H
+#define SHA256_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Size of a digest, in bytes. */
+#define SHA256_SIZE 32
+
+/**
+ * @struct Sha256
+ *
+ * @brief State of a SHA-256 (FIPS 180-4) over bytes given in pieces.
+ *
+ * Used where a 64-bit hash is not enough: the key of a result shared by other processes must not collide.
+ */
+typedef struct Sha256 {
+    uint32_t state[8];
+    uint64_t length;            // Bytes given so far.
+    unsigned char block[64];    // Bytes of the current block (length % 64 of them).
+} Sha256;
+
+/**
+ * @brief Starts a digest.
+ *
+ * @param s State.
+ */
+void sha256_init(Sha256 *s);
+
+/**
+ * @brief Adds bytes to a digest.
+ *
+ * @param s State.
+ * @param data Bytes.
+ * @param size Number of bytes.
+ */
+void sha256_update(Sha256 *s, const void *data, size_t size);
+
+/**
+ * @brief Finishes a digest.
+ *
+ * @param s State (must be started again to be reused).
+ * @param digest Receives the SHA256_SIZE bytes of the digest.
+ */
+void sha256_final(Sha256 *s, unsigned char digest[SHA256_SIZE]);
+
+#endif // SHA256_H
@@ -0,0 +1,128 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "simplecompiler.h"
+#include "context.h"
+
+struct SCProgram {
+    Context *ctx;   // Context of the compilation, owns the AST.
+};
+
+static void set_error(char *error, size_t error_size, const char *message) {
+    if (!error || error_size == 0) return;
+    snprintf(error, error_size, "%s", message);
+}
+
+static ssize_t io_read(void *cookie, char *buffer, size_t size) {
+    const SCIo *io = (const SCIo *)cookie;
+    if (!io->read) return 0;
+    return (ssize_t)io->read(io->user, buffer, size);
+}
+
+static ssize_t io_write(void *cookie, const char *buffer, size_t size) {
+    const SCIo *io = (const SCIo *)cookie;
+    if (!io->write) return (ssize_t)size;
+
+    size_t written = io->write(io->user, buffer, size);
+    return written < size ? -1 : (ssize_t)written;
+}
+
+SCStatus sc_compile(const char *source, size_t length, SCProgram **program, char *error, size_t error_size) {
+    if (!program) {
+        set_error(error, error_size, "sc_compile(): program must not be NULL");
+        return SC_ERROR_ARGUMENT;
+    }
+    *program = NULL;
+
+    if (!source || length == 0) {
+        set_error(error, error_size, "sc_compile(): empty source");
+        return SC_ERROR_ARGUMENT;
+    }
+
+    SCProgram *p = (SCProgram *)malloc(sizeof(SCProgram));
+    Context *ctx = context_create();
+    FILE *in = fmemopen((void *)source, length, "r");
+    if (!p || !ctx || !in) {
+        if (in) fclose(in);
+        context_free(ctx);
+        free(p);
+        set_error(error, error_size, "sc_compile(): out of memory");
+        return SC_ERROR_MEMORY;
+    }
+
+    int failed = context_parse(ctx, in);
+    fclose(in);
+
+    if (failed) {
+        set_error(error, error_size, ctx->error);
+        context_free(ctx);
+        free(p);
+        return SC_ERROR_SYNTAX;
+    }
+
+    if (context_optimize(ctx)) {
+        set_error(error, error_size, ctx->error);
+        context_free(ctx);
+        free(p);
+        return SC_ERROR_MEMORY;
+    }
+    p->ctx = ctx;
+    *program = p;
+    return SC_OK;
+}
+
+SCStatus sc_run(const SCProgram *program, const SCIo *io, char *error, size_t error_size) {
+    return sc_run_limited(program, io, NULL, error, error_size);
+}
+
+SCStatus sc_run_limited(const SCProgram *program, const SCIo *io, const SCLimits *limits, char *error,
+    size_t error_size) {
+    if (!program) {
+        set_error(error, error_size, "sc_run(): program must not be NULL");
+        return SC_ERROR_ARGUMENT;
+    }
+
+    static const SCIo no_io = { NULL, NULL, NULL };
+    if (!io) io = &no_io;
+
+    /* The AST is only read during the execution, so each run just needs its own variables. */
+    Context *run = context_create();
+    FILE *in = fopencookie((void *)io, "r", (cookie_io_functions_t){ .read = io_read });
+    FILE *out = fopencookie((void *)io, "w", (cookie_io_functions_t){ .write = io_write });
+    if (!run || !in || !out) {
+        if (in) fclose(in);
+        if (out) fclose(out);
+        context_free(run);
+        set_error(error, error_size, "sc_run(): out of memory");
+        return SC_ERROR_MEMORY;
+    }
+    run->in = in;
+    run->out = out;
+    if (limits) {
+        run->budget.max_iterations = limits->max_iterations;
+        run->budget.max_seconds = limits->max_seconds;
+        run->budget.max_list_bytes = limits->max_list_bytes;
+        run->budget.max_output_bytes = limits->max_output_bytes;
+    }
+
+    int failed = context_execute(run, program->ctx->program);
+
+    fclose(in);
+    if (fclose(out) != 0 && !failed) {
+        snprintf(run->error, sizeof(run->error), "sc_run(): write failed");
+        failed = 1;
+    }
+
+    if (failed) set_error(error, error_size, run->error);
+    SCStatus status = !failed ? SC_OK : (run->budget.exceeded ? SC_ERROR_LIMIT : SC_ERROR_RUNTIME);
+    context_free(run);
+    return status;
+}
+
+void sc_free(SCProgram *program) {
+    if (!program) return;
+
+    context_free(program->ctx);
+    free(program);
+}
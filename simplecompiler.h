@@ -0,0 +1,115 @@
+#ifndef SIMPLECOMPILER_H
+#define SIMPLECOMPILER_H
+
+#include <stddef.h>
+
+/**
+ * @brief Public interface of the library (libsimplecompiler.a and libsimplecompiler.so).
+ *
+ * A program is compiled once into a handle, which can be run many times, even by several threads at the same time.
+ * No function of the library exits the process: errors are returned as a status, with a message.
+ */
+
+/**
+ * @enum SCStatus
+ *
+ * @brief Result of the functions of the library.
+ */
+typedef enum SCStatus {
+    SC_OK = 0,
+    SC_ERROR_SYNTAX,    // The source is not a valid program.
+    SC_ERROR_RUNTIME,   // The program failed while running (undeclared variable, index out of range...).
+    SC_ERROR_MEMORY,    // There is not enough memory.
+    SC_ERROR_ARGUMENT,  // Invalid argument.
+    SC_ERROR_LIMIT,     // The run was stopped because it exceeded one of its limits (see SCLimits).
+} SCStatus;
+
+/**
+ * @struct SCProgram
+ *
+ * @brief Compiled program (opaque).
+ */
+typedef struct SCProgram SCProgram;
+
+/**
+ * @struct SCIo
+ *
+ * @brief Input and output of a run.
+ *
+ * The callbacks are used by LEIA, ESCREVA, LEIALISTA and ESCREVALISTA (files given with ARQUIVO are still opened by
+ * the program). A NULL read means an empty input, and a NULL write discards the output.
+ */
+typedef struct SCIo {
+    /* Copies up to size bytes of input to buffer, returning how many were copied (0 at the end of the input). */
+    size_t (*read)(void *user, char *buffer, size_t size);
+
+    /* Consumes size bytes of output, returning how many were consumed (less than size is an error). */
+    size_t (*write)(void *user, const char *buffer, size_t size);
+
+    /* Passed to the callbacks (state of the run). */
+    void *user;
+} SCIo;
+
+/**
+ * @struct SCLimits
+ *
+ * @brief Limits of a run (0 means unlimited).
+ *
+ * Iterations are checked on the back edges of the loops, so a program that never ends is stopped without stopping the
+ * thread that runs it. The time is watched by a timer that sends SIGRTMIN + 1 to the thread of the run (which must
+ * not block it), tested before each statement; the time spent in a read callback is noticed when it returns.
+ */
+typedef struct SCLimits {
+    unsigned long long max_iterations;      // Iterations of the loops, as written (the same with any unrolling).
+    double max_seconds;                     // Wall-clock time of the run.
+    unsigned long long max_list_bytes;      // Memory of the lists.
+    unsigned long long max_output_bytes;    // Bytes written to the output.
+} SCLimits;
+
+/**
+ * @brief Compiles a program.
+ *
+ * @param source Source of the program (does not need to end with '\0').
+ * @param length Length of the source, in bytes.
+ * @param program Where the handle is stored (NULL on error).
+ * @param error Buffer for the message of the error (can be NULL).
+ * @param error_size Size of the buffer.
+ *
+ * @return SC_OK, SC_ERROR_SYNTAX, SC_ERROR_MEMORY or SC_ERROR_ARGUMENT.
+ */
+SCStatus sc_compile(const char *source, size_t length, SCProgram **program, char *error, size_t error_size);
+
+/**
+ * @brief Runs a compiled program, with its own variables.
+ *
+ * @param program Compiled program.
+ * @param io Input and output of the run (NULL: no input, and the output is discarded).
+ * @param error Buffer for the message of the error (can be NULL).
+ * @param error_size Size of the buffer.
+ *
+ * @return SC_OK, SC_ERROR_RUNTIME, SC_ERROR_MEMORY or SC_ERROR_ARGUMENT.
+ */
+SCStatus sc_run(const SCProgram *program, const SCIo *io, char *error, size_t error_size);
+
+/**
+ * @brief Same as sc_run(), stopping the run if it exceeds a limit.
+ *
+ * @param program Compiled program.
+ * @param io Input and output of the run (NULL: no input, and the output is discarded).
+ * @param limits Limits of the run (NULL: no limits).
+ * @param error Buffer for the message of the error (can be NULL).
+ * @param error_size Size of the buffer.
+ *
+ * @return SC_OK, SC_ERROR_RUNTIME, SC_ERROR_LIMIT, SC_ERROR_MEMORY or SC_ERROR_ARGUMENT.
+ */
+SCStatus sc_run_limited(const SCProgram *program, const SCIo *io, const SCLimits *limits, char *error,
+    size_t error_size);
+
+/**
+ * @brief Frees a compiled program.
+ *
+ * @param program Compiled program (can be NULL).
+ */
+void sc_free(SCProgram *program);
+
+#endif // SIMPLECOMPILER_H
@@ -0,0 +1,267 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <sys/resource.h>
+#include "stats.h"
+#include "perf.h"
+
+static const char *phase_names[PHASE_COUNT] = { "lex", "parse", "optimize", "execute" };
+
+double stats_clock(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+static double cpu_clock(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return t.tv_sec + t.tv_nsec / 1e9;
+}
+
+void stats_enable(Stats *s, StatsFormat format) {
+    s->timing = 1;
+    s->format = format;
+    s->sample_state = 2463534242u;
+    s->next_timed = 2 + s->sample_state % 8;  // Soon, for short programs, but not the first token (see stats.h).
+
+    /* What a pair of clock readings adds to a timed token, taken out of the estimate of the lexing. */
+    s->clock_cost = 1.0;
+    for (int i = 0; i < 16; i++) {
+        double start = stats_clock();
+        double cost = stats_clock() - start;
+        if (cost < s->clock_cost) s->clock_cost = cost;
+    }
+}
+
+int stats_lex_sample(Stats *s) {
+    /* xorshift32; the gap is uniform in [1, 2 * LEX_SAMPLE_GAP - 1], so LEX_SAMPLE_GAP on average. */
+    uint32_t x = s->sample_state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    s->sample_state = x;
+    s->next_timed = s->tokens + 1 + x % (2 * LEX_SAMPLE_GAP - 1);
+    s->timed_tokens++;
+    return 1;
+}
+
+/**
+ * @brief Returns the factor from the timed tokens to all the tokens (see STATS_LEX_SAMPLED()).
+ */
+static double lex_scale(const Stats *s) {
+    return s->timed_tokens ? (double)s->tokens / s->timed_tokens : 0.0;
+}
+
+void phase_start(Stats *s, Phase phase) {
+    if (!s->timing) return;
+
+    s->running[phase] = 1;
+    s->wall_start[phase] = stats_clock();
+    s->cpu_start[phase] = cpu_clock();
+    perf_phase_start(s->perf, phase);
+}
+
+void phase_end(Stats *s, Phase phase) {
+    if (!s->timing || !s->running[phase]) return;
+
+    s->running[phase] = 0;
+    perf_phase_end(s->perf, phase);
+    s->wall[phase] += stats_clock() - s->wall_start[phase];
+    s->cpu[phase] += cpu_clock() - s->cpu_start[phase];
+}
+
+/**
+ * @brief Copies the counts of the phases, estimating the lexing from the timed tokens and taking it out of the parse
+ * (the scanner runs inside the parser).
+ */
+static void perf_counts(const Stats *s, uint64_t counts[PHASE_COUNT][PERF_COUNTER_COUNT]) {
+    const PerfCounters *p = s->perf;
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) counts[phase][i] = p->counts[phase][i];
+    }
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        uint64_t lex = (uint64_t)(counts[PHASE_LEX][i] * lex_scale(s));
+        counts[PHASE_LEX][i] = lex;
+        counts[PHASE_PARSE][i] = counts[PHASE_PARSE][i] > lex ? counts[PHASE_PARSE][i] - lex : 0;
+    }
+}
+
+/**
+ * @brief Returns the share of the time a phase was counted (below 1 if the kernel multiplexed the counters).
+ */
+static double running_share(const PerfCounters *p, Phase phase) {
+    return p->enabled[phase] ? (double)p->running[phase] / p->enabled[phase] : 1.0;
+}
+
+static void perf_report_json(const Stats *s, FILE *out) {
+    const PerfCounters *p = s->perf;
+    uint64_t counts[PHASE_COUNT][PERF_COUNTER_COUNT];
+    perf_counts(s, counts);
+
+    fprintf(out, ",\"perf\":{\"phases\":{");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        fprintf(out, "%s\"%s\":{", phase ? "," : "", phase_names[phase]);
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+            if (p->fds[i] >= 0) fprintf(out, "%s\"%s\":%llu", i ? "," : "", perf_counter_names[i],
+                (unsigned long long)counts[phase][i]);
+            else fprintf(out, "%s\"%s\":null", i ? "," : "", perf_counter_names[i]);
+        }
+        fprintf(out, "}");
+    }
+    fprintf(out, "},\"running\":{");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        fprintf(out, "%s\"%s\":%.4f", phase ? "," : "", phase_names[phase], running_share(p, (Phase)phase));
+    }
+    fprintf(out, "}");
+
+    if (p->sample_fd >= 0) {
+        fprintf(out, ",\"samples\":{\"event\":\"%s\",\"period\":%llu,\"nodes\":{", p->sample_event,
+            (unsigned long long)p->sample_period);
+        for (int t = 0; t < NODE_COUNT; t++) {
+            fprintf(out, "%s\"%s\":%llu", t ? "," : "", node_type_name((NodeType)t), p->samples[t]);
+        }
+        fprintf(out, "},\"other\":%llu}", p->samples[NODE_COUNT]);
+    }
+    fprintf(out, "}");
+}
+
+static void perf_report_counters(const Stats *s, FILE *out) {
+    const PerfCounters *p = s->perf;
+    uint64_t counts[PHASE_COUNT][PERF_COUNTER_COUNT];
+    perf_counts(s, counts);
+
+    fprintf(out, "%-10s", "phase");
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) fprintf(out, " %15s", perf_counter_names[i]);
+    fprintf(out, "\n");
+    for (int phase = 0; phase < PHASE_COUNT; phase++) {
+        fprintf(out, "%-10s", phase_names[phase]);
+        for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+            if (p->fds[i] >= 0) fprintf(out, " %15llu", (unsigned long long)counts[phase][i]);
+            else fprintf(out, " %15s", "n/a");
+        }
+        fprintf(out, "\n");
+    }
+    int multiplexed = 0;
+    for (int phase = 0; phase < PHASE_COUNT; phase++) multiplexed |= running_share(p, (Phase)phase) < 1.0;
+    if (multiplexed) {
+        fprintf(out, "perf: multiplexed with other events, counts scaled from the time counted:");
+        for (int phase = 0; phase < PHASE_COUNT; phase++) {
+            fprintf(out, " %s %.1f%%", phase_names[phase], 100.0 * running_share(p, (Phase)phase));
+        }
+        fprintf(out, "\n");
+    }
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+        if (p->fds[i] < 0) fprintf(out, "perf: %s unavailable: %s\n", perf_counter_names[i], strerror(p->errors[i]));
+    }
+}
+
+static void perf_report_text(const Stats *s, FILE *out) {
+    const PerfCounters *p = s->perf;
+    int available = 0;
+    for (int i = 0; i < PERF_COUNTER_COUNT; i++) available += p->fds[i] >= 0;
+    if (available) perf_report_counters(s, out);
+    else fprintf(out, "perf: hardware counters unavailable: %s\n", strerror(p->errors[PERF_CYCLES]));
+
+    if (p->sample_fd < 0) {
+        if (p->sample_error) fprintf(out, "perf: sampling unavailable: %s\n", strerror(p->sample_error));
+        return;
+    }
+
+    unsigned long long total = 0;
+    for (int t = 0; t <= NODE_COUNT; t++) total += p->samples[t];
+    fprintf(out, "samples: %llu (%s, every %llu)\n", total, p->sample_event, (unsigned long long)p->sample_period);
+    if (!total) return;
+
+    for (int t = 0; t <= NODE_COUNT; t++) {
+        if (!p->samples[t]) continue;
+        const char *name = t < NODE_COUNT ? node_type_name((NodeType)t) : "other";
+        fprintf(out, "  %-20s %6.2f%%\n", name, 100.0 * p->samples[t] / total);
+    }
+}
+
+void stats_report(Stats *s, FILE *out) {
+    if (!s->timing) return;
+
+    /* A runtime error ends the program inside a phase, which is closed here. */
+    for (int p = 0; p < PHASE_COUNT; p++) phase_end(s, (Phase)p);
+
+    /*
+     * The scanner runs inside the parser, and only the wall time of a sample of its tokens is measured (see
+     * STATS_LEX_SAMPLED()): the lexing is estimated from it, and the CPU time of the parse is split in the same
+     * proportion.
+     */
+    double wall[PHASE_COUNT], cpu[PHASE_COUNT];
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        wall[p] = s->wall[p];
+        cpu[p] = s->cpu[p];
+    }
+    double front = s->wall[PHASE_PARSE];
+    wall[PHASE_LEX] = (s->wall[PHASE_LEX] - s->timed_tokens * s->clock_cost) * lex_scale(s);
+    if (wall[PHASE_LEX] < 0) wall[PHASE_LEX] = 0;
+    if (wall[PHASE_LEX] > front) wall[PHASE_LEX] = front;
+    wall[PHASE_PARSE] = front > wall[PHASE_LEX] ? front - wall[PHASE_LEX] : 0.0;
+    cpu[PHASE_LEX] = front > 0 ? s->cpu[PHASE_PARSE] * (wall[PHASE_LEX] / front) : 0.0;
+    cpu[PHASE_PARSE] = s->cpu[PHASE_PARSE] - cpu[PHASE_LEX];
+
+    struct rusage usage;
+    long peak_rss = (getrusage(RUSAGE_SELF, &usage) == 0) ? usage.ru_maxrss : -1;
+    double average_chain = s->searches ? (double)s->search_steps / s->searches : 0.0;
+    double hit_rate = s->cache_lookups ? (double)s->cache_hits / s->cache_lookups : 0.0;
+
+    if (s->format == STATS_JSON) {
+        fprintf(out, "{\"phases\":{");
+        for (int p = 0; p < PHASE_COUNT; p++) {
+            fprintf(out, "%s\"%s\":{\"wall\":%.9f,\"cpu\":%.9f}", p ? "," : "", phase_names[p], wall[p], cpu[p]);
+        }
+        fprintf(out, "},\"lex_sample\":{\"tokens\":%llu,\"timed\":%llu}", s->tokens, s->timed_tokens);
+        fprintf(out, ",\"nodes\":{");
+        for (int t = 0; t < NODE_COUNT; t++) {
+            fprintf(out, "%s\"%s\":%lu", t ? "," : "", node_type_name((NodeType)t), s->nodes[t]);
+        }
+        fprintf(out, "},\"search\":{\"calls\":%llu,\"average_chain\":%.3f}", s->searches, average_chain);
+        fprintf(out, ",\"bytes\":{\"nodes\":%llu,\"compact_nodes\":%llu,\"variables\":%llu,\"lists\":%llu}",
+            s->node_bytes, s->compact_bytes, s->variable_bytes, s->list_bytes);
+        fprintf(out, ",\"optimizer\":{\"dead_decls\":%d,\"dead_stores\":%d,\"dead_branches\":%d,\"unrolled_loops\":%d,"
+            "\"reused_exprs\":%d}", s->opt.dead_decls, s->opt.dead_stores, s->opt.dead_branches, s->opt.unrolled_loops,
+            s->opt.reused_exprs);
+        fprintf(out, ",\"tiers\":{\"tier_ups\":%lu,\"deopts\":%lu}", s->tier_ups, s->deopts);
+        if (s->perf) perf_report_json(s, out);
+        if (s->cache_used) {
+            fprintf(out, ",\"cache\":{\"hit\":%s,\"lookups\":%llu,\"hits\":%llu,\"hit_rate\":%.4f,"
+                "\"bytes_saved\":%llu}", s->cache_hit ? "true" : "false", s->cache_lookups, s->cache_hits,
+                hit_rate, s->cache_bytes_saved);
+        }
+        fprintf(out, ",\"peak_rss_kb\":%ld}\n", peak_rss);
+        return;
+    }
+
+    fprintf(out, "%-10s %12s %12s\n", "phase", "wall (ms)", "cpu (ms)");
+    for (int p = 0; p < PHASE_COUNT; p++) {
+        fprintf(out, "%-10s %12.3f %12.3f\n", phase_names[p], wall[p] * 1e3, cpu[p] * 1e3);
+    }
+    if (s->tokens) fprintf(out, "lex: estimated from %llu of %llu tokens\n", s->timed_tokens, s->tokens);
+
+    fprintf(out, "nodes:");
+    for (int t = 0; t < NODE_COUNT; t++) {
+        if (s->nodes[t]) fprintf(out, " %s=%lu", node_type_name((NodeType)t), s->nodes[t]);
+    }
+    fprintf(out, "\n");
+
+    fprintf(out, "search(): %llu calls, %.3f nodes visited on average\n", s->searches, average_chain);
+    fprintf(out, "allocated: %llu bytes of nodes, %llu bytes of variables, %llu bytes of lists\n",
+        s->node_bytes, s->variable_bytes, s->list_bytes);
+    if (s->compact_bytes) fprintf(out, "compact ast: %llu bytes\n", s->compact_bytes);
+    fprintf(out, "optimizer: removed %d declarations, %d assignments and %d branches, unrolled %d loops, reused %d "
+        "expressions\n", s->opt.dead_decls, s->opt.dead_stores, s->opt.dead_branches, s->opt.unrolled_loops,
+        s->opt.reused_exprs);
+    if (s->tier_ups || s->deopts) {
+        fprintf(out, "tiers: %lu loop(s) specialized, %lu deoptimization(s)\n", s->tier_ups, s->deopts);
+    }
+    if (s->perf) perf_report_text(s, out);
+    if (s->cache_used) {
+        fprintf(out, "cache: %s, %llu of %llu lookups hit (%.1f%%), %llu bytes of output answered from the cache\n",
+            s->cache_hit ? "hit" : "miss", s->cache_hits, s->cache_lookups, hit_rate * 100, s->cache_bytes_saved);
+    }
+    fprintf(out, "peak rss: %ld KiB\n", peak_rss);
+}
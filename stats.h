@@ -0,0 +1,133 @@
+#ifndef STATS_H
+#define STATS_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "ast.h"
+#include "optimizer.h"
+
+/**
+ * @enum Phase
+ *
+ * @brief Phases of the compiler that are timed.
+ */
+typedef enum Phase {
+    PHASE_LEX,
+    PHASE_PARSE,
+    PHASE_OPTIMIZE,
+    PHASE_EXECUTE,
+    PHASE_COUNT,
+} Phase;
+
+/**
+ * @enum StatsFormat
+ *
+ * @brief Format of the report.
+ */
+typedef enum StatsFormat { STATS_TEXT, STATS_JSON, } StatsFormat;
+
+/**
+ * @struct Stats
+ *
+ * @brief Counters collected while compiling and running one program.
+ *
+ * Each context has its own Stats. The counters are always updated (they are simple increments); only the timing of
+ * the phases depends on stats_enable(). When perf is set, the phases also read its counters.
+ */
+typedef struct Stats {
+    double wall[PHASE_COUNT];           // Seconds.
+    double cpu[PHASE_COUNT];            // Seconds, of the thread that ran the phase.
+    unsigned long nodes[NODE_COUNT];    // Nodes created by the parser, by type.
+    unsigned long long searches;        // Calls to search().
+    unsigned long long search_steps;    // List nodes visited by search().
+    unsigned long long node_bytes;      // Allocated by alloc_node().
+    unsigned long long compact_bytes;   // Used by the compact AST (0 if it was not built).
+    unsigned long long variable_bytes;  // Allocated for declared variables and for scalar values.
+    unsigned long long list_bytes;      // Allocated for list data.
+    unsigned long tier_ups;             // Loops specialized by the tiered execution (see tier.h).
+    unsigned long deopts;               // Specialized loops that went back to the generic interpreter.
+    OptStats opt;
+    struct PerfCounters *perf;          // Hardware counters of the phases (NULL if disabled, see perf.h).
+
+    /* Result cache (see cache.h); the totals are of every run that used the directory. */
+    int cache_used;
+    int cache_hit;                      // The run was answered from the cache.
+    unsigned long long cache_lookups;
+    unsigned long long cache_hits;
+    unsigned long long cache_bytes_saved; // Output answered from the cache instead of running the program.
+
+    /* Sampled timing of the scanner (see STATS_LEX_SAMPLED()). */
+    unsigned long long tokens;          // Tokens read while timing.
+    unsigned long long timed_tokens;    // Tokens whose lexing was timed.
+    unsigned long long next_timed;      // Value of tokens at which the next one is timed.
+    uint32_t sample_state;              // Random state of the gaps between timed tokens.
+    double clock_cost;                  // Seconds added to a timed token by reading the clock.
+
+    /* Timing state. */
+    int timing;
+    StatsFormat format;
+    int running[PHASE_COUNT];
+    double wall_start[PHASE_COUNT];
+    double cpu_start[PHASE_COUNT];
+} Stats;
+
+/**
+ * @brief Enables the timing of the phases.
+ *
+ * @param s Counters.
+ * @param format Format used by stats_report().
+ */
+void stats_enable(Stats *s, StatsFormat format);
+
+/* Average number of tokens between two tokens whose lexing is timed. */
+#define LEX_SAMPLE_GAP 64
+
+/**
+ * @brief Counts a token read by the parser, telling whether its lexing must be timed.
+ *
+ * Reading the clocks around every token would cost more than the scanner itself, so only about one token in
+ * LEX_SAMPLE_GAP is timed (into wall[PHASE_LEX] and the PHASE_LEX perf counts), at random gaps so that the samples do
+ * not follow the period of a repeated statement (nor always time the first token, which fills the buffer of the
+ * scanner). stats_report() scales the sample by tokens / timed_tokens. The other tokens cost an increment and a
+ * comparison.
+ */
+#define STATS_LEX_SAMPLED(s) (++(s)->tokens >= (s)->next_timed && stats_lex_sample(s))
+
+/**
+ * @brief Chooses the next token to be timed (called by STATS_LEX_SAMPLED()).
+ *
+ * @param s Counters.
+ * @return 1.
+ */
+int stats_lex_sample(Stats *s);
+
+/**
+ * @brief Returns a monotonic clock, in seconds.
+ */
+double stats_clock(void);
+
+/**
+ * @brief Starts timing a phase (does nothing if the timing is disabled).
+ *
+ * @param s Counters.
+ * @param phase Phase.
+ */
+void phase_start(Stats *s, Phase phase);
+
+/**
+ * @brief Stops timing a phase, adding the elapsed time to it.
+ *
+ * @param s Counters.
+ * @param phase Phase.
+ */
+void phase_end(Stats *s, Phase phase);
+
+/**
+ * @brief Prints the report, closing any phase that is still running (does nothing if the timing is disabled).
+ *
+ * @param s Counters.
+ * @param out Where the report is written.
+ */
+void stats_report(Stats *s, FILE *out);
+
+#endif // STATS_H
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Differential test of the optimizer: every program must print the same to stdout and to stderr, and exit with the same
+# status, with loop unrolling disabled (--unroll=1, the reference), by default, with --tiered=1 (loops specialized from
+# the first iteration) and with --compact-ast.
+#
+# Usage: tests/check_optimizer.sh COMPILER FILE|DIRECTORY...
+# Directories are searched for *.txt files. A program reads its input from the file with the same name ending in .in,
+# if there is one, or from /dev/null. Exits with 1 if any program differs.
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 COMPILER FILE|DIRECTORY..." >&2
+    exit 2
+fi
+
+compiler=$1
+shift
+
+tmp=$(mktemp -d) || exit 2
+trap 'rm -rf "$tmp"' EXIT
+
+# run NAME PROGRAM INPUT OPTION: runs the program and saves its stdout, its stderr and its exit status to $tmp/NAME.
+run() {
+    "$compiler" $4 "$2" < "$3" > "$tmp/out" 2> "$tmp/err"
+    status=$?
+    {
+        echo "stdout:"
+        cat "$tmp/out"
+        echo "stderr:"
+        cat "$tmp/err"
+        echo "status $status"
+    } > "$tmp/$1"
+}
+
+checked=0
+failed=0
+for program in $(find "$@" -type f -name '*.txt' | sort); do
+    input=${program%.txt}.in
+    [ -f "$input" ] || input=/dev/null
+
+    run reference "$program" "$input" --unroll=1
+    differ=0
+    for option in "" --tiered=1 --compact-ast; do
+        run mode "$program" "$input" "$option"
+        if ! cmp -s "$tmp/reference" "$tmp/mode"; then
+            echo "$program: ${option:-the default} differs from --unroll=1 (< --unroll=1, > ${option:-default}):"
+            diff "$tmp/reference" "$tmp/mode" | head -n 20
+            differ=1
+        fi
+    done
+
+    checked=$((checked + 1))
+    failed=$((failed + differ))
+done
+
+if [ "$checked" -eq 0 ]; then
+    echo "No programs found." >&2
+    exit 2
+fi
+
+echo "check-optimizer: $checked programs, $failed differ"
+[ "$failed" -eq 0 ]
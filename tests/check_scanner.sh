@@ -0,0 +1,41 @@
+#!/bin/sh
+# Differential test of the scanners: for every program, --tokens must print exactly the same with the flex scanner
+# and with the hand-written one (scanner.c), including the invalid character messages and the exit status.
+#
+# Usage: tests/check_scanner.sh COMPILER FILE|DIRECTORY...
+# Directories are searched for *.txt files. Exits with 1 if any program differs.
+
+if [ $# -lt 2 ]; then
+    echo "Usage: $0 COMPILER FILE|DIRECTORY..." >&2
+    exit 2
+fi
+
+compiler=$1
+shift
+
+tmp=$(mktemp -d) || exit 2
+trap 'rm -rf "$tmp"' EXIT
+
+checked=0
+failed=0
+for program in $(find "$@" -type f -name '*.txt' | sort); do
+    "$compiler" --tokens --scanner=flex "$program" > "$tmp/flex" 2>&1
+    echo "status $?" >> "$tmp/flex"
+    "$compiler" --tokens --scanner=fast "$program" > "$tmp/fast" 2>&1
+    echo "status $?" >> "$tmp/fast"
+
+    checked=$((checked + 1))
+    if ! cmp -s "$tmp/flex" "$tmp/fast"; then
+        echo "$program: the scanners differ (< flex, > fast):"
+        diff "$tmp/flex" "$tmp/fast" | head -n 20
+        failed=$((failed + 1))
+    fi
+done
+
+if [ "$checked" -eq 0 ]; then
+    echo "No programs found." >&2
+    exit 2
+fi
+
+echo "check-scanner: $checked programs, $failed differ"
+[ "$failed" -eq 0 ]
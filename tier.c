@@ -0,0 +1,603 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "tier.h"
+#include "context.h"
+#include "variables.h"
+#include "trace.h"
+#include "budget.h"
+
+/**
+ * @enum SpecKind
+ *
+ * @brief Operations of the specialized code.
+ */
+typedef enum SpecKind {
+    /* Expressions. */
+    S_CONST,        // value.
+    S_LOAD,         // Scalar variable var (initialized when specialized).
+    S_LOAD_ELEM,    // Element of the list var, at index_var or index.
+    S_ARITH_INT,    // Arithmetic between two integers.
+    S_ARITH_REAL,   // Arithmetic between a real and an integer or real.
+    S_ARITH,        // Arithmetic with operands of unknown types (eval_arithmetic()).
+    S_NOT,          // .NAO. of left.
+    S_COMPARE,      // Relational or logical operation between left and right.
+    S_TEMP_SAVE,    // Saves left in the slot index.
+    S_TEMP_LOAD,    // Reads the slot index, that must have the type seen when specialized.
+    S_GENERIC_EXPR, // eval_node() of node.
+
+    /* Statements. */
+    S_BLOCK,        // stmts.
+    S_STORE,        // Stores left in the scalar variable var.
+    S_STORE_ELEM,   // Stores left in the element of the list var, at index_var or index.
+    S_IF,           // left (condition), then body, else other.
+    S_WHILE,        // left (condition), body.
+    S_GENERIC_STMT, // execute_node() of node.
+} SpecKind;
+
+/**
+ * @struct Spec
+ *
+ * @brief Node of the specialized code of a loop.
+ *
+ * Every node keeps the node of the tree it came from, which is executed by the generic interpreter when a guard fails.
+ */
+typedef struct Spec {
+    SpecKind kind;
+    Types type;             // Type of the result of an expression (T_UNTYPED if it is only known when evaluated).
+    int op;                 // BinOp or RelOp.
+    Node *node;
+    Variable *var;
+    Variable *index_var;    // Integer variable used as the index (NULL: the index is constant).
+    int index;              // Constant index, or slot of a temporary.
+    EvalResult value;
+    struct Spec *left;
+    struct Spec *right;
+    struct Spec *body;
+    struct Spec *other;
+    struct Spec **stmts;
+    int count;
+} Spec;
+
+/**
+ * @struct Profile
+ *
+ * @brief What is known about one loop of the run.
+ */
+typedef struct Profile {
+    Node *loop;
+    unsigned long iterations;   // Iterations in the generic interpreter since the last tier change.
+    int deopts;
+    Spec *cond;                 // Specialized condition and body (NULL while the loop is generic).
+    Spec *body;
+    ListNode *variables;        // First node of the variable list when specialized (changes if a variable is declared).
+} Profile;
+
+struct TierProfiles {
+    Profile **slots;    // Open addressing by the address of the loop.
+    int capacity;       // Power of two.
+    int count;
+};
+
+/**
+ * @struct Run
+ *
+ * @brief State of one execution of specialized code.
+ */
+typedef struct Run {
+    Context *ctx;
+    int deopted;        // A guard failed, and part of the iteration was executed by the generic interpreter.
+} Run;
+
+/* Profiles. */
+
+static void free_spec(Spec *s) {
+    if (!s) return;
+    free_spec(s->left);
+    free_spec(s->right);
+    free_spec(s->body);
+    free_spec(s->other);
+    for (int i = 0; i < s->count; i++) free_spec(s->stmts[i]);
+    free(s->stmts);
+    free(s);
+}
+
+void tier_free(TierProfiles *profiles) {
+    if (!profiles) return;
+
+    for (int i = 0; i < profiles->capacity; i++) {
+        Profile *p = profiles->slots[i];
+        if (!p) continue;
+        free_spec(p->cond);
+        free_spec(p->body);
+        free(p);
+    }
+    free(profiles->slots);
+    free(profiles);
+}
+
+static unsigned int hash_pointer(const void *p) {
+    uintptr_t x = (uintptr_t)p;
+    x ^= x >> 17;
+    x *= 0xed5ad4bbu;
+    x ^= x >> 11;
+    return (unsigned int)x;
+}
+
+/**
+ * @brief Returns the profile of a loop, creating it on the first call.
+ *
+ * @return The profile, or NULL if there is no memory (the loop is then only executed by the generic interpreter).
+ */
+static Profile *find_profile(Context *ctx, Node *loop) {
+    if (!ctx->tiers) {
+        ctx->tiers = (TierProfiles *)calloc(1, sizeof(TierProfiles));
+        if (!ctx->tiers) return NULL;
+    }
+
+    TierProfiles *t = ctx->tiers;
+    if ((t->count + 1) * 2 > t->capacity) {
+        int capacity = t->capacity ? t->capacity * 2 : 16;
+        Profile **slots = (Profile **)calloc(capacity, sizeof(Profile *));
+        if (!slots) return NULL;
+
+        for (int i = 0; i < t->capacity; i++) {
+            if (!t->slots[i]) continue;
+            unsigned int h = hash_pointer(t->slots[i]->loop) & (capacity - 1);
+            while (slots[h]) h = (h + 1) & (capacity - 1);
+            slots[h] = t->slots[i];
+        }
+        free(t->slots);
+        t->slots = slots;
+        t->capacity = capacity;
+    }
+
+    unsigned int h = hash_pointer(loop) & (t->capacity - 1);
+    for (; t->slots[h]; h = (h + 1) & (t->capacity - 1)) {
+        if (t->slots[h]->loop == loop) return t->slots[h];
+    }
+
+    Profile *p = (Profile *)calloc(1, sizeof(Profile));
+    if (!p) return NULL;
+    p->loop = loop;
+    t->slots[h] = p;
+    t->count++;
+    return p;
+}
+
+/* Specialization. */
+
+/**
+ * @brief Creates a node of the specialized code.
+ *
+ * @return The node, or NULL if there is no memory (*failed is set).
+ */
+static Spec *new_spec(SpecKind kind, Node *node, int *failed) {
+    Spec *s = (Spec *)calloc(1, sizeof(Spec));
+    if (!s) {
+        *failed = 1;
+        return NULL;
+    }
+    s->kind = kind;
+    s->node = node;
+    s->type = T_UNTYPED;
+    return s;
+}
+
+/**
+ * @brief Resolves the index of a list access.
+ *
+ * @return 1 if the index is a constant or an initialized integer variable, 0 otherwise (the access stays generic).
+ */
+static int resolve_index(Context *ctx, Index index, Spec *s) {
+    if (index.type == INTEGER) {
+        s->index = index.value.integer;
+        return 1;
+    }
+
+    Variable *v = search(ctx->variables, index.value.name);
+    if (!v || v->type != T_INTEIRO || !v->initialized || !v->data) return 0;
+    s->index_var = v;
+    return 1;
+}
+
+static Spec *specialize_expr(Context *ctx, Node *n, int *failed) {
+    if (!n) return NULL;
+    Spec *s;
+
+    switch (n->type) {
+        case NODE_INT:
+        case NODE_REAL:
+            if (!(s = new_spec(S_CONST, n, failed))) return NULL;
+            s->value.type = n->type == NODE_INT ? T_INTEIRO : T_REAL;
+            if (n->type == NODE_INT) s->value.v.i = n->intval;
+            else s->value.v.d = n->realval;
+            s->type = s->value.type;
+            return s;
+        case NODE_VAR:
+        {
+            /* Reads of what is not declared or not initialized yet are left to eval_node(), which reports them. */
+            Variable *v = search(ctx->variables, n->var.name);
+            if (!v || !v->initialized || !v->data) break;
+
+            if (v->type == T_INTEIRO || v->type == T_REAL) {
+                if (!(s = new_spec(S_LOAD, n, failed))) return NULL;
+                s->var = v;
+                s->type = v->type;
+                return s;
+            }
+            if (!(s = new_spec(S_LOAD_ELEM, n, failed))) return NULL;
+            if (!resolve_index(ctx, n->var.index, s)) {
+                free_spec(s);
+                break;
+            }
+            s->var = v;
+            s->type = v->type == T_LISTAINT ? T_INTEIRO : T_REAL;
+            return s;
+        }
+        case NODE_BINOP:
+            if (!(s = new_spec(S_ARITH, n, failed))) return NULL;
+            s->op = n->binop.op;
+            s->left = specialize_expr(ctx, n->binop.left, failed);
+            s->right = specialize_expr(ctx, n->binop.right, failed);
+            if (s->left && s->right && s->left->type != T_UNTYPED && s->right->type != T_UNTYPED) {
+                int ints = s->left->type == T_INTEIRO && s->right->type == T_INTEIRO;
+                s->kind = ints ? S_ARITH_INT : S_ARITH_REAL;
+                s->type = ints ? T_INTEIRO : T_REAL;
+            }
+            return s;
+        case NODE_RELOP:
+            if (!(s = new_spec(n->relop.op == R_NAO ? S_NOT : S_COMPARE, n, failed))) return NULL;
+            s->op = n->relop.op;
+            s->type = T_INTEIRO;
+            s->left = specialize_expr(ctx, n->relop.left, failed);
+            if (n->relop.op != R_NAO) s->right = specialize_expr(ctx, n->relop.right, failed);
+            return s;
+        case NODE_TEMP:
+            /* The slots only grow, so one that exists now exists until the end of the run. */
+            if (n->temp.slot >= ctx->temp_count) break;
+
+            if (n->temp.expr) {
+                if (!(s = new_spec(S_TEMP_SAVE, n, failed))) return NULL;
+                s->left = specialize_expr(ctx, n->temp.expr, failed);
+                s->type = s->left ? s->left->type : T_UNTYPED;
+            } else {
+                if (!(s = new_spec(S_TEMP_LOAD, n, failed))) return NULL;
+                s->type = ctx->temps[n->temp.slot].type;
+            }
+            s->index = n->temp.slot;
+            return s;
+        default:
+            break;
+    }
+
+    return new_spec(S_GENERIC_EXPR, n, failed);
+}
+
+static Spec *specialize_stmt(Context *ctx, Node *n, int *failed) {
+    if (!n) return NULL;
+    Spec *s;
+
+    switch (n->type) {
+        case NODE_BLOCK:
+            if (!(s = new_spec(S_BLOCK, n, failed))) return NULL;
+            s->stmts = (Spec **)calloc(n->block.count ? n->block.count : 1, sizeof(Spec *));
+            if (!s->stmts) {
+                *failed = 1;
+                return s;
+            }
+            s->count = n->block.count;
+            for (int i = 0; i < n->block.count; i++) s->stmts[i] = specialize_stmt(ctx, n->block.cmds[i], failed);
+            return s;
+        case NODE_ASSIGN:
+        {
+            /* Only variables that already have memory: the first assignment allocates it (see ast.c). */
+            Node *target = n->assign.var;
+            Variable *v = search(ctx->variables, target->var.name);
+            if (!v || !v->data || v->type == T_UNTYPED) break;
+
+            int list = v->type == T_LISTAINT || v->type == T_LISTAREAL;
+            if (!list && target->var.index.type != INTEGER) break;
+            if (!(s = new_spec(list ? S_STORE_ELEM : S_STORE, n, failed))) return NULL;
+            if (list && !resolve_index(ctx, target->var.index, s)) {
+                free_spec(s);
+                break;
+            }
+            s->var = v;
+            s->left = specialize_expr(ctx, n->assign.expr, failed);
+            return s;
+        }
+        case NODE_IF:
+            if (!(s = new_spec(S_IF, n, failed))) return NULL;
+            s->left = specialize_expr(ctx, n->ifnode.cond, failed);
+            s->body = specialize_stmt(ctx, n->ifnode.then_block, failed);
+            s->other = specialize_stmt(ctx, n->ifnode.else_block, failed);
+            return s;
+        case NODE_WHILE:
+            if (!(s = new_spec(S_WHILE, n, failed))) return NULL;
+            s->left = specialize_expr(ctx, n->whilenode.cond, failed);
+            s->body = specialize_stmt(ctx, n->whilenode.body, failed);
+            return s;
+        default:
+            break;
+    }
+
+    return new_spec(S_GENERIC_STMT, n, failed);
+}
+
+/**
+ * @brief Specializes a loop that reached the threshold.
+ */
+static void tier_up(Context *ctx, Profile *p) {
+    int failed = 0;
+    Spec *cond = specialize_expr(ctx, p->loop->whilenode.cond, &failed);
+    Spec *body = specialize_stmt(ctx, p->loop->whilenode.body, &failed);
+
+    /* Without memory, the loop just stays generic. */
+    if (failed) {
+        free_spec(cond);
+        free_spec(body);
+        p->deopts = TIER_MAX_DEOPTS;
+        return;
+    }
+
+    TRACE(TRACE_AST, EV_TIER_UP, (int64_t)p->iterations, NULL);
+    p->cond = cond;
+    p->body = body;
+    p->variables = ctx->variables->start;
+    p->iterations = 0;
+    ctx->stats.tier_ups++;
+}
+
+/**
+ * @brief Goes back to the generic interpreter.
+ */
+static void deoptimize(Context *ctx, Profile *p) {
+    free_spec(p->cond);
+    free_spec(p->body);
+    p->cond = NULL;
+    p->body = NULL;
+    p->deopts++;
+    ctx->stats.deopts++;
+    TRACE(TRACE_AST, EV_DEOPT, p->deopts, NULL);
+}
+
+/* Execution of the specialized code. */
+
+/**
+ * @brief Returns the index of a list access, if it is in range.
+ *
+ * @return 1 if OK, 0 if the guard failed.
+ */
+static int spec_index(const Spec *s, int *index) {
+    *index = s->index_var ? *(int *)s->index_var->data : s->index;
+    return *index >= 0 && *index < s->var->size;
+}
+
+/**
+ * @brief Evaluates a specialized expression.
+ *
+ * Nothing visible is changed before a guard fails (saving a temporary again gives the same value), so the generic
+ * interpreter can evaluate the expression again.
+ *
+ * @return 1 if OK, 0 if a guard failed.
+ */
+static int eval_spec(Run *run, const Spec *s, EvalResult *r) {
+    switch (s->kind) {
+        case S_CONST:
+            *r = s->value;
+            return 1;
+        case S_LOAD:
+            r->type = s->type;
+            if (s->type == T_INTEIRO) r->v.i = *(int *)s->var->data;
+            else r->v.d = *(double *)s->var->data;
+            return 1;
+        case S_LOAD_ELEM:
+        {
+            int i;
+            if (!spec_index(s, &i)) return 0;
+            r->type = s->type;
+            if (s->type == T_INTEIRO) r->v.i = ((int *)s->var->data)[i];
+            else r->v.d = ((double *)s->var->data)[i];
+            return 1;
+        }
+        case S_ARITH_INT:
+        {
+            EvalResult left, right;
+            if (!eval_spec(run, s->left, &left) || !eval_spec(run, s->right, &right)) return 0;
+
+            r->type = T_INTEIRO;
+            switch (s->op) {
+                case OP_ADD: r->v.i = left.v.i + right.v.i; break;
+                case OP_SUB: r->v.i = left.v.i - right.v.i; break;
+                case OP_MUL: r->v.i = left.v.i * right.v.i; break;
+                case OP_DIV:
+                default:
+                    /* The generic interpreter reports the error, with its message. */
+                    if (right.v.i == 0 || (right.v.i == -1 && left.v.i == INT_MIN)) return 0;
+                    r->v.i = left.v.i / right.v.i;
+            }
+            return 1;
+        }
+        case S_ARITH_REAL:
+        {
+            EvalResult left, right;
+            if (!eval_spec(run, s->left, &left) || !eval_spec(run, s->right, &right)) return 0;
+
+            double ld = s->left->type == T_INTEIRO ? (double)left.v.i : left.v.d;
+            double rd = s->right->type == T_INTEIRO ? (double)right.v.i : right.v.d;
+            r->type = T_REAL;
+            switch (s->op) {
+                case OP_ADD: r->v.d = ld + rd; break;
+                case OP_SUB: r->v.d = ld - rd; break;
+                case OP_MUL: r->v.d = ld * rd; break;
+                case OP_DIV:
+                default: r->v.d = ld / rd;
+            }
+            return 1;
+        }
+        case S_ARITH:
+        {
+            EvalResult left, right;
+            if (!s->left || !s->right) return 0;
+            if (!eval_spec(run, s->left, &left) || !eval_spec(run, s->right, &right)) return 0;
+            if (left.type == T_INTEIRO && right.type == T_INTEIRO && s->op == OP_DIV
+                && (right.v.i == 0 || (right.v.i == -1 && left.v.i == INT_MIN))) return 0;
+            *r = eval_arithmetic(run->ctx, (BinOp)s->op, left, right);
+            return 1;
+        }
+        case S_NOT:
+        {
+            EvalResult left;
+            if (!s->left || !eval_spec(run, s->left, &left)) return 0;
+            r->type = T_INTEIRO;
+            r->v.i = !left.v.i;
+            return 1;
+        }
+        case S_COMPARE:
+        {
+            EvalResult left, right;
+            if (!s->left || !s->right) return 0;
+            if (!eval_spec(run, s->left, &left) || !eval_spec(run, s->right, &right)) return 0;
+            r->type = T_INTEIRO;
+            r->v.i = eval_compare((RelOp)s->op, left, right);
+            return 1;
+        }
+        case S_TEMP_SAVE:
+            if (!s->left || !eval_spec(run, s->left, r)) return 0;
+            run->ctx->temps[s->index] = *r;
+            return 1;
+        case S_TEMP_LOAD:
+            *r = run->ctx->temps[s->index];
+            return r->type == s->type;
+        case S_GENERIC_EXPR:
+            *r = eval_node(run->ctx, s->node);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+static void run_block(Run *run, const Spec *s);
+
+/**
+ * @brief Executes a specialized statement.
+ *
+ * @return 1 if it was executed, 0 if a guard failed before it changed anything.
+ */
+static int run_spec(Run *run, const Spec *s) {
+    Context *ctx = run->ctx;
+    BUDGET_POLL(ctx);
+
+    switch (s->kind) {
+        case S_BLOCK:
+            run_block(run, s);
+            return 1;
+        case S_STORE:
+        case S_STORE_ELEM:
+        {
+            EvalResult val;
+            if (!s->left || !eval_spec(run, s->left, &val)) return 0;
+
+            Variable *v = s->var;
+            int i = 0;
+            if (s->kind == S_STORE_ELEM && !spec_index(s, &i)) return 0;
+
+            if (v->type == T_INTEIRO || v->type == T_LISTAINT) {
+                ((int *)v->data)[i] = val.type == T_INTEIRO ? val.v.i : (int)val.v.d;
+            } else {
+                ((double *)v->data)[i] = val.type == T_INTEIRO ? (double)val.v.i : val.v.d;
+            }
+            v->initialized = 1;
+            v->generation++;
+            return 1;
+        }
+        case S_IF:
+        {
+            EvalResult cond;
+            if (!s->left || !eval_spec(run, s->left, &cond)) return 0;
+            if (cond.v.i) {
+                if (s->body) run_block(run, s->body);
+            } else if (s->other) {
+                run_block(run, s->other);
+            }
+            return 1;
+        }
+        case S_WHILE:
+            while (1) {
+                EvalResult cond;
+                if (!s->left || !eval_spec(run, s->left, &cond)) {
+                    /* The iterations already done cannot be undone, so the rest of the loop is generic. */
+                    run->deopted = 1;
+                    while (eval_node(ctx, s->node->whilenode.cond).v.i) {
+                        execute_node(ctx, s->node->whilenode.body);
+                        BUDGET_TICK(ctx, s->node->whilenode.copies);
+                    }
+                    return 1;
+                }
+                if (!cond.v.i) return 1;
+                if (s->body) run_block(run, s->body);
+                BUDGET_TICK(ctx, s->node->whilenode.copies);
+            }
+        case S_GENERIC_STMT:
+            execute_node(ctx, s->node);
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * @brief Executes a specialized statement, or a block of them.
+ *
+ * If a guard fails, the statement and the ones after it in the block are executed by the generic interpreter.
+ */
+static void run_block(Run *run, const Spec *s) {
+    if (s->kind != S_BLOCK) {
+        if (!run_spec(run, s)) {
+            run->deopted = 1;
+            execute_node(run->ctx, s->node);
+        }
+        return;
+    }
+
+    int i = 0;
+    while (i < s->count && run_spec(run, s->stmts[i])) i++;
+    if (i < s->count) {
+        run->deopted = 1;
+        for (; i < s->count; i++) execute_node(run->ctx, s->stmts[i]->node);
+    }
+    if (s->node->block.iterations) BUDGET_TICK(run->ctx, s->node->block.iterations);
+}
+
+void tier_execute_while(Context *ctx, Node *n) {
+    Profile *p = find_profile(ctx, n);
+
+    while (1) {
+        if (p && p->cond) {
+            Run run = { ctx, 0 };
+            EvalResult cond;
+
+            /* A declaration may hide a variable the specialized code reads, and the condition is side-effect free. */
+            if (ctx->variables->start != p->variables || !eval_spec(&run, p->cond, &cond)) {
+                deoptimize(ctx, p);
+                continue;
+            }
+            if (!cond.v.i) return;
+
+            if (p->body) run_block(&run, p->body);
+            BUDGET_TICK(ctx, n->whilenode.copies);
+            if (run.deopted) deoptimize(ctx, p);
+            continue;
+        }
+
+        EvalResult cond = eval_node(ctx, n->whilenode.cond);
+        if (!cond.v.i) return;
+        execute_node(ctx, n->whilenode.body);
+        BUDGET_TICK(ctx, n->whilenode.copies);
+
+        if (p && p->deopts < TIER_MAX_DEOPTS && ++p->iterations >= (unsigned long)ctx->tier_threshold) {
+            tier_up(ctx, p);
+        }
+    }
+}
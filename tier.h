@@ -0,0 +1,42 @@
+#ifndef TIER_H
+#define TIER_H
+
+#include "ast.h"
+
+/* Iterations of a loop before it is specialized, when --tiered is used without a value. */
+#define TIER_DEFAULT_THRESHOLD 1000
+
+/* Deoptimizations after which a loop is no longer specialized. */
+#define TIER_MAX_DEOPTS 3
+
+/* Profiles of the loops of a run (see tier.c). */
+typedef struct TierProfiles TierProfiles;
+
+/**
+ * @brief Executes a NODE_WHILE with tiered execution (used by execute_node() when ctx->tier_threshold is not 0).
+ *
+ * The loop starts in the generic interpreter, counting its iterations. When the count reaches ctx->tier_threshold,
+ * its condition and body are specialized using what was observed in the run so far: variables are resolved once to
+ * their Variable (instead of a search() on every access), and operations get the types of their operands (the
+ * declared types, and the types saved in the temporaries of the optimizer).
+ *
+ * The specialized code has guards for what can change or fail: list indices out of range, integer divisions by zero,
+ * the type saved in a temporary, and declarations of new variables. When a guard fails, the statement is executed
+ * again by the generic interpreter (which reports the same errors as before), the rest of the iteration is generic,
+ * and the loop goes back to counting. After TIER_MAX_DEOPTS deoptimizations the loop stays generic.
+ *
+ * Tier changes are counted in ctx->stats and recorded as EV_TIER_UP and EV_DEOPT trace events.
+ *
+ * @param ctx Context of the run (the profiles are kept in ctx->tiers).
+ * @param n Node of type NODE_WHILE.
+ */
+void tier_execute_while(Context *ctx, Node *n);
+
+/**
+ * @brief Frees the profiles and the specialized code of a run.
+ *
+ * @param profiles Profiles (can be NULL).
+ */
+void tier_free(TierProfiles *profiles);
+
+#endif // TIER_H
@@ -0,0 +1,167 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include "trace.h"
+
+#define TRACE_DEFAULT_CAPACITY (1u << 16)
+
+/**
+ * @struct TraceRing
+ *
+ * @brief Events recorded by a single thread.
+ */
+typedef struct TraceRing {
+    TraceEvent *events;
+    uint64_t written;           // Total of events recorded (the ring keeps the last capacity ones).
+    uint32_t thread;
+    struct TraceRing *next;
+} TraceRing;
+
+atomic_uint trace_mask = 0;
+
+static char *trace_path = NULL;
+static unsigned int trace_capacity = TRACE_DEFAULT_CAPACITY;
+static struct timespec trace_epoch;
+
+static pthread_mutex_t rings_lock = PTHREAD_MUTEX_INITIALIZER;
+static TraceRing *rings = NULL;
+static uint32_t next_thread = 0;
+
+static _Thread_local TraceRing *local_ring = NULL;
+
+int trace_parse_categories(const char *list, unsigned int *mask) {
+    static const struct { const char *name; unsigned int bit; } names[] = {
+        { "lexer", TRACE_LEXER }, { "parser", TRACE_PARSER }, { "ast", TRACE_AST },
+        { "variables", TRACE_VARIABLES }, { "all", TRACE_ALL },
+    };
+
+    *mask = 0;
+    while (*list) {
+        size_t len = strcspn(list, ",");
+        int found = 0;
+
+        for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+            if (strlen(names[i].name) == len && strncmp(names[i].name, list, len) == 0) {
+                *mask |= names[i].bit;
+                found = 1;
+            }
+        }
+        if (!found) return 0;
+
+        list += len;
+        if (*list == ',') list++;
+    }
+    return *mask != 0;
+}
+
+int trace_start(unsigned int categories, const char *path, unsigned int capacity) {
+    if (!path) return 0;
+
+    trace_capacity = TRACE_DEFAULT_CAPACITY;
+    if (capacity) {
+        trace_capacity = 1;
+        while (trace_capacity < capacity) trace_capacity <<= 1;
+    }
+
+    free(trace_path);
+    trace_path = strdup(path);
+    if (!trace_path) return 0;
+
+    clock_gettime(CLOCK_MONOTONIC, &trace_epoch);
+
+    static int registered = 0;
+    if (!registered) {
+        atexit(trace_finish);
+        registered = 1;
+    }
+
+    atomic_store_explicit(&trace_mask, categories, memory_order_relaxed);
+    return 1;
+}
+
+/**
+ * @brief Creates the ring of the current thread.
+ *
+ * @return The ring, or NULL if there is no memory (the event is lost).
+ */
+static TraceRing *create_ring(void) {
+    TraceRing *ring = (TraceRing *)calloc(1, sizeof(TraceRing));
+    if (!ring) return NULL;
+
+    ring->events = (TraceEvent *)malloc(sizeof(TraceEvent) * trace_capacity);
+    if (!ring->events) {
+        free(ring);
+        return NULL;
+    }
+
+    pthread_mutex_lock(&rings_lock);
+    ring->thread = next_thread++;
+    ring->next = rings;
+    rings = ring;
+    pthread_mutex_unlock(&rings_lock);
+
+    return ring;
+}
+
+__attribute__((noinline, cold))
+void trace_record(unsigned int category, unsigned int kind, int64_t arg, const char *text) {
+    TraceRing *ring = local_ring;
+    if (!ring) {
+        ring = local_ring = create_ring();
+        if (!ring) return;
+    }
+
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+
+    TraceEvent *e = &ring->events[ring->written & (trace_capacity - 1)];
+    e->timestamp = (uint64_t)(now.tv_sec - trace_epoch.tv_sec) * 1000000000ull
+        + (uint64_t)(now.tv_nsec - trace_epoch.tv_nsec);
+    e->thread = ring->thread;
+    e->category = (uint8_t)category;
+    e->reserved = 0;
+    e->kind = (uint16_t)kind;
+    e->arg = arg;
+    memset(e->data, 0, sizeof(e->data));
+    if (text) memcpy(e->data, text, strnlen(text, sizeof(e->data)));
+
+    ring->written++;
+}
+
+void trace_finish(void) {
+    if (!trace_path || !atomic_exchange(&trace_mask, 0)) return;
+
+    FILE *f = fopen(trace_path, "wb");
+    if (!f) {
+        perror("fopen() failed");
+        return;
+    }
+
+    pthread_mutex_lock(&rings_lock);
+
+    TraceFileHeader header;
+    memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+    header.event_size = sizeof(TraceEvent);
+    header.rings = next_thread;
+    fwrite(&header, sizeof(header), 1, f);
+
+    for (TraceRing *ring = rings; ring; ring = ring->next) {
+        TraceRingHeader rh;
+        rh.thread = ring->thread;
+        rh.count = (uint32_t)(ring->written < trace_capacity ? ring->written : trace_capacity);
+        rh.dropped = ring->written - rh.count;
+        fwrite(&rh, sizeof(rh), 1, f);
+
+        /* Oldest event first: when the ring wrapped, it is the one after the last written. */
+        uint64_t first = ring->written - rh.count;
+        for (uint32_t i = 0; i < rh.count; i++) {
+            fwrite(&ring->events[(first + i) & (trace_capacity - 1)], sizeof(TraceEvent), 1, f);
+        }
+    }
+
+    pthread_mutex_unlock(&rings_lock);
+
+    if (fclose(f) != 0) perror("fclose() failed");
+}
@@ -0,0 +1,140 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+#include <stdatomic.h>
+
+/**
+ * @enum TraceCategory
+ *
+ * @brief Groups of events that can be enabled separately (bit mask).
+ */
+typedef enum TraceCategory {
+    TRACE_LEXER = 1 << 0,       // Every match of the scanner.
+    TRACE_PARSER = 1 << 1,      // Nodes created by the parser.
+    TRACE_AST = 1 << 2,         // Evaluation and execution of nodes.
+    TRACE_VARIABLES = 1 << 3,   // Insertions and searches in the variable list.
+    TRACE_ALL = TRACE_LEXER | TRACE_PARSER | TRACE_AST | TRACE_VARIABLES,
+} TraceCategory;
+
+/**
+ * @enum TraceEventKind
+ *
+ * @brief What an event represents (the meaning of arg and data depends on it).
+ */
+typedef enum TraceEventKind {
+    EV_TOKEN,           // arg: length of the match, data: start of the text.
+    EV_NODE_CREATED,    // arg: NodeType.
+    EV_EVAL,            // arg: NodeType.
+    EV_EXECUTE,         // arg: NodeType.
+    EV_EXECUTE_END,     // arg: NodeType.
+    EV_VAR_INSERT,      // arg: variable type, data: start of the name.
+    EV_VAR_SEARCH,      // arg: nodes visited in the list (-1 if not found), data: start of the name.
+    EV_TIER_UP,         // arg: iterations of the loop before it was specialized.
+    EV_DEOPT,           // arg: deoptimizations of the loop so far.
+} TraceEventKind;
+
+/**
+ * @struct TraceEvent
+ *
+ * @brief A single event, exactly as it is saved in the trace file (32 bytes).
+ */
+typedef struct TraceEvent {
+    uint64_t timestamp;     // Nanoseconds since the trace started.
+    uint32_t thread;        // Sequential id of the thread that recorded the event.
+    uint8_t category;       // TraceCategory.
+    uint8_t reserved;
+    uint16_t kind;          // TraceEventKind.
+    int64_t arg;
+    char data[8];           // Text prefix (not null terminated if it fills the field).
+} TraceEvent;
+
+/**
+ * @struct TraceFileHeader
+ *
+ * @brief Start of the trace file, followed by one TraceRingHeader and its events for each thread.
+ */
+typedef struct TraceFileHeader {
+    char magic[8];          // "SCTRACE1".
+    uint32_t event_size;    // sizeof(TraceEvent).
+    uint32_t rings;         // Number of threads that recorded events.
+} TraceFileHeader;
+
+/**
+ * @struct TraceRingHeader
+ *
+ * @brief Describes the events of a thread in the trace file.
+ */
+typedef struct TraceRingHeader {
+    uint32_t thread;
+    uint32_t count;         // Events that follow (oldest first).
+    uint64_t dropped;       // Older events overwritten because the ring was full.
+} TraceRingHeader;
+
+#define TRACE_MAGIC "SCTRACE1"
+
+/**
+ * @brief Categories currently enabled (0 when tracing is disabled).
+ *
+ * Atomic, since the threads read it while trace_finish() clears it; the loads are relaxed, so they are plain loads.
+ */
+extern atomic_uint trace_mask;
+
+/**
+ * @brief Returns the categories currently enabled.
+ */
+#define TRACE_ENABLED(category) (atomic_load_explicit(&trace_mask, memory_order_relaxed) & (category))
+
+/**
+ * @brief Records an event if its category is enabled.
+ *
+ * When tracing is disabled the cost is a single predictable branch.
+ */
+#define TRACE(category, kind, arg, text) \
+    do { \
+        if (__builtin_expect(TRACE_ENABLED(category), 0)) trace_record((category), (kind), (arg), (text)); \
+    } while (0)
+
+/**
+ * @brief Enables tracing.
+ *
+ * The events are kept in a ring buffer per thread, and saved to the file when the program ends (including exit()).
+ *
+ * @param categories Mask of TraceCategory values.
+ * @param path File where the trace will be saved.
+ * @param capacity Events kept per thread (rounded up to a power of two, 0 for the default).
+ *
+ * @return Returns 1 if OK, and 0 if it fails.
+ */
+int trace_start(unsigned int categories, const char *path, unsigned int capacity);
+
+/**
+ * @brief Converts a comma separated list of categories (lexer, parser, ast, variables, all) to a mask.
+ *
+ * @param list List of categories.
+ * @param mask Where the mask will be saved.
+ *
+ * @return Returns 1 if OK, and 0 if some category is invalid.
+ */
+int trace_parse_categories(const char *list, unsigned int *mask);
+
+/**
+ * @brief Saves the events recorded so far to the trace file and disables tracing.
+ *
+ * The rings are read without the threads that write them being stopped, so it must only be called once every thread
+ * that records events, other than the calling one, has been joined (it runs at exit(), after main() has joined its
+ * threads). Calling it again does nothing.
+ */
+void trace_finish(void);
+
+/**
+ * @brief Adds an event to the ring of the current thread (use the TRACE macro instead).
+ *
+ * @param category TraceCategory of the event.
+ * @param kind TraceEventKind of the event.
+ * @param arg Argument of the event.
+ * @param text Text saved in the data field (can be NULL).
+ */
+void trace_record(unsigned int category, unsigned int kind, int64_t arg, const char *text);
+
+#endif // TRACE_H
@@ -0,0 +1,139 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "trace.h"
+#include "nodetype.h"
+
+/* Generated from the same list as NodeType in ast.h. */
+static const char *node_names[] = { NODE_TYPES(NODE_TYPE_NAME) };
+
+/* Same order as Types in types.h. */
+static const char *type_names[] = { "INTEIRO", "REAL", "LISTAINT", "LISTAREAL", "UNTYPED" };
+
+static const char *node_name(int64_t type) {
+    if (type < 0 || type >= (int64_t)(sizeof(node_names) / sizeof(node_names[0]))) return "NODE_?";
+    return node_names[type];
+}
+
+/**
+ * @brief Copies the data field to a printable string, escaping control characters.
+ */
+static void printable(const TraceEvent *e, char *out) {
+    int pos = 0;
+    for (size_t i = 0; i < sizeof(e->data) && e->data[i]; i++) {
+        unsigned char c = (unsigned char)e->data[i];
+        if (c == '\n') { out[pos++] = '\\'; out[pos++] = 'n'; }
+        else if (c == '\t') { out[pos++] = '\\'; out[pos++] = 't'; }
+        else if (c == '\r') { out[pos++] = '\\'; out[pos++] = 'r'; }
+        else if (c < 32) out[pos++] = '?';
+        else out[pos++] = (char)c;
+    }
+    out[pos] = '\0';
+}
+
+static void print_event(const TraceEvent *e) {
+    char text[32];
+    printable(e, text);
+    printf("%14.3f us  T%-3u ", e->timestamp / 1000.0, e->thread);
+
+    switch (e->kind) {
+        case EV_TOKEN:
+            printf("LEX     match \"%s%s\" (%lld bytes)\n", text, e->arg > 8 ? "..." : "", (long long)e->arg);
+            break;
+        case EV_NODE_CREATED:
+            printf("PARSER  created %s\n", node_name(e->arg));
+            break;
+        case EV_EVAL:
+            printf("AST     eval %s\n", node_name(e->arg));
+            break;
+        case EV_EXECUTE:
+            printf("AST     run %s\n", node_name(e->arg));
+            break;
+        case EV_EXECUTE_END:
+            printf("AST     end %s\n", node_name(e->arg));
+            break;
+        case EV_VAR_INSERT:
+            printf("VARS    insert %s%s (%s)\n", text, strlen(text) == 8 ? "..." : "",
+                (e->arg >= 0 && e->arg < 5) ? type_names[e->arg] : "?");
+            break;
+        case EV_VAR_SEARCH:
+            if (e->arg < 0) {
+                printf("VARS    search %s%s: not found\n", text, strlen(text) == 8 ? "..." : "");
+            } else {
+                printf("VARS    search %s%s: %lld node(s) visited\n", text, strlen(text) == 8 ? "..." : "", (long long)e->arg);
+            }
+            break;
+        case EV_TIER_UP:
+            printf("AST     loop specialized after %lld iteration(s)\n", (long long)e->arg);
+            break;
+        case EV_DEOPT:
+            printf("AST     loop deoptimized (%lld time(s))\n", (long long)e->arg);
+            break;
+        default:
+            printf("?       kind %u arg %lld\n", e->kind, (long long)e->arg);
+    }
+}
+
+static int compare_events(const void *a, const void *b) {
+    const TraceEvent *x = (const TraceEvent *)a;
+    const TraceEvent *y = (const TraceEvent *)b;
+    if (x->timestamp != y->timestamp) return x->timestamp < y->timestamp ? -1 : 1;
+    if (x->thread != y->thread) return x->thread < y->thread ? -1 : 1;
+    return 0;
+}
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "Usage: %s trace.bin\n", argv[0]);
+        return 1;
+    }
+
+    FILE *f = fopen(argv[1], "rb");
+    if (!f) {
+        perror("fopen() failed");
+        return 1;
+    }
+
+    TraceFileHeader header;
+    if (fread(&header, sizeof(header), 1, f) != 1 || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+        || header.event_size != sizeof(TraceEvent)) {
+        fprintf(stderr, "%s: not a trace file.\n", argv[1]);
+        fclose(f);
+        return 1;
+    }
+
+    TraceEvent *events = NULL;
+    size_t count = 0;
+    uint64_t dropped = 0;
+
+    for (uint32_t r = 0; r < header.rings; r++) {
+        TraceRingHeader rh;
+        if (fread(&rh, sizeof(rh), 1, f) != 1) break;
+
+        TraceEvent *grown = (TraceEvent *)realloc(events, sizeof(TraceEvent) * (count + rh.count));
+        if (!grown) {
+            perror("realloc() failed");
+            free(events);
+            fclose(f);
+            return 1;
+        }
+        events = grown;
+
+        size_t read = fread(events + count, sizeof(TraceEvent), rh.count, f);
+        count += read;
+        dropped += rh.dropped;
+        if (read != rh.count) break;
+    }
+    fclose(f);
+
+    /* Events of all threads are merged in time order. */
+    qsort(events, count, sizeof(TraceEvent), compare_events);
+    for (size_t i = 0; i < count; i++) print_event(&events[i]);
+
+    printf("%zu event(s) in %u thread(s)", count, header.rings);
+    if (dropped) printf(", %llu older event(s) overwritten", (unsigned long long)dropped);
+    printf("\n");
+
+    free(events);
+    return 0;
+}
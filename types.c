@@ -9,6 +9,7 @@ Variable *create_var(char *name, Types type, int size) {
     v->initialized = 0;
     v->size = size;
     v->data = NULL;
+    v->generation = 0;
 
     return v;
 }
@@ -23,6 +23,17 @@ typedef enum RelOp {
     R_MAQ, R_MAI, R_MEQ, R_MEI, R_IGU, R_DIF, R_NAO, R_OU, R_E,
 } RelOp;
 
+/**
+ * @enum Intrinsic
+ *
+ * @brief Built-in operations over whole lists.
+ *
+ * The first ones result in a value (used in expressions), and the last ones modify the list (used as commands).
+ */
+typedef enum Intrinsic {
+    I_SOMA, I_MEDIA, I_MINIMO, I_MAXIMO, I_PRODESCALAR, I_PREENCHE, I_ESCALA,
+} Intrinsic;
+
 /**
  * @enum Types
  *
@@ -61,6 +72,9 @@ typedef struct  Flex {
  * The data field should only be used if the initialized field is 1, and it must be converted to the type in question.
  *
  * The size field is only used if the variable is a vector, as it indicates the allocated size.
+ *
+ * The generation field is incremented whenever the value changes, so a checkpoint only copies the variables that
+ * changed since its previous snapshot.
  */
 typedef struct Variable {
     char *name;
@@ -68,6 +82,7 @@ typedef struct Variable {
     int initialized;
     int size;
     void *data;
+    unsigned long long generation;
 } Variable;
 
 /**
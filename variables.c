@@ -1,11 +1,14 @@
 #include <stdlib.h>
 #include "variables.h"
+#include "trace.h"
 
 List *initialize() {
     List *l = (List *)malloc(sizeof(List));
     if (!l) return NULL;
 
     l->start = NULL;
+    l->searches = 0;
+    l->search_steps = 0;
     return l;
 }
 
@@ -18,16 +21,25 @@ void insert(List *l, Variable *data) {
     n->variable = data;
     n->next = l->start;
     l->start = n;
+
+    TRACE(TRACE_VARIABLES, EV_VAR_INSERT, data ? (int)data->type : -1, data ? data->name : NULL);
 }
 
 Variable *search(List *l, char *name) {
     if (!l) return NULL;
 
     ListNode *n = l->start;
-    while (n && strcmp(n->variable->name, name) != 0) {
+    int visited = 0;
+    while (n) {
+        visited++;
+        if (strcmp(n->variable->name, name) == 0) break;
         n = n->next;
     }
 
+    l->searches++;
+    l->search_steps += visited;
+    TRACE(TRACE_VARIABLES, EV_VAR_SEARCH, n ? visited : -1, name);
+
     if (!n) return NULL;
     return n->variable;
 }
@@ -40,9 +52,8 @@ void clean(List *l) {
 
         if (n->variable) {
             free(n->variable->name);
-            if (n->variable->initialized == 1) {
-                free(n->variable->data);
-            }
+            /* A run that failed may leave data allocated for a variable that was never initialized. */
+            free(n->variable->data);
             free(n->variable);
         }
 
@@ -19,9 +19,13 @@ typedef struct ListNode {
  * @struct List
  *
  * @brief Represents a list of variables.
+ *
+ * Also counts the calls to search() and the nodes they visit.
  */
 typedef struct List {
     ListNode *start;
+    unsigned long long searches;
+    unsigned long long search_steps;
 } List;
 
 /**